@@ -0,0 +1,127 @@
+/**
+ * @file bench/bench_fanout.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief Benchmark for room fan-out
+ *
+ * Measures the cost of delivering one message to every other member of a room, for room sizes 2, 16, 256 and 4096:
+ * - direct: the message is written to each member's socket straight from the sender's buffer, as the server does for members that keep up.
+ * - queued shared: each member's output queue takes a reference to one SharedFrame copy, as the server does for members that fall behind.
+ * - queued copy: each member's output queue gets its own copy of the framed message, the cost the shared frame avoids.
+ * Prints the time per message and per recipient. An optional argument sets the message size (default 512 bytes).
+*/
+
+#include <server/output_queue.h>
+#include <server/room.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t BATCH = 64; // messages sent before the receivers are drained (or the queues dropped)
+
+// Build a JSON text message whose encoded size is exactly size bytes
+static std::string makeMessage(size_t size) {
+    std::string head = "{\"type\":\"text\",\"message\":\"";
+    std::string tail = "\"}";
+    return head + std::string(size - head.size() - tail.size(), 'a') + tail;
+}
+
+// Read everything waiting on a socket
+static void drain(int socket) {
+    char buffer[64 * 1024];
+    while (recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    }
+}
+
+// Send batches of messages to every recipient's socket, returns the nanoseconds spent sending per message
+static double runDirect(const std::string& message, size_t recipients, size_t messages) {
+    std::vector<int> senders(recipients);
+    std::vector<int> receivers(recipients);
+    for (size_t i = 0; i < recipients; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+            perror("socketpair");
+            std::exit(1);
+        }
+        senders[i] = fds[0];
+        receivers[i] = fds[1];
+    }
+    char newline = '\n';
+    Clock::duration spent{};
+    for (size_t sent = 0; sent < messages; sent += BATCH) {
+        auto begin = Clock::now();
+        for (size_t m = 0; m < BATCH; m++) {
+            for (int socket : senders) {
+                iovec parts[2] = {{const_cast<char*>(message.data()), message.size()}, {&newline, 1}};
+                msghdr msg{};
+                msg.msg_iov = parts;
+                msg.msg_iovlen = 2;
+                sendmsg(socket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+        }
+        spent += Clock::now() - begin;
+        for (int socket : receivers) {
+            drain(socket);
+        }
+    }
+    for (size_t i = 0; i < recipients; i++) {
+        close(senders[i]);
+        close(receivers[i]);
+    }
+    return std::chrono::duration<double, std::nano>(spent).count() / static_cast<double>(messages);
+}
+
+// Queue batches of messages for every recipient, sharing one framed copy or copying it per recipient, returns nanoseconds per message
+static double runQueued(const std::string& message, size_t recipients, size_t messages, bool shared) {
+    auto begin = Clock::now();
+    for (size_t sent = 0; sent < messages; sent += BATCH) {
+        std::vector<OutputQueue> queues(recipients);
+        for (size_t m = 0; m < BATCH; m++) {
+            SharedFrame frame(message.data(), message.size());
+            for (OutputQueue& queue : queues) {
+                if (shared) {
+                    const auto& wire = frame.framed(false);
+                    queue.push(wire, wire->data(), wire->size());
+                } else {
+                    queue.push(message + "\n");
+                }
+            }
+        }
+    } // dropping the queues releases the buffers, as writing them out would
+    return std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / static_cast<double>(messages);
+}
+
+int main(int argc, char** argv) {
+    size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+    if (size < 32) {
+        size = 32;
+    }
+    // The largest room needs two descriptors per member
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    std::string message = makeMessage(size);
+    std::printf("message size %zu bytes\n", size);
+    std::printf("%8s %26s %26s %26s\n", "members", "direct us/msg (ns/rcpt)", "shared us/msg (ns/rcpt)", "copy us/msg (ns/rcpt)");
+    for (size_t members : {2, 16, 256, 4096}) {
+        size_t recipients = members - 1;
+        size_t messages = std::max<size_t>(BATCH, (BATCH * 4096 / members) / BATCH * BATCH);
+        double direct = runDirect(message, recipients, messages);
+        double shared = runQueued(message, recipients, messages, true);
+        double copy = runQueued(message, recipients, messages, false);
+        std::printf("%8zu %14.2f (%8.1f) %14.2f (%8.1f) %14.2f (%8.1f)\n", members,
+            direct / 1000, direct / recipients, shared / 1000, shared / recipients, copy / 1000, copy / recipients);
+    }
+    return 0;
+}
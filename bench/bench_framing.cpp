@@ -0,0 +1,111 @@
+/**
+ * @file bench/bench_framing.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief Benchmark for message reassembly
+ *
+ * A writer thread streams JSON messages of one size through a socket pair, and the reader reassembles them the way the server does: read into a shared buffer, scan for complete messages and keep the incomplete tail in an InputBuffer.
+ * Prints the throughput for message sizes from 64 B to 1 MB, for both newline delimited JSON and binary frames.
+*/
+
+#include <common/framing.h>
+#include <server/input_buffer.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Build a JSON text message whose encoded size is exactly size bytes
+static std::string makeMessage(size_t size) {
+    std::string head = "{\"type\":\"text\",\"message\":\"";
+    std::string tail = "\"}";
+    return head + std::string(size - head.size() - tail.size(), 'a') + tail;
+}
+
+// Count the complete messages in a block of data, returns the number of bytes consumed
+static size_t countFrames(const char* data, size_t size, bool binary, Framing::JsonScanState& scan, size_t& messages) {
+    size_t consumed = 0;
+    while (consumed < size) {
+        size_t start;
+        size_t end;
+        if (binary) {
+            Framing::FrameType type;
+            end = Framing::scanBinary(data + consumed, size - consumed, start, type);
+        } else {
+            end = Framing::scanJson(data + consumed, size - consumed, start, scan);
+        }
+        if (end == Framing::INCOMPLETE || end == Framing::INVALID) {
+            break;
+        }
+        messages++;
+        consumed += end;
+    }
+    return consumed;
+}
+
+// Stream count messages of the given size and return the throughput in MB/s
+static double run(size_t size, size_t count, bool binary) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        perror("socketpair");
+        return 0;
+    }
+    std::string message = makeMessage(size);
+    std::string wire = binary ? Framing::encodeBinary(message) : message + "\n";
+
+    auto begin = std::chrono::steady_clock::now();
+    std::thread writer([&]() {
+        for (size_t i = 0; i < count; i++) {
+            size_t sent = 0;
+            while (sent < wire.size()) {
+                ssize_t n = write(fds[0], wire.data() + sent, wire.size() - sent);
+                if (n <= 0) {
+                    return;
+                }
+                sent += static_cast<size_t>(n);
+            }
+        }
+        shutdown(fds[0], SHUT_WR);
+    });
+
+    std::vector<char> readBuffer(64 * 1024);
+    InputBuffer input;
+    Framing::JsonScanState scan;
+    size_t messages = 0;
+    while (messages < count) {
+        bool buffered = !input.empty();
+        char* target = buffered ? input.prepare(readBuffer.size()) : readBuffer.data();
+        ssize_t n = read(fds[1], target, readBuffer.size());
+        if (n <= 0) {
+            break;
+        }
+        if (buffered) {
+            input.commit(static_cast<size_t>(n));
+            input.consume(countFrames(input.data(), input.size(), binary, scan, messages));
+        } else {
+            size_t consumed = countFrames(target, static_cast<size_t>(n), binary, scan, messages);
+            input.append(target + consumed, static_cast<size_t>(n) - consumed);
+        }
+    }
+    writer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    close(fds[0]);
+    close(fds[1]);
+    if (messages != count) {
+        std::fprintf(stderr, "lost messages: %zu of %zu\n", messages, count);
+    }
+    return static_cast<double>(wire.size() * count) / (1024.0 * 1024.0) / seconds;
+}
+
+int main() {
+    const size_t total = 256 * 1024 * 1024; // bytes streamed per run
+    std::printf("%10s %14s %14s\n", "size", "json MB/s", "binary MB/s");
+    for (size_t size = 64; size <= 1024 * 1024; size *= 4) {
+        size_t count = total / size;
+        std::printf("%10zu %14.1f %14.1f\n", size, run(size, count, false), run(size, count, true));
+    }
+    return 0;
+}
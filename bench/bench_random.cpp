@@ -0,0 +1,117 @@
+/**
+ * @file bench/bench_random.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief Benchmark for the random generators of the crypto helpers
+ *
+ * Measures the operations that need randomness with the generators they used before ThreadRng and with ThreadRng:
+ * - salt: a 16 byte password salt. Before: a new AutoSeededRandomPool per salt (seeded from the operating system each time).
+ * - dh keygen: a Diffie-Hellman key pair in the 2048-bit group. Before: one pool shared by every thread (DHKeyExchange::rnd, unsynchronized).
+ * - oaep: RSA-OAEP encryption of a 32 byte secret. Before: the pool owned by the RSAWrapper.
+ * Salts are also generated on every core at once, where the per-thread generators do not contend.
+ * Prints the time per operation and the throughput. An optional argument scales the number of operations (default 1).
+*/
+
+#include <common/dh_key.h>
+#include <common/passhash.h>
+#include <common/rsa_wrapper.h>
+#include <common/thread_rng.h>
+#include <cryptopp/hex.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Print one result line
+static void report(const char* operation, const char* generator, Clock::duration spent, size_t operations) {
+    double perOperation = std::chrono::duration<double, std::micro>(spent).count() / static_cast<double>(operations);
+    std::printf("%-12s %-22s %12.2f %14.0f\n", operation, generator, perOperation, 1e6 / perOperation);
+}
+
+// A salt as GenerateRandomSalt made it before ThreadRng: a new, freshly seeded pool per salt
+static std::string seededSalt() {
+    CryptoPP::AutoSeededRandomPool rng;
+    CryptoPP::byte salt[16];
+    rng.GenerateBlock(salt, sizeof(salt));
+    std::string hex;
+    CryptoPP::HexEncoder encoder(new CryptoPP::StringSink(hex));
+    encoder.Put(salt, sizeof(salt));
+    encoder.MessageEnd();
+    return hex;
+}
+
+// Generate salts on every core, returns the time taken
+static Clock::duration parallelSalts(size_t threads, size_t perThread, bool threadRng) {
+    std::atomic<size_t> made(0);
+    std::vector<std::thread> workers;
+    auto begin = Clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            for (size_t i = 0; i < perThread; i++) {
+                made += (threadRng ? PasswordHasher::GenerateRandomSalt(16) : seededSalt()).size();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return Clock::now() - begin;
+}
+
+int main(int argc, char** argv) {
+    size_t scale = argc > 1 ? std::max<size_t>(std::strtoul(argv[1], nullptr, 10), 1) : 1;
+    std::printf("%-12s %-22s %12s %14s\n", "operation", "generator", "us/op", "ops/s");
+
+    size_t salts = 20000 * scale;
+    auto begin = Clock::now();
+    for (size_t i = 0; i < salts; i++) {
+        seededSalt();
+    }
+    report("salt", "new pool per salt", Clock::now() - begin, salts);
+    begin = Clock::now();
+    for (size_t i = 0; i < salts; i++) {
+        PasswordHasher::GenerateRandomSalt(16);
+    }
+    report("salt", "ThreadRng", Clock::now() - begin, salts);
+
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    report("salt (all)", "new pool per salt", parallelSalts(threads, salts / threads, false), salts / threads * threads);
+    report("salt (all)", "ThreadRng", parallelSalts(threads, salts / threads, true), salts / threads * threads);
+
+    DHKeyExchange::createDomainParameters();
+    size_t keys = 200 * scale;
+    CryptoPP::AutoSeededRandomPool shared;
+    CryptoPP::SecByteBlock privateKey(DHKeyExchange::dhA.PrivateKeyLength()), publicKey(DHKeyExchange::dhA.PublicKeyLength());
+    begin = Clock::now();
+    for (size_t i = 0; i < keys; i++) {
+        DHKeyExchange::dhA.GenerateKeyPair(shared, privateKey, publicKey);
+    }
+    report("dh keygen", "shared pool", Clock::now() - begin, keys);
+    begin = Clock::now();
+    for (size_t i = 0; i < keys; i++) {
+        DHKeyExchange::createAsymmetricKey(DHKeyExchange::dhA, privateKey, publicKey);
+    }
+    report("dh keygen", "ThreadRng", Clock::now() - begin, keys);
+
+    RSAWrapper rsa;
+    std::string secret(32, 's');
+    size_t encryptions = 2000 * scale;
+    CryptoPP::AutoSeededRandomPool owned;
+    begin = Clock::now();
+    for (size_t i = 0; i < encryptions; i++) {
+        rsa.encrypt(secret, rsa.publicKey, owned);
+    }
+    report("oaep", "wrapper's pool", Clock::now() - begin, encryptions);
+    begin = Clock::now();
+    for (size_t i = 0; i < encryptions; i++) {
+        rsa.encrypt(secret, rsa.publicKey);
+    }
+    report("oaep", "ThreadRng", Clock::now() - begin, encryptions);
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file bench/bench_verify.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief Benchmark for batched password verification
+ *
+ * Measures how many SHA-256 salted passwords (the original users file format) can be verified per second:
+ * - single: one VerifyPassword call per password, as logins were checked before batching.
+ * - batched: one VerifyPasswords call per batch of 8, 64 and 256 passwords, as the verify batcher checks a login storm.
+ * - raw lanes: Sha256Lanes alone on the same messages, the cost of the hashing without parsing or comparing.
+ * Prints the time per password and the throughput. An optional argument sets the number of passwords (default 65536).
+*/
+
+#include <common/passhash.h>
+#include <common/sha256_lanes.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Print one result line
+static void report(const char* name, double nanoseconds, size_t passwords) {
+    double perPassword = nanoseconds / static_cast<double>(passwords);
+    std::printf("%-16s %12.1f %14.0f\n", name, perPassword, 1e9 / perPassword);
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 65536;
+    if (count < 256) {
+        count = 256;
+    }
+    std::vector<std::string> passwords(count), records(count);
+    for (size_t i = 0; i < count; i++) {
+        passwords[i] = "password" + std::to_string(i);
+        records[i] = PasswordHasher::HashPassword(passwords[i], PasswordHasher::GenerateRandomSalt(16));
+    }
+    std::printf("%zu passwords, lanes: %s\n", count, Sha256Lanes::implementation());
+    std::printf("%-16s %12s %14s\n", "method", "ns/password", "passwords/s");
+
+    size_t verified = 0;
+    auto begin = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        verified += PasswordHasher::VerifyPassword(passwords[i], records[i]);
+    }
+    report("single", std::chrono::duration<double, std::nano>(Clock::now() - begin).count(), count);
+
+    for (size_t batch : {8, 64, 256}) {
+        std::vector<PasswordHasher::Candidate> candidates;
+        begin = Clock::now();
+        for (size_t first = 0; first < count; first += batch) {
+            candidates.clear();
+            for (size_t i = first; i < first + batch && i < count; i++) {
+                candidates.push_back({passwords[i], records[i]});
+            }
+            for (bool verdict : PasswordHasher::VerifyPasswords(candidates)) {
+                verified += verdict;
+            }
+        }
+        std::string name = "batched " + std::to_string(batch);
+        report(name.c_str(), std::chrono::duration<double, std::nano>(Clock::now() - begin).count(), count);
+    }
+
+    std::vector<Sha256Lanes::Message> messages(count);
+    for (size_t i = 0; i < count; i++) {
+        messages[i] = {passwords[i], std::string_view(records[i]).substr(0, 32)};
+    }
+    std::vector<unsigned char> digests(count * Sha256Lanes::DIGEST_SIZE);
+    begin = Clock::now();
+    Sha256Lanes::hash(messages.data(), messages.size(), digests.data());
+    report("raw lanes", std::chrono::duration<double, std::nano>(Clock::now() - begin).count(), count);
+
+    if (verified != 4 * count) {
+        std::printf("verification failed: %zu of %zu\n", verified, 4 * count);
+        return 1;
+    }
+    return 0;
+}
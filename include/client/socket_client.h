@@ -13,6 +13,8 @@
 #include <common/dh_key.h>
 #include <unistd.h>
 #include <common/rsa_wrapper.h>
+#include <common/framing.h>
+#include <common/session_ticket.h>
 
 /**
  * @brief A class to manage the client side of the chat application
@@ -29,9 +31,12 @@ public:
     bool connectToServer(); // Connect to the server
     void disconnect(); // Disconnect from the server
     void sendMessage(const nlohmann::json& message); // Send a message to the server (json)
+    bool sendCommand(const nlohmann::json& command); // Send a command to the server itself (needs binary framing)
+    bool nextMessage(std::string& buffer, std::string& message); // Extract the next complete message from the receive buffer
 
     // Atomic variable to control the status of the client (can be accessed by multiple threads)
     std::atomic<bool> status{true}; // Flag to indicate if the client is active (atomic for thread safety)
+    std::atomic<bool> binaryFraming{false}; // Flag to indicate if the server accepted length-prefixed binary frames
     int sock;
     std::string server_ip;
     int port;
@@ -41,6 +46,9 @@ public:
     std::string username;
     std::string password;
     int authType;
+    std::string sessionTicket; // resumption ticket from the last login, empty if none
+    std::string ticketSecret; // the ticket's secret, decrypted with our private key
+    bool handshaking = true; // still logging in: only the server talks to us, nothing is relayed from a partner yet
 
     void printColoredMessage(const std::string& message, const std::string& color, WINDOW* outputWin); // Print colored message (output window)
     void printColoredMessage(const std::string& message, const std::string& color); // Print colored message (standard output)
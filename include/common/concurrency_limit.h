@@ -0,0 +1,46 @@
+#ifndef CONCURRENCY_LIMIT_H
+#define CONCURRENCY_LIMIT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+/**
+ * @brief Admission control for expensive work
+ *
+ * A counting semaphore: at most limit callers hold a slot at once, the others wait for one in turn. Expensive work (a password hash) that arrives in a burst then queues up instead of running everywhere at once and starving the rest of the process.
+ *
+ * Thread safe. The limit can be changed at any time, callers already holding a slot keep it.
+*/
+class ConcurrencyLimit {
+public:
+    /**
+     * @brief A held slot, released when destroyed
+    */
+    class Slot {
+    public:
+        explicit Slot(ConcurrencyLimit& limit) : limit(limit) { limit.acquire(); }
+        ~Slot() { limit.release(); }
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+    private:
+        ConcurrencyLimit& limit;
+    };
+
+    explicit ConcurrencyLimit(size_t limit = 0); // constructor (0: no limit)
+
+    void setLimit(size_t limit); // change the number of slots (0: no limit)
+    void acquire(); // wait for a slot and take it
+    void release(); // give a slot back
+    size_t active() const; // slots taken
+    size_t waiting() const; // callers waiting for a slot
+
+private:
+    mutable std::mutex mutex; // protects the counts
+    std::condition_variable freed; // signalled when a slot may be free
+    size_t limit; // number of slots, 0 for no limit
+    size_t taken = 0; // slots taken
+    size_t queued = 0; // callers waiting
+};
+
+#endif // CONCURRENCY_LIMIT_H
@@ -3,13 +3,14 @@
 
 #include <cryptopp/dh.h>
 #include <cryptopp/osrng.h>
+#include <common/thread_rng.h>
 
 /**
  * @brief A class to manage Diffie-Hellman key exchange
  * 
  * This class is used to manage Diffie-Hellman key exchange. It provides methods to generate domain parameters, create asymmetric key pairs, and create symmetric keys.
  * 
- * The class uses Crypto++ library for Diffie-Hellman key exchange.
+ * The class uses Crypto++ library for Diffie-Hellman key exchange. Key pairs are generated with the calling thread's random generator (see ThreadRng).
 */
 class DHKeyExchange {
 public:
@@ -17,7 +18,6 @@ public:
     static void createAsymmetricKey(const CryptoPP::DH &dh, CryptoPP::SecByteBlock &privKey,  CryptoPP::SecByteBlock &pubKey); // Generate asymmetric key pair (aka private and public key)
     static void createSymmetricKey(const CryptoPP::DH &dh,const CryptoPP::SecByteBlock &privKey, const CryptoPP::SecByteBlock &pubKey); // Generate symmetric key
 
-    static CryptoPP::AutoSeededRandomPool rnd; // Random number generator
     static CryptoPP::DH dhA; // Domain parameters for A
     static CryptoPP::SecByteBlock privKeyA, pubKeyA, pubKeyB; // Private key of A, public key of A and B
     
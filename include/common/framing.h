@@ -0,0 +1,47 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Utilities to split a byte stream into messages
+ *
+ * Two framings are supported on the same socket:
+ * - JSON framing (the default): clients send JSON objects back to back and the server ends every message with a newline. Message boundaries are found without parsing, by tracking brace depth and string state.
+ * - Binary framing (negotiated during the handshake): every message is a 4 byte big endian payload length, a 1 byte frame type and the payload. The receiver knows the size of a message from its header, so it never scans for a delimiter and can forward the payload without re-encoding it.
+*/
+class Framing {
+public:
+    enum class FrameType : uint8_t {
+        Json = 1, // payload is a JSON message
+        Control = 2 // payload is a JSON command for the server itself (e.g. joining a room), never relayed
+    };
+
+    /**
+     * @brief Progress of a JSON scan that ran out of data
+     *
+     * Keeping the state between reads means a large message is scanned once in total, not once per read.
+    */
+    struct JsonScanState {
+        size_t position = 0; // bytes already scanned
+        size_t start = 0; // offset where the value starts
+        size_t depth = 0; // bracket depth
+        bool inString = false; // inside a string
+        bool escaped = false; // the previous character was a backslash inside a string
+    };
+
+    static constexpr size_t INCOMPLETE = 0; // the data ends before the message does
+    static constexpr size_t INVALID = SIZE_MAX; // the data is not a valid message
+    static constexpr size_t HEADER_SIZE = 5; // size of a binary frame header
+
+    static size_t scanJson(const char* data, size_t size, size_t& start); // find the first JSON value, returns the offset just past it
+    static size_t scanJson(const char* data, size_t size, size_t& start, JsonScanState& state); // same, resuming a previous incomplete scan
+    static size_t binaryLength(const char* header); // payload size announced by a binary frame header
+    static size_t scanBinary(const char* data, size_t size, size_t& start, FrameType& type); // find the first binary frame, returns the offset just past it
+    static void encodeHeader(char* header, size_t payloadSize, FrameType type); // write a binary frame header (HEADER_SIZE bytes)
+    static std::string encodeBinary(const std::string& payload, FrameType type = FrameType::Json); // build a complete binary frame
+};
+
+#endif // FRAMING_H
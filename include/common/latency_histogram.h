@@ -0,0 +1,40 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief A histogram of durations with power of two buckets
+ *
+ * Bucket i counts the durations from 2^(i-1) to 2^i - 1 microseconds (bucket 0: under a microsecond), so a few dozen counters cover everything from a hash to a stuck thread, at the cost of reporting percentiles as the upper bound of their bucket (within a factor of two).
+ *
+ * Recording is lock-free and thread safe, readers see counts that may be a few recordings behind.
+*/
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKETS = 40; // the last bucket takes everything from about 3 days up
+
+    LatencyHistogram(); // constructor (empty)
+
+    // Non-copyable and non-movable (recorded into from many threads)
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(std::chrono::nanoseconds duration); // count a duration
+    uint64_t count() const; // durations recorded
+    uint64_t bucket(size_t index) const; // durations recorded in a bucket
+    std::chrono::microseconds mean() const; // average duration
+    std::chrono::microseconds percentile(double fraction) const; // upper bound of the duration that fraction (0 to 1) of the recordings did not exceed
+
+    static std::chrono::microseconds upperBound(size_t index); // longest duration a bucket counts
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS]; // durations per bucket
+    std::atomic<uint64_t> total; // durations recorded
+    std::atomic<uint64_t> sum; // summed durations, in microseconds
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -2,23 +2,73 @@
 #define PASSWORDHASHER_H
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
 #include <cryptopp/sha.h>
 #include <cryptopp/filters.h>
 #include <cryptopp/hex.h>
 #include <cryptopp/osrng.h>
+#include <cryptopp/pwdbased.h>
+#include <cryptopp/scrypt.h>
+#include <common/latency_histogram.h>
+#include <common/concurrency_limit.h>
+#include <common/sha256_lanes.h>
 
 /**
  * @brief A class to hash passwords using SHA-256
  * 
  * This class is used to hash passwords using SHA-256 and a random salt. It provides methods to generate a random salt, hash a password using the salt, and verify if a password matches the expected hash.
+ * 
+ * Passwords can also be hashed with a deliberately slow key derivation function: PBKDF2-HMAC-SHA256, or scrypt, which also needs a lot of memory so guesses cannot be run in parallel cheaply. Stored hashes say which function made them ("$pbkdf2-sha256$<iterations>$<salt>$<hash>", "$scrypt$<N>$<salt>$<hash>", plain "<salt><hash>" for SHA-256), so users hashed before the function was changed keep logging in.
+ * 
+ * Every hash is timed in a latency histogram per function, and at most a set number of hashes are computed at once: the others wait for their turn, so a burst of logins queues up instead of taking every core.
+ * 
+ * Passwords can be verified in batches. The ones stored with SHA-256 are then hashed eight at a time (see Sha256Lanes), in one slot, which is several times faster than one by one during a login storm; the slow functions gain nothing from it and are verified one by one.
 */
 class PasswordHasher {
 public:
+    /**
+     * @brief The function a password is hashed with
+    */
+    enum class Algorithm : uint8_t {
+        Sha256 = 0, // one salted SHA-256 (the original format)
+        Pbkdf2Sha256 = 1, // PBKDF2-HMAC-SHA256, cost: iterations
+        Scrypt = 2 // scrypt with block size 8 and no parallelism, cost: N (a power of two, memory used is 1 KiB * N)
+    };
+
+    /**
+     * @brief A function and its cost
+    */
+    struct Kdf {
+        Algorithm algorithm = Algorithm::Sha256;
+        uint32_t cost = 0; // ignored for SHA-256
+    };
+
+    /**
+     * @brief A password to verify against a stored hash (both must outlive the verification)
+    */
+    struct Candidate {
+        std::string_view password;
+        std::string_view saltedHash;
+    };
+
     static std::string GenerateRandomSalt(size_t length); // Generate a random salt of a specified length
     static std::string HashPassword(const std::string& password, const std::string& salt); // Hash the password using SHA-256 and a given salt
-    static bool VerifyPassword(const std::string& password, const std::string& saltedHash); // Verify if the provided password matches the expected hash when using the same salt
+    static std::string HashPassword(const std::string& password, const std::string& salt, const Kdf& kdf); // Hash the password with a given function, the result says which one
+    static bool VerifyPassword(const std::string& password, const std::string& saltedHash); // Verify if the provided password matches the expected hash when using the same salt (and function)
+    static std::vector<bool> VerifyPasswords(const std::vector<Candidate>& candidates); // Verify several passwords at once, the results are in the same order
+    static bool IsBatchable(std::string_view saltedHash); // Check if VerifyPasswords hashes a stored hash together with others (SHA-256) rather than on its own
+    static bool ParseRecord(const std::string& saltedHash, Kdf& kdf, std::string& salt, std::string& hash); // Split a stored hash into its function, salt and hash, false if it is malformed
+    static std::string FormatRecord(const Kdf& kdf, const std::string& salt, const std::string& hash); // Make a stored hash from its parts
+    static bool ValidKdf(const Kdf& kdf); // Check that a function's cost is usable
+    static void SetConcurrencyLimit(size_t limit); // Set the number of hashes computed at once (0: no limit)
+    static const LatencyHistogram& Latency(Algorithm algorithm); // Time taken by the hashes made with a function
 
 private:
+    static std::string Derive(const std::string& password, const std::string& salt, const Kdf& kdf); // Hash a password (hex), waiting for a slot and timing it
+    static ConcurrencyLimit& Admission(); // The slots for hashes
+    static LatencyHistogram* Histograms(); // The hash times, one histogram per function
     static std::string ToHexString(const unsigned char* data, size_t length); // Utility function to convert binary data to a hex string
 };
 
@@ -7,21 +7,24 @@
 #include <cryptopp/files.h> 
 #include <cryptopp/base64.h> 
 #include <nlohmann/json.hpp>
+#include <common/thread_rng.h>
 
 /**
  * @brief A class to manage RSA encryption and decryption
  * 
  * This class is used to manage RSA encryption and decryption. It provides methods to encrypt and decrypt data, save and load keys to and from files, and send and receive public keys.
  * 
- * The class uses Crypto++ library for RSA encryption and decryption.
+ * The class uses Crypto++ library for RSA encryption and decryption. Key generation, padding and blinding take their randomness from the calling thread's generator (see ThreadRng), unless the caller supplies one.
 */
 class RSAWrapper {
 public:
     RSAWrapper();  // Constructor to initialize keys
     ~RSAWrapper(); // Destructor
 
-    std::string encrypt(const std::string& plainText, const CryptoPP::RSA::PublicKey& publicKey); // encrypt data using external public key
-    std::string decrypt(const std::string& cipherText); // Decrypt data
+    std::string encrypt(const std::string& plainText, const CryptoPP::RSA::PublicKey& publicKey) const; // encrypt data using external public key (thread safe)
+    std::string encrypt(const std::string& plainText, const CryptoPP::RSA::PublicKey& publicKey, CryptoPP::RandomNumberGenerator& rng) const; // encrypt data with the caller's random generator (thread safe)
+    std::string decrypt(const std::string& cipherText) const; // Decrypt data (thread safe)
+    std::string decrypt(const std::string& cipherText, CryptoPP::RandomNumberGenerator& rng) const; // Decrypt data with the caller's random generator (thread safe)
 
     void savePublicKey(const std::string& filename);  // Save public key to a file
     void savePrivateKey(const std::string& filename); // Save private key to a file
@@ -38,8 +41,6 @@ public:
     CryptoPP::RSA::PublicKey publicKeyB; // Other user's public key
 
 private:
-    CryptoPP::AutoSeededRandomPool rng; // Random number generator
-
     void initializeKeys(); // Helper function to initialize keys
 };
 
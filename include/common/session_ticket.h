@@ -0,0 +1,51 @@
+#ifndef SESSION_TICKET_H
+#define SESSION_TICKET_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <cryptopp/hmac.h>
+#include <cryptopp/sha.h>
+#include <cryptopp/osrng.h>
+
+/**
+ * @brief Resumption tickets that let a client log in again without RSA
+ *
+ * After a full login the server issues a ticket: the username and an expiry time, authenticated with an HMAC-SHA256 under a key only the server knows. With it comes a secret derived from the same key and the same fields, sent to the client encrypted with its public key. The server keeps no per-ticket state, it recomputes the secret from the ticket when it is presented.
+ *
+ * To resume, the client answers the random nonce the server sends with its public key with the ticket and an HMAC of the nonce under the secret. Checking it costs a few HMACs instead of an RSA decryption and a password hash, and the ticket alone (seen on the wire) is useless without the secret.
+ *
+ * The key is random per server instance, so tickets do not survive a restart: the client then falls back to a full login.
+*/
+class SessionTicket {
+public:
+    using Clock = std::chrono::system_clock;
+
+    /**
+     * @brief A ticket and the secret that goes with it
+    */
+    struct Issued {
+        std::string ticket; // handed to the client in clear
+        std::string secret; // hex, must reach the client encrypted
+    };
+
+    explicit SessionTicket(std::chrono::seconds lifetime); // constructor (random key)
+    SessionTicket(const std::string& key, std::chrono::seconds lifetime); // constructor with a given key
+
+    Issued issue(const std::string& username) const; // issue a ticket for a logged in user (thread safe)
+    bool redeem(const std::string& ticket, const std::string& nonce, const std::string& proof, std::string& username) const; // check a ticket and its proof, sets the username (thread safe)
+    std::chrono::seconds lifetime() const { return ttl; } // how long a ticket is valid
+
+    static std::string proof(const std::string& secret, const std::string& nonce); // the client's answer to a nonce
+    static std::string makeNonce(CryptoPP::RandomNumberGenerator& rng); // a random nonce to send with the public key
+
+private:
+    std::string mac(const std::string& label, const std::string& payload) const; // HMAC of a labelled payload under the server key
+    static std::string hmac(const std::string& key, const std::string& message); // hex HMAC-SHA256
+    static bool equal(const std::string& a, const std::string& b); // compare without leaking where they differ
+
+    std::string key; // server key, never leaves the server
+    std::chrono::seconds ttl; // ticket lifetime
+};
+
+#endif // SESSION_TICKET_H
@@ -0,0 +1,33 @@
+#ifndef SHA256_LANES_H
+#define SHA256_LANES_H
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief SHA-256 of several short messages at once
+ *
+ * A multi-buffer implementation: eight messages are hashed side by side, one per 32-bit lane, so every step of the compression function is a single AVX2 instruction for all eight. On CPUs without AVX2 the same code runs with narrower vectors (SSE2 on x86-64, or scalar code elsewhere); the best version is picked when the program starts.
+ *
+ * Meant for many small messages (salted passwords), where hashing them one by one costs more in setup than in compression. Messages of different lengths share a group: a lane whose message has no more blocks just stops changing. Nothing is allocated.
+ *
+ * The functions are thread safe.
+*/
+class Sha256Lanes {
+public:
+    static constexpr size_t LANES = 8; // messages hashed together
+    static constexpr size_t DIGEST_SIZE = 32; // bytes in a digest
+
+    /**
+     * @brief A message, hashed as its head followed by its tail (so a password and its salt need not be joined first)
+    */
+    struct Message {
+        std::string_view head;
+        std::string_view tail;
+    };
+
+    static void hash(const Message* messages, size_t count, unsigned char* digests); // hash count messages, digests gets DIGEST_SIZE bytes per message in order
+    static const char* implementation(); // name of the version picked for this CPU ("avx2" or "generic")
+};
+
+#endif // SHA256_LANES_H
@@ -0,0 +1,44 @@
+#ifndef THREAD_RNG_H
+#define THREAD_RNG_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cryptopp/cryptlib.h>
+#include <cryptopp/osrng.h>
+
+/**
+ * @brief The calling thread's cryptographic random generator
+ *
+ * Crypto++ generators are not thread safe, and seeding one reads the operating system's entropy source, which costs more than most of what the generator is then used for (a salt, a nonce, RSA padding). So every thread gets one generator, seeded the first time the thread asks for it, and everything that needs randomness (salts, keys, padding, nonces) asks get() for it instead of making or sharing its own.
+ *
+ * The generator is reseeded from the operating system after it produced RESEED_BYTES, or once RESEED_INTERVAL passed since it was seeded, whichever comes first, so a long lived thread does not run on one seed forever.
+ *
+ * A generator must only be used by the thread that got it.
+*/
+class ThreadRng : public CryptoPP::RandomNumberGenerator {
+public:
+    static constexpr uint64_t RESEED_BYTES = 1 << 20; // output between reseeds
+    static constexpr std::chrono::minutes RESEED_INTERVAL{10}; // longest time between reseeds
+
+    static ThreadRng& get(); // the calling thread's generator (seeded on first use)
+
+    // Non-copyable and non-movable (one per thread)
+    ThreadRng(const ThreadRng&) = delete;
+    ThreadRng& operator=(const ThreadRng&) = delete;
+
+    void GenerateBlock(CryptoPP::byte* output, size_t size) override; // fill output with random bytes, reseeding first if it is due
+    bool CanIncorporateEntropy() const override; // true, entropy can be added
+    void IncorporateEntropy(const CryptoPP::byte* input, size_t length) override; // mix entropy into the generator
+    uint64_t reseeds() const; // times this generator was reseeded since it was made
+
+private:
+    ThreadRng(); // constructor (seeds the generator)
+
+    CryptoPP::AutoSeededRandomPool pool; // the generator
+    uint64_t generated = 0; // bytes produced since the last seed
+    std::chrono::steady_clock::time_point seeded; // when the generator was last seeded
+    uint64_t reseedCount = 0; // reseeds so far
+};
+
+#endif // THREAD_RNG_H
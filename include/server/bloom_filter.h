@@ -0,0 +1,35 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * @brief A Bloom filter over strings
+ *
+ * A set that may answer "maybe" for a string never added (about 1% of the time at its capacity with the default 10 bits per item) but never answers "no" for one that was. Checking a string costs one hash and a few bit tests, and the filter takes a few bits per item whatever their size.
+ *
+ * Adding and checking are lock-free and thread safe. Items cannot be removed, and the filter does not grow: past its capacity it keeps working, its false positives just get more frequent.
+*/
+class BloomFilter {
+public:
+    explicit BloomFilter(size_t capacity, size_t bitsPerItem = 10); // constructor (sized for capacity items)
+
+    // Non-copyable and non-movable (shared by the threads checking it)
+    BloomFilter(const BloomFilter&) = delete;
+    BloomFilter& operator=(const BloomFilter&) = delete;
+
+    void add(const std::string& item); // add an item
+    bool mayContain(const std::string& item) const; // false if the item was never added
+    size_t bitCount() const { return bits; } // size of the filter in bits
+
+private:
+    size_t bits; // number of bits, a power of two
+    size_t hashes; // bits set per item
+    std::unique_ptr<std::atomic<uint64_t>[]> words; // the bits
+};
+
+#endif // BLOOM_FILTER_H
@@ -0,0 +1,65 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cryptopp/rsa.h>
+#include <server/timer_wheel.h>
+#include <server/input_buffer.h>
+#include <server/output_queue.h>
+#include <server/lobby.h>
+#include <server/room.h>
+#include <server/token_bucket.h>
+#include <common/framing.h>
+
+class Reactor;
+
+/**
+ * @brief The state of one client connection
+ *
+ * This struct holds everything the server knows about a connected client. It replaces the thread that used to be created for every pair of clients: a chat session is now just connections sharing a Room, driven by the event loop of the reactor that owns them.
+ *
+ * The handshake is a small state machine so many clients can be verified at the same time without blocking: the server sends its public key on accept, then waits for the client's public key, then for its credentials. A client holding a resumption ticket answers the public key with the ticket instead and is logged in straight away.
+*/
+struct Connection {
+    enum class State {
+        AwaitingPublicKey, // server public key sent, waiting for the client's (or a resumption ticket)
+        AwaitingCredentials, // prompt sent, waiting for username and password
+        Authenticating, // credentials handed to the worker pool (or ticket accepted), reads paused until the verdict is back
+        Verified // logged in, waiting for a partner or chatting
+    };
+
+    Connection(int socket, Reactor* reactor) : socket(socket), reactor(reactor) {}
+
+    int socket; // client socket
+    Reactor* reactor; // reactor that owns the connection, only its thread may touch it
+    uint64_t handle = 0; // handle in the reactor's session registry, stale once the connection is closed or moved
+    State state = State::AwaitingPublicKey; // handshake progress
+    std::string username; // set once logged in
+    bool binaryFraming = false; // length-prefixed frames negotiated (otherwise newline/brace delimited JSON)
+    CryptoPP::RSA::PublicKey publicKey; // the client's public key
+    std::string nonce; // random challenge sent with the server's public key, a resuming client signs it with its ticket's secret
+    std::shared_ptr<Room> room; // chat the client is in (its members are on the same reactor), nullptr while waiting for a partner
+    size_t roomIndex = 0; // position in the room's member list
+    bool congested = false; // output queue went over the high watermark and has not drained to the low one yet
+    std::vector<std::string> watching; // users whose presence changes the client is told about
+    std::vector<std::pair<std::string, bool>> presenceUpdates; // presence changes not sent yet (user, online)
+    std::shared_ptr<Lobby::Ticket> lobbyTicket; // place in the lobby, cancelled if the client leaves while waiting
+    InputBuffer input; // start of a message that has not fully arrived yet
+    Framing::JsonScanState scan; // progress of the framing scan over input
+    std::string_view unhandled; // while one of its messages is handled: the data that follows it, not handled yet (data() is nullptr the rest of the time)
+    OutputQueue output; // data the client has not accepted yet
+    bool readPaused = false; // reads stopped because a room member's output queue is over the high watermark
+    TokenBucket messageBucket; // messages the client may send
+    TokenBucket byteBucket; // bytes the client may send
+    bool rateLimited = false; // reads stopped because the client went over its rate limits, until rateTimer fires
+    bool rateWarned = false; // told that its messages are dropped, not told again until one gets through
+    TimerWheel::Timer deadline; // handshake deadline, then idle deadline once verified
+    TimerWheel::Timer writeDeadline; // scheduled while the client is not reading what we send
+    TimerWheel::Timer rateTimer; // resumes reading from a rate limited client
+};
+
+#endif // CONNECTION_H
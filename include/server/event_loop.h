@@ -0,0 +1,46 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+
+/**
+ * @brief A class to wait for readiness events on many sockets at once
+ *
+ * This class is a thin wrapper around epoll. Sockets are registered together with a callback, and poll() waits for readiness and calls the callback of every socket that is ready.
+ *
+ * The loop is not thread safe, it must only be used from the thread that calls poll().
+*/
+class EventLoop {
+public:
+    using Callback = std::function<void(uint32_t events)>; // called with the ready epoll events of a socket
+
+    EventLoop(); // constructor
+    ~EventLoop(); // destructor
+
+    // Non-copyable and non-movable (owns the epoll descriptor)
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool add(int fd, uint32_t events, Callback callback); // start watching a socket
+    bool modify(int fd, uint32_t events); // change the events watched for a socket
+    void remove(int fd); // stop watching a socket (call before closing it)
+    int poll(int timeoutMs); // wait for events and dispatch them, returns the number of events handled
+    size_t size() const; // number of watched sockets
+
+private:
+    struct Entry {
+        uint32_t generation; // changes on every add so stale events for a reused fd are ignored
+        Callback callback;
+    };
+
+    int epollFd; // epoll descriptor
+    uint32_t nextGeneration; // generation given to the next registered socket
+    std::unordered_map<int, Entry> entries; // registered sockets keyed by fd
+    std::vector<epoll_event> events; // buffer filled by epoll_wait
+};
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,36 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Calls back when a file is written to
+ *
+ * Watches a file with inotify from a thread of its own, which sleeps until the kernel reports a change. The directory is watched rather than the file, so the file may not exist yet and may be replaced (moved over, or deleted and created again) without the watch being lost.
+ *
+ * Changes that arrive together are reported once: after a callback, everything the kernel queued meanwhile is read and the callback runs once more. A callback is never run twice at the same time.
+*/
+class FileWatcher {
+public:
+    using Callback = std::function<void()>; // runs on the watcher thread
+
+    FileWatcher(const std::string& path, Callback changed); // constructor (starts watching, throws if inotify fails; an empty path watches nothing)
+    ~FileWatcher(); // destructor (stops the thread, waiting for a running callback)
+
+    // Non-copyable and non-movable (the thread points at it)
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+private:
+    void watch(); // thread body: wait for changes until stopped
+
+    std::string name; // the file's name in its directory
+    Callback changed; // called after the file changed
+    int inotifyFd = -1; // the inotify instance
+    int stopFd = -1; // eventfd written by the destructor
+    std::thread watcher; // waits for changes
+};
+
+#endif // FILE_WATCHER_H
@@ -0,0 +1,35 @@
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief A growable buffer for data read from a socket
+ *
+ * This class holds the part of a client's stream that does not form a complete message yet. It grows to fit large messages and gives its memory back once it is drained, so idle connections cost nothing.
+*/
+class InputBuffer {
+public:
+    InputBuffer(); // constructor
+
+    const char* data() const; // start of the unconsumed data
+    size_t size() const; // number of unconsumed bytes
+    bool empty() const; // check if there is no unconsumed data
+    size_t capacity() const; // bytes of memory currently held
+
+    char* prepare(size_t length); // make room for at least length more bytes and return where to write them
+    size_t writable() const; // room left after prepare()
+    void commit(size_t length); // mark bytes written after prepare() as data
+    void append(const char* data, size_t length); // copy bytes to the end of the buffer
+    void consume(size_t length); // drop bytes from the front of the buffer
+
+private:
+    static constexpr size_t RETAIN_LIMIT = 64 * 1024; // larger buffers are freed once drained
+
+    std::vector<char> storage; // memory, data lives in [readPos, writePos)
+    size_t readPos; // offset of the first unconsumed byte
+    size_t writePos; // offset just past the last byte
+};
+
+#endif // INPUT_BUFFER_H
@@ -0,0 +1,89 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class Reactor;
+
+/**
+ * @brief Matchmaking queue of logged in clients waiting for a partner
+ *
+ * Every reactor puts its verified clients here and takes pairs out, without a lock: the queue is a bounded multi-producer multi-consumer ring (Dmitry Vyukov's design) where producers and consumers only contend on one atomic position each.
+ *
+ * A client that leaves while waiting is not searched for and removed. Its entry carries a ticket shared with the connection: leaving cancels the ticket, and match() drops cancelled entries when it reaches them. Claiming a ticket for a match and cancelling it race on the same atomic, so a client is either matched or gone, never both.
+ *
+ * Whoever adds an entry calls match() afterwards, and match() only gives up once fewer than two entries are queued, so two waiting clients are always paired.
+*/
+class Lobby {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief The state of one client's place in the lobby, shared by the queue entry and the connection
+    */
+    struct Ticket {
+        enum State { Waiting, Claimed, Cancelled };
+        std::atomic<int> state{Waiting};
+    };
+
+    /**
+     * @brief A waiting client
+    */
+    struct Entry {
+        Reactor* reactor = nullptr; // reactor that owns the client
+        uint64_t handle = 0; // the client's handle in that reactor's session registry
+        std::shared_ptr<Ticket> ticket; // cancelled if the client leaves
+        Clock::time_point since; // when the client started waiting
+    };
+
+    /**
+     * @brief Two clients taken out of the lobby to chat with each other
+    */
+    struct Match {
+        Entry waiting; // the client that waited longer
+        Entry joining; // its partner
+    };
+
+    explicit Lobby(size_t capacity); // constructor (capacity is rounded up to a power of two)
+
+    // Non-copyable and non-movable (shared by the reactors)
+    Lobby(const Lobby&) = delete;
+    Lobby& operator=(const Lobby&) = delete;
+
+    std::shared_ptr<Ticket> enter(Reactor* reactor, uint64_t handle); // queue a client, nullptr if the lobby is full
+    bool leave(const std::shared_ptr<Ticket>& ticket); // take a client out (lazily, its entry is skipped later), returns false if it was already claimed
+    bool match(Match& match); // take the two longest waiting clients, false if fewer than two are waiting
+
+    size_t waiting() const; // number of clients waiting
+    uint64_t matches() const; // number of pairs made
+    std::chrono::microseconds averageWait() const; // mean time a matched client waited
+    std::chrono::microseconds longestWait() const; // longest time a matched client waited
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence; // which lap of the ring the cell is ready for
+        Entry entry;
+    };
+
+    bool push(Entry&& entry); // add an entry, false if the ring is full
+    bool pop(Entry& entry); // remove the oldest entry, false if the ring is empty
+    size_t queued() const; // entries in the ring, including cancelled ones
+    bool claim(Entry& entry); // take a popped entry for a match, drops it if it was cancelled
+    void recordWait(const Entry& entry, Clock::time_point now); // add a matched client to the wait statistics
+
+    std::unique_ptr<Cell[]> cells; // the ring
+    size_t mask; // ring size - 1
+    alignas(64) std::atomic<size_t> enqueuePos; // next cell to fill
+    alignas(64) std::atomic<size_t> dequeuePos; // next cell to empty
+    alignas(64) std::atomic<size_t> reserved; // entries in the ring or held by match(), never above the ring size
+    std::atomic<size_t> live; // clients waiting (not cancelled or claimed)
+    std::atomic<uint64_t> matched; // pairs made
+    std::atomic<uint64_t> totalWait; // summed wait of matched clients, in microseconds
+    std::atomic<uint64_t> maxWait; // longest wait of a matched client, in microseconds
+};
+
+#endif // LOBBY_H
@@ -0,0 +1,83 @@
+#ifndef OFFLINE_STORE_H
+#define OFFLINE_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct iovec;
+
+/**
+ * @brief Messages waiting for users that are not logged in
+ *
+ * An append-only log split into fixed size segment files. Every message is a record (recipient and payload) written at the end of the newest segment, so writes stay sequential; they reach the disk in batches, a background thread syncs the log every sync interval instead of once per message. Each segment is mapped in memory: a message handed back by take() points straight into the mapping, so it can be written to the recipient's socket without being copied.
+ *
+ * Delivering a user's messages appends a record saying so. A segment is deleted once every message in it and in the segments before it was delivered, oldest first, so a delivery record never outlives the messages it covers. So that a few messages nobody collects do not keep the oldest segment, and every later one, forever, the mailboxes still holding messages in it are written again at the end of the log when a new segment is started, if they are small, and the segment goes. The store may also be given a size limit: past it, the oldest segment is deleted with the messages still waiting in it.
+ *
+ * The log is read back when the store is opened: undelivered messages survive a restart. A record cut short by a crash ends its segment.
+ *
+ * All methods are thread safe.
+*/
+class OfflineStore {
+public:
+    struct Segment;
+
+    /**
+     * @brief A stored message, valid as long as the object is kept
+    */
+    struct Message {
+        std::shared_ptr<Segment> segment; // keeps the mapping alive
+        const char* data = nullptr; // the payload, inside the mapping
+        size_t size = 0; // size of the payload
+    };
+
+    OfflineStore(const std::string& directory, size_t segmentSize, std::chrono::milliseconds syncInterval, size_t mailboxLimit, size_t storeLimit = 0); // constructor (opens or creates the log, throws if it cannot), a store limit of 0 means none
+    ~OfflineStore(); // destructor (syncs the log)
+
+    // Non-copyable and non-movable (the sync thread points at it)
+    OfflineStore(const OfflineStore&) = delete;
+    OfflineStore& operator=(const OfflineStore&) = delete;
+
+    bool append(const std::string& recipient, const char* data, size_t size); // store a message, false if the recipient's mailbox is full or the message does not fit in a segment
+    std::vector<Message> take(const std::string& recipient); // take a recipient's messages, oldest first, and mark them delivered
+    size_t pending(const std::string& recipient) const; // number of messages waiting for a recipient
+    size_t segmentCount() const; // number of segment files
+    uint64_t dropped() const; // number of messages deleted undelivered to keep the store under its limit
+    void sync(); // write everything appended so far to the disk
+
+private:
+    void open(); // read back the segments in the directory
+    bool roll(size_t reserve); // start a new segment keeping room for a record of that size, false if it cannot be created
+    bool write(uint8_t kind, const std::string& recipient, const char* data, size_t size); // append a record to the newest segment, false if it cannot be written
+    bool write(const iovec* parts, int count, size_t length); // append already encoded records to the newest segment, false if they cannot be written
+    void collect(); // delete the oldest segments while they hold no undelivered message
+    void compact(size_t reserve); // copy the mailboxes pinning the oldest segments to the newest one, keeping room for a record of that size
+    void trim(); // delete the oldest segments, undelivered messages included, while the store is over its limit
+    std::string segmentPath(uint64_t number) const; // file name of a segment
+    void syncLoop(); // sync thread body
+
+    std::string directory; // where the segment files are
+    size_t segmentSize; // size of a segment file
+    std::chrono::milliseconds syncInterval; // time between syncs
+    size_t mailboxLimit; // messages a recipient may have waiting
+    size_t segmentLimit; // segments the store may keep (0: no limit)
+    mutable std::mutex mutex; // protects everything below
+    std::map<uint64_t, std::shared_ptr<Segment>> segments; // segment files by number, the last one is written to
+    std::unordered_map<std::string, std::vector<Message>> mailboxes; // undelivered messages by recipient
+    std::vector<std::shared_ptr<Segment>> unsynced; // segments written since the last sync
+    uint64_t droppedMessages = 0; // messages deleted by trim()
+    bool segmentCreated = false; // a segment file was created since the last sync
+    std::condition_variable wake; // signalled when the store closes
+    bool stopping = false; // set by the destructor
+    std::thread syncer; // syncs the log every syncInterval
+};
+
+#endif // OFFLINE_STORE_H
@@ -0,0 +1,38 @@
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+
+/**
+ * @brief A queue of data waiting to be written to a socket
+ *
+ * This class holds what could not be sent to a client right away. Chunks keep a reference to the buffer they point into, so a buffer can be queued for several clients without being copied. flush() hands as many chunks as possible to the kernel in one scatter/gather call.
+*/
+class OutputQueue {
+public:
+    OutputQueue(); // constructor
+
+    void push(std::string data); // queue a copy of data
+    void push(std::shared_ptr<const std::string> buffer, const char* data, size_t size); // queue part of a shared buffer without copying it
+    bool flush(int socket); // write as much as the socket accepts, returns false on a socket error
+    bool empty() const; // check if nothing is waiting
+    size_t size() const; // number of bytes waiting
+    size_t chunks() const; // number of chunks waiting
+
+private:
+    static constexpr size_t MAX_IOV = 64; // chunks handed to a single system call
+
+    struct Chunk {
+        std::shared_ptr<const std::string> owner; // keeps the memory alive
+        const char* data; // next byte to write
+        size_t size; // bytes left to write
+    };
+
+    std::deque<Chunk> queue; // chunks in send order
+    size_t bytes; // total bytes waiting
+};
+
+#endif // OUTPUT_QUEUE_H
@@ -0,0 +1,63 @@
+#ifndef PRESENCE_INDEX_H
+#define PRESENCE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Reactor;
+
+/**
+ * @brief The logged in users and who wants to know when they come and go
+ *
+ * A concurrent hash map from username to the sessions the user is logged in with, so a client can be found by name in O(1) from any reactor. A user may be logged in more than once: it is reached through its newest session, and stays online until its last session ends. The map is split into shards, each behind its own mutex, so reactors looking up or updating different users rarely wait for each other.
+ *
+ * Sessions can watch users. The index only keeps the watchers, delivering the changes is up to the caller: changing a user's presence returns the sessions to tell.
+ *
+ * A session is named by its reactor and its handle in that reactor's registry, so it must be relocated when its client moves to another reactor.
+*/
+class PresenceIndex {
+public:
+    /**
+     * @brief A logged in client, only its reactor may resolve it
+    */
+    struct Session {
+        Reactor* reactor = nullptr; // reactor that owns the client
+        uint64_t handle = 0; // the client's handle in the reactor's session registry
+
+        bool operator==(const Session& other) const { return reactor == other.reactor && handle == other.handle; }
+    };
+
+    explicit PresenceIndex(size_t shards = 64); // constructor
+
+    // Non-copyable and non-movable (shared by the reactors)
+    PresenceIndex(const PresenceIndex&) = delete;
+    PresenceIndex& operator=(const PresenceIndex&) = delete;
+
+    std::vector<Session> setOnline(const std::string& user, Session session); // record a login (the newest session is the one found), returns the watchers to tell (none if the user was online already)
+    std::vector<Session> setOffline(const std::string& user, Session session); // record a logout of that session, returns the watchers to tell (none if another session is still logged in)
+    bool find(const std::string& user, Session& session) const; // look up the newest session of a user, false if the user is offline
+    void relocate(const std::string& user, Session from, Session to); // follow a user's session to another reactor
+    bool watch(const std::string& user, Session watcher); // tell a session about a user's changes, returns true if the user is online now
+    void unwatch(const std::string& user, Session watcher); // stop telling a session about a user
+    void relocateWatcher(const std::string& user, Session from, Session to); // follow a watcher to another reactor
+    size_t online() const; // number of users logged in
+
+private:
+    struct Shard {
+        mutable std::mutex mutex; // protects the maps
+        std::unordered_map<std::string, std::vector<Session>> sessions; // logged in users and their sessions, oldest first (never empty)
+        std::unordered_map<std::string, std::vector<Session>> watchers; // sessions watching a user (online or not)
+    };
+
+    Shard& shardOf(const std::string& user) const; // shard holding a user
+
+    std::unique_ptr<Shard[]> shards; // the shards
+    size_t shardCount; // number of shards
+};
+
+#endif // PRESENCE_INDEX_H
@@ -0,0 +1,60 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <server/event_loop.h>
+#include <server/session_registry.h>
+#include <server/timer_wheel.h>
+
+class Room;
+
+/**
+ * @brief One event loop thread of the server and everything it owns
+ *
+ * The server runs one reactor per core. Each reactor has its own listening socket (bound with SO_REUSEPORT so the kernel spreads new connections over them), event loop, timer wheel and connections, so reactors never share state on the hot path.
+ *
+ * Everything in a reactor must only be touched from its own thread. Other threads hand it work with post(), which queues a task and wakes the loop through an eventfd.
+*/
+class Reactor {
+public:
+    using Task = std::function<void()>; // work run on the reactor thread
+
+    Reactor(int listenSocket, std::chrono::milliseconds timerResolution); // constructor
+    ~Reactor(); // destructor
+
+    // Non-copyable and non-movable (connections and callbacks point at it)
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    void run(const std::atomic<bool>& running); // run the loop until running is cleared or stop() is called
+    void stop(); // make run() return after the current iteration (reactor thread)
+    void post(Task task); // run a task on the reactor thread (thread safe)
+    void runTasks(); // run the queued tasks now (reactor thread, or once the reactor stopped)
+
+    int listenSocket; // listening socket of this reactor (-1 once closed for a drain)
+    EventLoop loop; // epoll loop that owns the reactor's sockets
+    TimerWheel timers; // deadlines of the reactor's connections
+    std::vector<char> readBuffer; // shared buffer for reads, only partial messages are copied out of it
+    SessionRegistry connections; // live connections
+    std::unordered_map<std::string, std::weak_ptr<Room>> rooms; // named rooms hosted here (a room lives while it has members)
+    std::vector<SessionRegistry::Handle> presenceDirty; // connections with presence changes to send
+    TimerWheel::Timer presenceFlush; // sends the gathered presence changes
+    std::atomic<size_t> queuedBytes; // bytes waiting in the output queues of the reactor's connections
+    bool draining = false; // shutting down: no new clients, each connection is closed once its output is flushed
+    TimerWheel::Timer drainDeadline; // closes the connections left when the drain takes too long
+
+private:
+    bool stopped = false; // set by stop()
+    int wakeFd; // eventfd written by post() to wake the loop
+    std::mutex mailboxMutex; // protects mailbox
+    std::vector<Task> mailbox; // tasks posted by other threads
+};
+
+#endif // REACTOR_H
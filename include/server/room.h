@@ -0,0 +1,57 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Connection;
+
+/**
+ * @brief A group of clients that receive each other's messages
+ *
+ * Every chat is a room on one reactor. The lobby makes unnamed rooms of two, clients that join a room by name share a named room with any number of members. A message from one member goes to every other member from a single SharedFrame.
+ *
+ * A room moves at the pace of its slowest reader: while any member's output queue is over the high watermark the room is congested, and members that speak have their reads paused until it drains.
+ *
+ * Only the reactor thread that owns the members may use the room.
+*/
+class Room {
+public:
+    explicit Room(std::string name = ""); // constructor (unnamed rooms are pairs made by the lobby)
+
+    const std::string& name() const; // name the room was joined by (empty for a pair)
+    bool isPair() const; // check if the room was made by the lobby
+    void add(Connection& member); // add a member (sets its index)
+    void remove(Connection& member); // remove a member in O(1)
+    size_t size() const; // number of members
+    const std::vector<Connection*>& members() const; // the members, in no particular order
+
+    size_t congested; // members whose output queue is over the high watermark
+
+private:
+    std::string roomName; // empty for a pair
+    std::vector<Connection*> memberList; // members, each knows its index
+};
+
+/**
+ * @brief One message on its way to several clients
+ *
+ * Recipients that take the message right away are sent it straight from the read buffer. The first recipient that cannot causes a single framed copy to be built for its framing (newline or binary header), and every recipient that queues the message shares that copy through its output queue.
+*/
+class SharedFrame {
+public:
+    SharedFrame(const char* data, size_t size); // constructor (data must outlive the object)
+
+    const char* data() const; // the message
+    size_t size() const; // the message size
+    const std::shared_ptr<const std::string>& framed(bool binary); // the message with its delimiter or header, built on first use
+
+private:
+    const char* payload; // the message (not owned)
+    size_t length; // the message size
+    std::shared_ptr<const std::string> frames[2]; // newline framed and binary framed copies, built on demand
+};
+
+#endif // ROOM_H
@@ -0,0 +1,59 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <common/passhash.h>
+
+/**
+ * @brief Tunable settings of the chat server
+ *
+ * This struct groups the limits and timeouts used by the Server class. The defaults are suitable for normal use, a zero timeout disables that deadline.
+*/
+struct ServerConfig {
+    /**
+     * @brief What happens to a client that sends faster than its rate limits
+    */
+    enum class RatePolicy {
+        Delay, // stop reading from the client until it is back under its limits (TCP slows the sender down)
+        Drop, // drop the messages over the limits, warning the client
+        Disconnect // disconnect the client
+    };
+
+    std::chrono::milliseconds handshakeTimeout{10000}; // time a client has to send its public key and credentials
+    std::chrono::milliseconds idleTimeout{15 * 60 * 1000}; // time a logged in client may stay silent (reset by any message in its chat)
+    std::chrono::milliseconds writeStallTimeout{30000}; // time a client may leave data unread before it is dropped
+    std::chrono::milliseconds drainTimeout{5000}; // time clients get on shutdown to receive what is queued for them before they are closed
+    std::chrono::milliseconds timerResolution{10}; // tick of the timer wheel, deadlines are rounded up to it
+    size_t reactors = 1; // event loop threads, each accepts and serves its own share of the clients
+    size_t authWorkers = 0; // threads decrypting and checking credentials (0: one per core)
+    size_t authQueueLimit = 1024; // logins waiting for a worker before new ones are turned away
+    PasswordHasher::Kdf passwordKdf{PasswordHasher::Algorithm::Scrypt, 1 << 14}; // how new users' passwords are hashed (16 MiB of memory each), existing users keep theirs
+    size_t hashConcurrency = 0; // password hashes computed at once, other logins wait for a slot (0: half the cores)
+    size_t verifyBatch = 64; // SHA-256 passwords of concurrent logins checked together at most
+    size_t lobbyCapacity = 65536; // clients waiting for a partner before new ones are turned away
+    size_t maxWatches = 256; // users a client may watch for presence changes
+    std::chrono::seconds ticketLifetime{600}; // how long a resumption ticket lets a client log in again without its password (0: no tickets)
+    std::chrono::milliseconds presenceInterval{100}; // presence changes are gathered this long and sent to each watcher as one message
+    std::string usersFile = "assets/users.txt"; // the user database, loaded once at startup (new users are appended to it)
+    bool watchUsersFile = true; // pick up users appended to the users file while the server runs
+    std::string usersDatabase = "assets/users.db"; // binary user database made by tools/convert_users, mapped if it exists
+    std::string offlineDirectory = "assets/offline"; // where messages for logged out users are kept
+    size_t offlineSegmentSize = 64 * 1024 * 1024; // size of one offline message log file (and of the largest message it can hold)
+    std::chrono::milliseconds offlineSyncInterval{50}; // offline messages are written to the disk in batches this far apart
+    size_t offlineMailboxLimit = 1000; // messages a logged out user may have waiting
+    size_t offlineStoreLimit = 1024 * 1024 * 1024; // disk space the offline messages may take, the oldest are deleted undelivered to stay under it (0: no limit)
+    double messageRate = 200; // messages per second a logged in client may send (0: no limit)
+    double messageBurst = 400; // messages a client may send at once after being quiet
+    double byteRate = 2 * 1024 * 1024; // bytes per second a logged in client may send (0: no limit)
+    double byteBurst = 4 * 1024 * 1024; // bytes a client may send at once after being quiet
+    RatePolicy ratePolicy = RatePolicy::Delay; // what happens to a client over its limits
+    size_t maxMessageSize = 1024 * 1024; // largest message a client may send, larger ones disconnect the client
+    size_t outputHighWatermark = 4 * 1024 * 1024; // queued bytes for a client at which its partner's reads are paused
+    size_t outputLowWatermark = 1024 * 1024; // queued bytes at which the partner's reads resume
+    bool binaryFraming = true; // accept clients that ask for length-prefixed binary frames
+    bool strictJson = false; // validate every relayed message as JSON (otherwise only the framing is checked)
+};
+
+#endif // SERVER_CONFIG_H
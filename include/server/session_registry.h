@@ -0,0 +1,56 @@
+#ifndef SESSION_REGISTRY_H
+#define SESSION_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct Connection;
+
+/**
+ * @brief The live connections of a reactor
+ *
+ * This class replaces the list that used to grow by one thread per chat until shutdown. Connections sit in a slab of slots: insert and remove are O(1), a closed connection's slot is reused by the next one right away, so memory stays flat however many clients come and go.
+ *
+ * A connection is named by a handle made of its slot and the slot's generation. The generation changes every time the slot is freed, so a handle kept by a timer, a worker job or the lobby simply stops resolving once its connection is gone.
+ *
+ * Only the owning reactor's thread may use the registry, except size() which any thread may read.
+*/
+class SessionRegistry {
+public:
+    using Handle = uint64_t; // generation in the high 32 bits, slot in the low 32 bits
+
+    SessionRegistry(); // constructor
+    ~SessionRegistry(); // destructor (frees the remaining connections)
+
+    // Non-copyable (owns the connections)
+    SessionRegistry(const SessionRegistry&) = delete;
+    SessionRegistry& operator=(const SessionRegistry&) = delete;
+
+    Handle insert(std::unique_ptr<Connection> connection); // add a connection and set its handle
+    std::unique_ptr<Connection> release(Handle handle); // remove a connection without freeing it (nullptr if the handle is stale)
+    bool erase(Handle handle); // remove and free a connection, returns false if the handle is stale
+    Connection* get(Handle handle) const; // look up a connection, nullptr if the handle is stale
+    void forEach(const std::function<void(Connection&)>& visit) const; // visit every live connection
+    void clear(); // free every connection
+    size_t size() const; // number of live connections (thread safe)
+    size_t capacity() const; // number of slots allocated
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX; // end of the free list
+
+    struct Slot {
+        uint32_t generation = 0; // bumped every time the slot is freed
+        uint32_t nextFree = NO_SLOT; // next free slot while this one is free
+        std::unique_ptr<Connection> connection; // nullptr while free
+    };
+
+    std::vector<Slot> slots; // slab of slots, never shrinks
+    uint32_t freeHead; // first free slot (NO_SLOT if none)
+    std::atomic<size_t> count; // number of live connections
+};
+
+#endif // SESSION_REGISTRY_H
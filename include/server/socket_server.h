@@ -4,49 +4,167 @@
 #include <iostream>
 #include <thread>
 #include <vector>
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <mutex>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
 #include <nlohmann/json.hpp>
 #include <common/aes_ecb.h>
-#include <common/thread_list.h>
 #include <common/rsa_wrapper.h>
+#include <common/framing.h>
+#include <common/session_ticket.h>
+#include <server/event_loop.h>
+#include <server/connection.h>
+#include <server/reactor.h>
+#include <server/worker_pool.h>
+#include <server/verify_batcher.h>
+#include <server/file_watcher.h>
+#include <server/lobby.h>
+#include <server/room.h>
+#include <server/presence_index.h>
+#include <server/offline_store.h>
+#include <server/server_config.h>
+#include <server/userhandler.h>
+#include <server/timer_wheel.h>
 #include <cryptopp/base64.h>
 #include <sstream>
+#include <memory>
+#include <functional>
+#include <unordered_map>
 
 /**
  * @brief A class to manage the server side of the chat application
  * 
  * This class is used to manage the server side of the chat application. It provides methods to start the server, handle client connections, and manage client pairs for communication.
  * 
+ * Client sockets are spread over one or more reactors, each an epoll event loop on its own thread with its own listening socket (SO_REUSEPORT). A chat between two clients is a pair of Connection objects on the same reactor rather than a thread: when two clients on different reactors are paired, one of them is handed over to the other's reactor.
+ * 
+ * Logged in clients wait for a partner in a lock-free lobby shared by the reactors. A client whose partner leaves goes back to the lobby instead of being disconnected. Clients using binary framing can also join named rooms with any number of members: each name is hosted by one reactor, and a message is fanned out to every member from a single shared buffer. They can also find a user by name to chat with, watch users to be told in batches when they log in or out, and send a user a message that is kept on disk until the user logs in.
+ * 
+ * A client that logged in gets a short-lived resumption ticket, with which it can reconnect by answering a nonce with one HMAC instead of repeating the RSA login.
+ * 
+ * shutdown() drains the server for a restart: the reactors stop accepting, clients are told the server is going away and are closed as soon as their output is written (or when the drain timeout expires). Every reactor is woken through its eventfd, so neither shutdown() nor stop() waits for traffic.
+ * 
  * The class uses the Crypto++ library for encryption and decryption, and the nlohmann json library for handling JSON messages.
 */
 class Server {
 public:
-    Server(int port); // constructor
+    Server(int port, const ServerConfig& config = ServerConfig()); // constructor
     ~Server(); // destructor
-    void run(); // start the server
+    void run(); // start the server (returns once every reactor stopped)
+    void shutdown(); // drain: stop accepting, tell clients the server is going away and close them once their output is flushed (thread safe)
+    void stop(); // stop at once, closing every client (thread safe)
+
+    size_t outputQueueDepth() const; // bytes waiting in the output queues of all clients
+    size_t connectionCount() const; // number of connected clients
+    size_t onlineUsers() const; // number of logged in users
+    const Lobby& lobbyStats() const; // matchmaking queue depth and wait times
+    UserHandler::FilterStats unknownUserStats() const; // user lookups cut short by the Bloom filter
 
     static std::string getFormattedCurrentTime(); // get the current time in a formatted string
     
 private:
-    int serverSocket; // server socket
+    /**
+     * @brief A reference to a connection that may live on another reactor
+     *
+     * Only the owning reactor may resolve it, through its session registry. It stops resolving once the connection is closed.
+    */
+    struct ConnectionRef {
+        Reactor* reactor; // reactor that owns the connection
+        SessionRegistry::Handle handle; // the connection's handle in the reactor's registry
+    };
+
+    /**
+     * @brief How a client logged in
+    */
+    enum class Login {
+        Create, // registered a new user
+        Verify, // checked an existing user's password
+        Resume // presented a resumption ticket
+    };
+
+    static constexpr size_t MAX_ROOM_NAME = 64; // longest room name a client may join
+    static constexpr unsigned int MIN_CLIENT_KEY_BITS = 2048; // smallest RSA modulus accepted from a client (its resumption ticket's secret is encrypted with it)
+
     RSAWrapper rsa; // RSA wrapper
+    std::string publicKeyMessage; // the server's public key, sent to every new client (with its own nonce)
+    SessionTicket tickets; // issues and checks resumption tickets
 public:
     std::atomic<bool> isRunning; // flag to indicate if the server is running (atomic for thread safety)
 private:
-    ThreadList clientThreads;  // stores threads for client pairs
-
-    void handlePair(int clientSocket1, int clientSocket2); // handle client pair
-    bool waitForClients(int& clientSocket); // wait for clients to connect
-    void notifyClient(int clientSocket, const std::string &message); // notify clients (send json)
-    void processClientMessage(int sourceSock, int targetSock, fd_set &readfds); // process client message (make sure message is json)
-    bool createUser(std::string& user); // create a user
-    bool verifyUser(std::string& user); // verify a user
-    bool verifyClient(int clientSocket); // verify a client
+    std::atomic<bool> draining; // shutdown() was called
+    ServerConfig config; // limits and timeouts
+    std::vector<std::unique_ptr<Reactor>> reactors; // one event loop per thread, each with its own listening socket
+    Lobby lobby; // verified clients waiting for a partner
+    PresenceIndex presence; // logged in users by name, and who watches them
+    OfflineStore offline; // messages kept for users that are not logged in
+    UserHandler users; // the user database, indexed in memory (thread safe)
+    VerifyBatcher verifier; // checks the passwords of concurrent logins together (outlives the workers)
+    FileWatcher usersWatcher; // refreshes the users from the users file when it is appended to (destroyed before them)
+    WorkerPool workers; // threads that decrypt and check credentials off the reactors (destroyed before the reactors)
+
+    void refreshUsers(); // add the users appended to the users file (runs on the watcher's thread)
+    static int openListener(int port); // create a non-blocking listening socket that shares the port with the other reactors
+    void runReactor(Reactor& reactor); // serve one reactor until the server stops
+    void acceptClient(Reactor& reactor); // accept new clients and start their handshake (called when the reactor's listening socket is readable)
+    bool watchClient(Connection& client); // register a client with its reactor's event loop, returns false if it was closed
+    void drainReactor(Reactor& reactor); // stop accepting and start closing a reactor's clients (runs on the reactor)
+    void drainClient(Connection& client); // tell a client the server is going away, close it once its output is flushed
+    void finishDrain(Reactor& reactor); // stop a draining reactor once it has no clients left
+    void sendPublicKey(Connection& client); // send the server's public key and the client's nonce
+    void enterLobby(Connection& client); // queue a verified client for a partner and make the pairs that are ready
+    void pairClients(ConnectionRef waiting, ConnectionRef joining); // start a chat between two clients taken from the lobby
+    void requeueClient(ConnectionRef ref); // put a matched client back in the lobby after its partner left
+    void migrateClient(Connection& client, Reactor& target, std::function<void(Connection&)> resume); // hand a client over to another reactor and continue with it there
+    void adoptClient(Reactor& reactor, Connection* client, ConnectionRef from, const std::function<void(Connection&)>& resume); // take over a migrated client on its new reactor
+    void pairWith(Connection& client, ConnectionRef partner); // start a chat with a waiting client on the same reactor, or go back to the lobby if it left
+    void startSession(Connection& first, Connection& second); // pair two clients and start their chat
+    void handleControl(Connection& client, const char* data, size_t size); // run a command a client sent to the server (join or leave a room)
+    void enterRoom(Connection& client, const std::string& name); // move a client to the reactor hosting a named room and add it there
+    void joinRoom(Connection& client, const std::string& name); // add a client to a named room hosted by its reactor
+    std::shared_ptr<Room> leaveRoom(Connection& client); // take a client out of its room, returns the room
+    void roomDeparture(Room& room); // tell the members left in a room that someone left (a lone pair member goes back to the lobby)
+    void resumeRoom(Room& room); // resume reading from the members paused while the room was congested
+    void broadcast(Connection& source, const char* data, size_t size); // send a message to every other member of the source's room
+    void openChat(Connection& client, const std::string& user); // start a chat with a user by name, if that user is waiting for a partner
+    void inviteClient(ConnectionRef target, ConnectionRef requester); // take an invited client out of the lobby for a direct chat (runs on its reactor)
+    void startDirectChat(ConnectionRef requester, ConnectionRef target); // bring the requester to the invited client and pair them (runs on the requester's reactor)
+    void messageUser(Connection& client, const std::string& user, const nlohmann::json& message); // send a message to a user, kept until it logs in if it is offline
+    void storeMessage(ConnectionRef sender, const std::string& user, const std::string& message); // keep a message for a logged out user (checked and written on a worker)
+    void deliverStored(Connection& client); // send a client the messages kept for it
+    void notifyRemote(ConnectionRef ref, const std::string& message); // notify a client owned by any reactor
+    void watchUsers(Connection& client, const nlohmann::json& users); // tell a client about the presence of users, now and whenever it changes
+    void publishPresence(const std::string& user, const std::vector<PresenceIndex::Session>& watchers, bool online); // hand a presence change to the reactors of its watchers
+    void queuePresence(Connection& client, const std::string& user, bool online); // add a presence change to a client's next batch
+    void flushPresence(Reactor& reactor); // send every client of a reactor its batch of presence changes
+    void handleClientEvents(Connection& client, uint32_t events); // dispatch readiness events of a client socket
+    void handleDeadline(Connection& client); // a handshake or idle deadline expired
+    bool handleWritable(Connection& client); // flush a stalled client's output queue, returns false if the client was closed
+    void updateEvents(Connection& client); // watch a client for the events its read and write state needs
+    void disconnectClient(Connection& client); // close a client and end its chat, telling the partner
+    void closeConnection(Connection& connection); // stop watching a client, close its socket and forget it
+    void notifyClient(Connection& client, const std::string &message); // notify clients (send json)
+    void sendFrame(Connection& client, const char* data, size_t size); // send one message with its delimiter, queueing what the socket does not take
+    void sendFrame(Connection& client, SharedFrame& message); // same, sharing the queued copy with the message's other recipients
+    void processClientMessage(Connection& source); // read from a client and handle every complete message
+    bool processBuffered(Connection& client); // handle the complete messages held in a client's input buffer, returns false if the client was closed
+    void delayClient(Connection& client); // stop reading from a client until it is back under its rate limits
+    void resumeClient(Connection& client); // read from a delayed client again
+    bool processFrames(Connection& source, const char* data, size_t size, size_t& consumed); // handle the complete messages in a block of data
+    bool handleClientFrame(Connection& source, Framing::FrameType type, const char* data, size_t size); // handshake, relay or run one message
+    bool createUser(const std::string& user, std::string& username); // create a user (runs on a worker)
+    bool readCredentials(const std::string& user, std::string& username, std::string& password, std::string& saltedHash); // decrypt a user's credentials and find its salted hash (runs on a worker)
+    bool verifyClient(Connection& client, const std::string& message); // advance a client's handshake by one message
+    bool authenticate(Connection& client, bool create, const std::string& message); // hand a client's credentials to the worker pool
+    void reportAuthentication(ConnectionRef ref, Login login, bool success, const std::string& username, const CryptoPP::RSA::PublicKey& publicKey); // issue a ticket and post a verdict to the client's reactor (runs on a worker)
+    bool resumeSession(Connection& client, const nlohmann::json& request); // log a client in with a resumption ticket, or fall back to a full login
+    void finishAuthentication(ConnectionRef ref, Login login, bool success, const std::string& username, const std::string& ticket); // act on a worker's verdict (runs on the client's reactor)
 };
 
 #endif // SOCKET_SERVER_H
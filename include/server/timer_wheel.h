@@ -0,0 +1,79 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+/**
+ * @brief A hierarchical timer wheel
+ *
+ * This class keeps thousands of timeouts with O(1) schedule and cancel. Time is split into ticks, the wheel has 4 levels of 64 slots and every level covers 64 times the range of the one below it. Timers far in the future sit in a higher level and move down ("cascade") as time passes.
+ *
+ * Timers are intrusive: the Timer object lives inside its owner (e.g. a Connection) and is linked into a slot, so scheduling never allocates. Destroying a timer cancels it.
+ *
+ * The wheel is not thread safe, it must only be used from the thread that calls advance().
+*/
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief A timer that can be scheduled on a TimerWheel
+     *
+     * The callback runs once when the timer expires. It may reschedule the timer or destroy its owner.
+    */
+    class Timer {
+    public:
+        Timer(); // constructor
+        ~Timer(); // destructor (cancels the timer)
+
+        // Non-copyable and non-movable (linked into the wheel by address)
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        void cancel(); // stop the timer if it is scheduled
+        bool isScheduled() const; // check if the timer is waiting to expire
+
+        std::function<void()> callback; // called when the timer expires
+
+    private:
+        friend class TimerWheel;
+        void unlink(); // remove the timer from the list it is in
+        TimerWheel* wheel; // wheel the timer is scheduled on (nullptr if not scheduled)
+        Timer* prev; // previous timer in the slot (or the slot head)
+        Timer* next; // next timer in the slot (or the slot head)
+        uint64_t expiry; // tick at which the timer expires
+    };
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10), Clock::time_point start = Clock::now()); // constructor
+    ~TimerWheel(); // destructor (cancels every scheduled timer)
+
+    // Non-copyable and non-movable (timers point into the slots)
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    void schedule(Timer& timer, std::chrono::milliseconds delay); // (re)schedule a timer to expire after a delay
+    void advance(Clock::time_point now); // run every timer that expired up to now
+    int nextTimeoutMs(Clock::time_point now) const; // time until the wheel needs to advance again (-1 if no timers)
+    size_t size() const; // number of scheduled timers
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr uint64_t SLOTS = 1 << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+
+    void insert(Timer& timer); // link a timer into the slot matching its expiry
+    void cascade(int level); // move the timers of the current slot of a level down to lower levels
+    void expire(Timer& head); // run every timer linked to a slot head
+
+    std::chrono::milliseconds tick; // length of a tick
+    Clock::time_point start; // time of tick 0
+    uint64_t currentTick; // last tick that was processed
+    size_t count; // number of scheduled timers
+    std::array<std::array<Timer, SLOTS>, LEVELS> slots; // slot heads (circular lists)
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,31 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <chrono>
+
+/**
+ * @brief A token bucket rate limiter
+ *
+ * Tokens flow in at a fixed rate up to the burst size, and each unit of work takes its cost out. The bucket may go into debt: a cost larger than the burst (e.g. one big message against a byte limit) is let through once the bucket is not in debt, and the debt is paid back before anything else passes. The average rate is kept either way.
+ *
+ * The bucket does not read the clock itself, the caller passes the time in so one clock reading can serve a whole batch of work. It is not thread safe, each connection owns its buckets and only its reactor touches them.
+*/
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(double rate = 0, double burst = 0); // constructor (a rate of 0 never limits)
+
+    bool ready(Clock::time_point now); // refill, then check that the bucket is not in debt
+    void consume(double cost); // take the cost of some work out
+    Clock::duration delay() const; // time until the bucket is out of debt (after ready() returned false)
+    bool limited() const; // check if the bucket limits anything
+
+private:
+    double rate; // tokens per second
+    double burst; // most tokens the bucket holds
+    double tokens; // tokens available, negative while in debt
+    Clock::time_point last; // time of the last refill
+};
+
+#endif // TOKEN_BUCKET_H
@@ -0,0 +1,65 @@
+#ifndef USER_DATABASE_H
+#define USER_DATABASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A read-only binary user database, mapped in memory
+ *
+ * The compact form of the users file, made offline by tools/convert_users. Salts and hashes are stored as raw bytes in fixed width records instead of hex text, and the records are indexed by an open addressing hash table stored in the file itself. Opening the database only maps the file: nothing is parsed or copied, so startup takes the same time with ten users or tens of millions, and the pages a lookup needs are read on demand.
+ *
+ * Layout: a header, the records (salt, hash, hashing function and where the username is), the table (per bucket: the top bits of the username's hash and the record number, linear probing, at most half full) and the usernames.
+ *
+ * Salted hashes go in and come out in the users file's text form, so PasswordHasher is unaware of the format. Only salted hashes in the form PasswordHasher makes them (16 byte salt, 32 byte hash, any of its functions) can be stored.
+ *
+ * Immutable once opened, so all methods are thread safe.
+*/
+class UserDatabase {
+public:
+    using Entry = std::pair<std::string, std::string>; // username and salted hash (text form)
+
+    /**
+     * @brief What a line of the users file holds
+    */
+    enum class Line {
+        User, // a username and its salted hash
+        Blank, // nothing but whitespace
+        Malformed // anything else
+    };
+
+    explicit UserDatabase(const std::string& path); // constructor (maps the file, throws if it is not a valid database)
+    ~UserDatabase(); // destructor (unmaps the file)
+
+    // Non-copyable and non-movable (owns the mapping)
+    UserDatabase(const UserDatabase&) = delete;
+    UserDatabase& operator=(const UserDatabase&) = delete;
+
+    std::optional<std::string> find(const std::string& username) const; // salted hash of a user, std::nullopt if the user is not in the database
+    size_t size() const; // number of users
+    void forEach(const std::function<void(const std::string&, const std::string&)>& visit) const; // visit every user and its salted hash
+
+    static void write(const std::string& path, const std::vector<Entry>& users); // make a database (replaces the file atomically, the first entry of a username wins, throws on failure)
+    static Line parseLine(const std::string& line, std::string& username, std::string& saltedHash); // read a "username salted-hash" line of the users file (the one parser of that file)
+    static bool validUsername(const std::string& username); // check if a username can be stored in the users file (not empty, no whitespace or control characters)
+
+private:
+    const unsigned char* data = nullptr; // the mapping
+    size_t fileSize = 0; // size of the mapping
+    uint64_t count = 0; // number of records
+    uint64_t buckets = 0; // number of table buckets (a power of two)
+    const unsigned char* records = nullptr; // first record
+    const uint64_t* table = nullptr; // first bucket
+    const char* names = nullptr; // usernames
+    uint64_t namesSize = 0; // size of the usernames
+
+    std::string saltedHashOf(uint64_t record) const; // text form of a record's salted hash
+    bool nameOf(uint64_t record, const char*& name, uint32_t& size) const; // locate a record's username, false if the record is damaged
+};
+
+#endif // USER_DATABASE_H
@@ -3,27 +3,80 @@
 
 #include <string>
 #include <optional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 #include <common/passhash.h>
+#include <server/user_database.h>
+#include <server/bloom_filter.h>
+#include <atomic>
 #include <fstream>
 #include <sstream>
+#include <sys/types.h>
 
 /**
  * @brief A class to manage user data
  * 
  * This class is used to manage user data. It provides methods to add a new user, verify a user's credentials, and find a user's salted hash.
+ * 
+ * The users file is read once, when the object is created, into a hash index: finding a user does no I/O. New users are written through to the file and then added to the index. Users appended to the file by others (an operator adding accounts) are picked up by Refresh(), which reads only what was appended since the last time; the server calls it whenever the file changes. A file that was replaced (e.g. saved by an editor) or rewritten is read again in full, for the users it adds: users are never removed without a restart.
+ * 
+ * Most users can instead be kept in a binary database (see UserDatabase), which is mapped rather than loaded. The users file then only holds the users added since the database was made, and is looked up first.
+ * 
+ * A Bloom filter over every username, built at startup and kept up to date by new users, answers most lookups of unknown users (bots trying random names) without locking a shard or touching the database's pages. Counters tell how many lookups it cut short.
+ * 
+ * All methods are thread safe. The index is split into shards, each behind its own reader-writer lock, so logins only wait for a signup of a user in the same shard, and only while its line is written. Checking that a name is free and taking it is one step under the shard's lock: two signups for the same name never both succeed.
  */
 class UserHandler {
 public:
-    UserHandler(const std::string& filename); // Constructor that specifies the file used for storing user data
+    /**
+     * @brief How well the Bloom filter works
+    */
+    struct FilterStats {
+        uint64_t lookups = 0; // users looked up
+        uint64_t rejected = 0; // lookups the filter answered "no such user"
+    };
+
+    UserHandler(const std::string& filename, const std::string& database = "", const PasswordHasher::Kdf& kdf = PasswordHasher::Kdf(), size_t shards = 64); // Constructor that specifies the file used for storing user data (and loads it), the binary database to map if it exists and how new passwords are hashed
+
+    // Non-copyable and non-movable (shared by the server's threads)
+    UserHandler(const UserHandler&) = delete;
+    UserHandler& operator=(const UserHandler&) = delete;
 
     bool AddUser(const std::string& username, const std::string& password); // Adds a new user with the given username and password
     bool VerifyUser(const std::string& username, const std::string& password); // Verifies if the provided username and password are correct
+    bool HasUser(const std::string& username); // Checks if a user with the given username exists
+    // use std::optional to indicate that the user may not exist instead of returning empty string
+    std::optional<std::string> FindUserSaltedHash(const std::string& username); // Finds a user's salted hash by username (to verify its password later, e.g. in a batch)
+    bool InsertIfAbsent(const std::string& username, const std::string& saltedHash); // Adds a user with an already hashed password unless the name is taken (atomic)
+    FilterStats GetFilterStats() const; // Lookups so far and how many the filter cut short
+    size_t Refresh(); // Adds the users appended to the file since it was last read, returns how many were new
 
 private:
+    struct Shard {
+        std::shared_mutex mutex; // protects users: shared for lookups, exclusive for inserts
+        std::unordered_map<std::string, std::string> users; // salted hash by username
+    };
+
     std::string filename;
+    PasswordHasher::Kdf kdf; // how new users' passwords are hashed
+    std::unique_ptr<Shard[]> shards; // the index, the whole file
+    size_t shardCount; // number of shards
+    std::mutex fileMutex; // serializes appends to the file
+    std::mutex refreshMutex; // serializes refreshes, protects readSize
+    std::streamoff readSize = 0; // bytes of the file already in the index
+    dev_t readDevice = 0; // device of the file readSize refers to
+    ino_t readInode = 0; // inode of the file readSize refers to (another one means the file was replaced)
+    std::unique_ptr<UserDatabase> database; // users converted to the binary format, if any (read only)
+    std::unique_ptr<BloomFilter> filter; // every username (from the file and the database)
+    std::atomic<uint64_t> lookups{0}; // users looked up
+    std::atomic<uint64_t> rejected{0}; // lookups the filter answered
 
-    // use std::optional to indicate that the user may not exist instead of returning empty string
-    std::optional<std::string> FindUserSaltedHash(const std::string& username); // Utility function to find a user's salted hash by username
+    Shard& ShardOf(const std::string& username); // Shard holding a username
+    void Load(); // Read the file into the index
+    std::string ReadAppended(int fd); // Read the file from readSize on (from the start if it was replaced or rewritten)
+    void BuildFilter(); // Add every user to a new Bloom filter
 };
 
 #endif // USERHANDLER_H
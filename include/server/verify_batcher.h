@@ -0,0 +1,50 @@
+#ifndef VERIFY_BATCHER_H
+#define VERIFY_BATCHER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Gathers the password checks of concurrent logins into batches
+ *
+ * Workers hand over a password and the salted hash it must match. The first worker to arrive checks it, and while it does, the passwords handed over by the others wait in a queue: when it is done it takes them all (up to the batch size) and checks them with one PasswordHasher::VerifyPasswords call, until the queue is empty. The other workers are free as soon as they queued their password. A lone login is checked at once, a login storm is checked in batches as large as the storm, without a timer.
+ *
+ * Only passwords stored with SHA-256 are batched, the slow functions gain nothing from it: they are checked by the worker that hands them over, so they still run side by side on all the workers.
+ *
+ * Verdicts are delivered through a callback, on the worker that checked the batch. All methods are thread safe.
+*/
+class VerifyBatcher {
+public:
+    using Done = std::function<void(bool)>; // receives the verdict: true if the password matches
+
+    explicit VerifyBatcher(size_t maxBatch); // constructor (batches hold at most maxBatch passwords)
+
+    // Non-copyable and non-movable (shared by the workers)
+    VerifyBatcher(const VerifyBatcher&) = delete;
+    VerifyBatcher& operator=(const VerifyBatcher&) = delete;
+
+    void verify(std::string password, std::string saltedHash, Done done); // check a password, done is called with the verdict (maybe on another thread, after this returns)
+    uint64_t batches() const; // batches checked so far
+    uint64_t batched() const; // passwords checked in batches so far
+
+private:
+    struct Pending {
+        std::string password;
+        std::string saltedHash;
+        Done done;
+    };
+
+    size_t maxBatch; // passwords checked together at most
+    std::mutex mutex; // protects queue and checking
+    std::vector<Pending> queue; // passwords waiting for the current batch to finish
+    bool checking = false; // a worker is checking batches
+    std::atomic<uint64_t> batchCount{0}; // batches checked
+    std::atomic<uint64_t> passwordCount{0}; // passwords checked in batches
+};
+
+#endif // VERIFY_BATCHER_H
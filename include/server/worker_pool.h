@@ -0,0 +1,45 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of threads for CPU heavy work
+ *
+ * Reactors hand expensive jobs (RSA decryption, password hashing) to the pool so their event loops keep relaying chats. The queue is bounded: when it is full submit() fails and the caller can turn the client away instead of letting a login storm queue up without limit.
+ *
+ * Jobs report back by posting to the reactor that submitted them, the pool itself has no notion of results.
+*/
+class WorkerPool {
+public:
+    using Job = std::function<void()>; // work run on a pool thread
+
+    WorkerPool(size_t threads, size_t capacity); // constructor (starts the threads)
+    ~WorkerPool(); // destructor (drops queued jobs and joins the threads)
+
+    // Non-copyable and non-movable (threads point at it)
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    bool submit(Job job); // queue a job, returns false if the queue is full
+    size_t pending() const; // number of queued jobs not started yet
+    size_t size() const; // number of threads
+
+private:
+    void work(); // thread body: run jobs until stopped
+
+    mutable std::mutex mutex; // protects jobs and stopping
+    std::condition_variable ready; // signalled when a job is queued or the pool stops
+    std::deque<Job> jobs; // queued jobs in submit order
+    size_t capacity; // maximum number of queued jobs
+    bool stopping; // set by the destructor
+    std::vector<std::thread> threads; // pool threads
+};
+
+#endif // WORKER_POOL_H
@@ -16,6 +16,7 @@
 #include <ncurses.h>
 #include <iostream>
 #include <string>
+#include <sstream>
 #include <thread>
 #include <client/socket_client.h>
 #include <common/aes_ecb.h>
@@ -104,7 +105,7 @@ int main() {
          //(lambda function to receive messages from the server and send the window object to other functions)
         std::thread recvThread([&]() {
             std::string buffer; // persistent buffer to store incomplete data
-            char tempBuffer[1024];
+            char tempBuffer[16384]; // large enough to take several messages per recv
 
             // Setting a timeout period for recv (to avoid blocking indefinitely)
             struct timeval tv;
@@ -115,20 +116,20 @@ int main() {
             // Keep receiving messages from the server while the client is active
             while (client.status) {
                 // Receive the message into the buffer
-                ssize_t len = recv(client.sock, tempBuffer, sizeof(buffer), 0); // ssize_t is a signed integer type used to represent the sizes of objects
+                ssize_t len = recv(client.sock, tempBuffer, sizeof(tempBuffer), 0); // ssize_t is a signed integer type used to represent the sizes of objects
                 // If the message is not empty, parse it as json
                 if (len > 0) {
                     buffer.append(tempBuffer, len); // Append new data to the buffer
-                    size_t pos;
+                    std::string msg;
                     // Added this loop to handle multiple messages in the buffer
-                    while ((pos = buffer.find('\n')) != std::string::npos) {
-                        std::string msg = buffer.substr(0, pos);
-                        buffer.erase(0, pos + 1); // Remove the processed message from buffer
+                    while (client.nextMessage(buffer, msg)) {
                         try {
                             auto j = json::parse(msg);
                             client.handleJsonMessage(j.dump(), outputWin);
                         } catch (const json::parse_error& e) {
                             std::cerr << "JSON parsing error: " << e.what() << std::endl;
+                        } catch (const json::exception& e) {
+                            std::cerr << "Invalid message: " << e.what() << std::endl; // e.g. a field of the wrong type, possibly sent by the partner
                         }
                     }
                 } else if (len == 0) { // If the message is empty, the server has closed the connection
@@ -173,6 +174,35 @@ int main() {
                 wprintw(outputWin, "Disconnected from the chat, reconnecting...\n");
                 wrefresh(outputWin);
                 break;
+            } else if (strncmp(str, "!chat ", 6) == 0 || strncmp(str, "!watch ", 7) == 0 || strncmp(str, "!msg ", 5) == 0) { // Commands run by the server
+                std::istringstream words(str);
+                std::string command, user;
+                words >> command;
+                json request;
+                if (command == "!chat") {
+                    words >> user;
+                    request = json{{"type", "chat"}, {"user", user}};
+                } else if (command == "!msg") {
+                    // The rest of the line is the message, kept by the server if the user is offline
+                    std::string text;
+                    words >> user;
+                    std::getline(words >> std::ws, text);
+                    request = json{{"type", "message"}, {"user", user}, {"message", text}};
+                } else {
+                    json users = json::array();
+                    while (words >> user) {
+                        users.push_back(user);
+                    }
+                    request = json{{"type", "watch"}, {"users", users}};
+                }
+                if (!client.sendCommand(request)) {
+                    wprintw(outputWin, "The server does not support commands.\n");
+                }
+                wmove(inputWin, 0, 5); // Move cursor back to after "You: "
+                wclrtoeol(inputWin); // Clear the line after "You: "
+                wrefresh(inputWin);
+                wrefresh(outputWin);
+                continue;
             }
                 
             try {
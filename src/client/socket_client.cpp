@@ -66,6 +66,9 @@ bool Client::connectToServer() {
         std::cerr << "Connect failed." << std::endl;
         return false;
     }
+    // Every connection starts with JSON framing, binary framing is negotiated during the handshake
+    binaryFraming = false;
+    handshaking = true;
     return true;
 }
 
@@ -95,11 +98,73 @@ void Client::disconnect() {
 */
 void Client::sendMessage(const json& message) {
     std::string msg = message.dump();
+    if (binaryFraming) {
+        msg = Framing::encodeBinary(msg);
+    }
     if (send(sock, msg.c_str(), msg.size(), 0) < 0) {
         std::cerr << "Send failed." << std::endl;
     }
 }
 
+/**
+ * @brief Send a command to the server
+ * 
+ * Commands (like opening a chat with a user) are sent in control frames, which the server runs instead of relaying them to the chat. Control frames only exist in binary framing.
+ * 
+ * @param command The JSON command to send
+ * 
+ * @return bool True if the command was sent, false if the server did not accept binary framing
+*/
+bool Client::sendCommand(const json& command) {
+    if (!binaryFraming) {
+        return false;
+    }
+    std::string frame = Framing::encodeBinary(command.dump(), Framing::FrameType::Control);
+    if (send(sock, frame.c_str(), frame.size(), 0) < 0) {
+        std::cerr << "Send failed." << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief Extract the next message from the receive buffer
+ * 
+ * This method removes the next complete message from the buffer, using newline delimiters or binary frame headers depending on the negotiated framing.
+ * 
+ * @param buffer The data received so far (complete messages are removed from it)
+ * @param message Set to the next message
+ * 
+ * @return bool True if a complete message was extracted, false if more data is needed (or the stream was broken and the connection dropped)
+*/
+bool Client::nextMessage(std::string& buffer, std::string& message) {
+    if (binaryFraming) {
+        size_t start;
+        Framing::FrameType type;
+        size_t end = Framing::scanBinary(buffer.data(), buffer.size(), start, type);
+        if (end == Framing::INCOMPLETE) {
+            return false;
+        }
+        if (end == Framing::INVALID) {
+            // An unknown frame type, the stream cannot be resynchronized: drop the connection (the receive loop sees it closed and reconnects)
+            buffer.clear();
+            if (sock != -1) {
+                shutdown(sock, SHUT_RDWR);
+            }
+            return false;
+        }
+        message = buffer.substr(start, end - start);
+        buffer.erase(0, end); // Remove the processed message from buffer
+        return true;
+    }
+    size_t pos = buffer.find('\n');
+    if (pos == std::string::npos) {
+        return false;
+    }
+    message = buffer.substr(0, pos);
+    buffer.erase(0, pos + 1); // Remove the processed message from buffer
+    return true;
+}
+
 // Define color codes as constants
 const std::string RESET = "\033[0m";
 const std::string RED = "\033[31m";
@@ -184,6 +249,14 @@ void Client::handleJsonMessage(const std::string& jsonStr, WINDOW* outputWin) {
     std::string type = j.value("type", "other"); // Default to "other" if no type is specified
     // Get the message content if available
     std::string message = j.value("message", "");
+    // The handshake's messages are only taken before the chat starts, afterwards they could be sent by a partner (the server relays its messages as they are)
+    bool handshakeType = type == "public_key" || type == "prompt" || type == "ticket" || type == "resumed" || type == "resume_failed";
+    if (handshakeType && !handshaking) {
+        return;
+    }
+    if (!handshakeType && type != "success" && type != "error") {
+        handshaking = false; // logged in, whatever comes next may be relayed
+    }
     if (type == "text") {
         message = this->aes.Decrypt(AESECB::fromHex(message));
         std::string user = this->aes.Decrypt(AESECB::fromHex(j["user"]));
@@ -196,6 +269,23 @@ void Client::handleJsonMessage(const std::string& jsonStr, WINDOW* outputWin) {
         printColoredMessage("INFO: " + message, BLUE, outputWin); 
     } else if (type == "success") {
         printColoredMessage("Server: " + message, GREEN, outputWin); 
+    } else if (type == "message") {
+        // A message sent to us by name, possibly while we were offline
+        const json& content = j["message"];
+        std::string text = content.is_string() ? content.get<std::string>() : content.dump();
+        printColoredMessage("[" + j.value("time", "") + "] " + j.value("from", "") + ": " + text, MAGENTA, outputWin);
+    } else if (type == "presence") {
+        // Users we watch that logged in or out
+        for (const auto& user : j.value("online", json::array())) {
+            if (user.is_string()) { // a partner could send anything with this type
+                printColoredMessage(user.get<std::string>() + " is online", GREEN, outputWin);
+            }
+        }
+        for (const auto& user : j.value("offline", json::array())) {
+            if (user.is_string()) {
+                printColoredMessage(user.get<std::string>() + " is offline", YELLOW, outputWin);
+            }
+        }
     } else if (type == "key_exchange") {
         printColoredMessage("dh_key_init: " + jsonStr, CYAN, outputWin); 
         this->keyExchangeResponse(jsonStr); // Respond to the key exchange
@@ -212,12 +302,43 @@ void Client::handleJsonMessage(const std::string& jsonStr, WINDOW* outputWin) {
         if (RSAWrapper::receivePublicKey(pub, publicKey)) {
             this->rsa.publicKeyB = publicKey;
         }
+        // Skip the login if we hold a ticket: answer the server's nonce with the ticket's secret
+        if (!sessionTicket.empty() && j.contains("nonce")) {
+            std::string proof = SessionTicket::proof(ticketSecret, j["nonce"].get<std::string>());
+            sendMessage(json{{"type", "resume"}, {"ticket", sessionTicket}, {"proof", proof}, {"framing", "binary"}});
+            return;
+        }
         std::string response = RSAWrapper::sendPublicKey(this->rsa.getPublicKey());
         printColoredMessage("server_public_key: " + pub, CYAN, outputWin);
         printColoredMessage("client_public_key: " + response, CYAN, outputWin); 
-        // Send client public key back to the server
-        sendMessage(json::parse(response));
+        // Send client public key back to the server, asking for binary framing
+        json reply = json::parse(response);
+        reply["framing"] = "binary";
+        sendMessage(reply);
+    } else if (type == "ticket") {
+        // Keep the resumption ticket for the next reconnect
+        try {
+            ticketSecret = rsa.decrypt(j.value("secret", ""));
+            sessionTicket = j.value("ticket", "");
+        } catch (const CryptoPP::Exception& e) {
+            sessionTicket.clear(); // unreadable secret, log in with the password next time
+            ticketSecret.clear();
+        }
+    } else if (type == "resumed") {
+        // The server accepted the ticket, everything after this reply is framed if binary framing was accepted
+        if (j.value("framing", "") == "binary") {
+            binaryFraming = true;
+        }
+    } else if (type == "resume_failed") {
+        // The ticket expired (or the server restarted), the server sends its public key again for a full login
+        sessionTicket.clear();
+        ticketSecret.clear();
+        printColoredMessage(message, YELLOW, outputWin);
     } else if (type == "prompt"){
+        // The server accepted binary framing, everything after the prompt is framed
+        if (j.value("framing", "") == "binary") {
+            binaryFraming = true;
+        }
         std::string enc_username = rsa.encrypt(username, rsa.publicKeyB);
         std::string enc_password = rsa.encrypt(password, rsa.publicKeyB);
         if (authType == 1) {
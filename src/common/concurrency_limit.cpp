@@ -0,0 +1,80 @@
+/**
+ * @file common/concurrency_limit.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the ConcurrencyLimit class
+ *
+ * This file contains the implementation of the ConcurrencyLimit class, a counting semaphore that bounds how many threads do some expensive work at once.
+*/
+
+#include <common/concurrency_limit.h>
+
+/**
+ * @brief Construct a new ConcurrencyLimit object
+ *
+ * @param limit The number of slots (0: no limit)
+ *
+ * @return ConcurrencyLimit object
+*/
+ConcurrencyLimit::ConcurrencyLimit(size_t limit) : limit(limit) {}
+
+/**
+ * @brief Change the number of slots
+ *
+ * @param limit The new number of slots (0: no limit)
+ *
+ * @return void
+*/
+void ConcurrencyLimit::setLimit(size_t limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->limit = limit;
+    }
+    freed.notify_all(); // a larger limit lets waiting callers in
+}
+
+/**
+ * @brief Take a slot, waiting until one is free
+ *
+ * @return void
+*/
+void ConcurrencyLimit::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    queued++;
+    freed.wait(lock, [this]() { return limit == 0 || taken < limit; });
+    queued--;
+    taken++;
+}
+
+/**
+ * @brief Give a slot back
+ *
+ * @return void
+*/
+void ConcurrencyLimit::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        taken--;
+    }
+    freed.notify_one();
+}
+
+/**
+ * @brief Get the number of slots taken
+ *
+ * @return size_t The callers holding a slot
+*/
+size_t ConcurrencyLimit::active() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return taken;
+}
+
+/**
+ * @brief Get the number of callers waiting
+ *
+ * @return size_t The callers waiting for a slot
+*/
+size_t ConcurrencyLimit::waiting() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queued;
+}
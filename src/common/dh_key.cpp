@@ -9,7 +9,6 @@
 
 #include "common/dh_key.h"
 
-CryptoPP::AutoSeededRandomPool DHKeyExchange::rnd;
 CryptoPP::DH DHKeyExchange::dhA;
 CryptoPP::SecByteBlock DHKeyExchange::privKeyA, DHKeyExchange::pubKeyA, DHKeyExchange::pubKeyB;
 
@@ -37,7 +36,7 @@ void DHKeyExchange::createDomainParameters() {
 /**
  * @brief Create the public and private keys for the DH key exchange
  * 
- * Create the public and private keys for the DH key exchange using the CryptoPP::DH object.
+ * Create the public and private keys for the DH key exchange using the CryptoPP::DH object and the calling thread's random generator.
  * 
  * @param dh The CryptoPP::DH object to use for key exchange
  * @param privKey The private key to generate
@@ -48,7 +47,7 @@ void DHKeyExchange::createDomainParameters() {
 void DHKeyExchange::createAsymmetricKey(const CryptoPP::DH &dh, CryptoPP::SecByteBlock &privKey, CryptoPP::SecByteBlock &pubKey) {
     privKey = CryptoPP::SecByteBlock(dh.PrivateKeyLength());
     pubKey = CryptoPP::SecByteBlock(dh.PublicKeyLength());
-    dh.GenerateKeyPair(rnd, privKey, pubKey);
+    dh.GenerateKeyPair(ThreadRng::get(), privKey, pubKey);
 
     CryptoPP::Integer a, b;
     a.Decode(privKey.BytePtr(), privKey.SizeInBytes());
@@ -0,0 +1,157 @@
+/**
+ * @file common/framing.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the Framing class
+ *
+ * This file contains the implementation of the Framing class, which is used to find message boundaries in the byte stream between the client and the server.
+*/
+
+#include <common/framing.h>
+
+/**
+ * @brief Find the first JSON value in a buffer
+ *
+ * Skip leading whitespace, then scan a JSON object or array by counting brackets outside of strings. The value is not validated, this is only a framing scan.
+ *
+ * @param data The buffer to scan
+ * @param size The number of bytes in the buffer
+ * @param start Set to the offset where the value starts (after leading whitespace)
+ *
+ * @return size_t The offset just past the value, INCOMPLETE if the value is not complete yet, or INVALID if the data is not a JSON object or array
+*/
+size_t Framing::scanJson(const char* data, size_t size, size_t& start) {
+    JsonScanState state;
+    return scanJson(data, size, start, state);
+}
+
+/**
+ * @brief Resume a scan for the first JSON value in a buffer
+ *
+ * Same as scanJson, but continue from where a previous scan of the same buffer ran out of data. The state is reset when a complete value is found.
+ *
+ * @param data The buffer to scan (starting at the same place as the previous scan)
+ * @param size The number of bytes in the buffer
+ * @param start Set to the offset where the value starts (after leading whitespace)
+ * @param state The progress of the previous scan, updated if the value is still incomplete
+ *
+ * @return size_t The offset just past the value, INCOMPLETE if the value is not complete yet, or INVALID if the data is not a JSON object or array
+*/
+size_t Framing::scanJson(const char* data, size_t size, size_t& start, JsonScanState& state) {
+    size_t i = state.position;
+    if (state.depth == 0) {
+        // Not inside a value yet, skip whitespace between messages
+        while (i < size && (data[i] == ' ' || data[i] == '\n' || data[i] == '\r' || data[i] == '\t')) {
+            i++;
+        }
+        state.start = i;
+        start = i;
+        if (i == size) {
+            return INCOMPLETE; // nothing worth resuming, the caller drops the whitespace
+        }
+        if (data[i] != '{' && data[i] != '[') {
+            return INVALID;
+        }
+    }
+    start = state.start;
+
+    for (; i < size; i++) {
+        char c = data[i];
+        if (state.inString) {
+            if (state.escaped) {
+                state.escaped = false; // the escaped character cannot end the string
+            } else if (c == '\\') {
+                state.escaped = true;
+            } else if (c == '"') {
+                state.inString = false;
+            }
+        } else if (c == '"') {
+            state.inString = true;
+        } else if (c == '{' || c == '[') {
+            state.depth++;
+        } else if (c == '}' || c == ']') {
+            if (--state.depth == 0) {
+                state = JsonScanState();
+                return i + 1;
+            }
+        }
+    }
+    state.position = i;
+    return INCOMPLETE;
+}
+
+/**
+ * @brief Find the first binary frame in a buffer
+ *
+ * Read the frame header and check that the whole payload is in the buffer.
+ *
+ * @param data The buffer to scan
+ * @param size The number of bytes in the buffer
+ * @param start Set to the offset where the payload starts
+ * @param type Set to the type of the frame
+ *
+ * @return size_t The offset just past the frame, INCOMPLETE if the frame is not complete yet, or INVALID if the frame type is unknown
+*/
+size_t Framing::scanBinary(const char* data, size_t size, size_t& start, FrameType& type) {
+    start = HEADER_SIZE;
+    if (size < HEADER_SIZE) {
+        return INCOMPLETE;
+    }
+    size_t length = binaryLength(data);
+    uint8_t frameType = static_cast<uint8_t>(data[4]);
+    if (frameType != static_cast<uint8_t>(FrameType::Json) && frameType != static_cast<uint8_t>(FrameType::Control)) {
+        return INVALID;
+    }
+    type = static_cast<FrameType>(data[4]);
+    if (size - HEADER_SIZE < length) {
+        return INCOMPLETE;
+    }
+    return HEADER_SIZE + length;
+}
+
+/**
+ * @brief Read the payload size from a binary frame header
+ *
+ * Lets the receiver reject an oversized message as soon as its header arrives, before buffering the payload.
+ *
+ * @param header The frame header (at least 4 bytes)
+ *
+ * @return size_t The payload size
+*/
+size_t Framing::binaryLength(const char* header) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(header);
+    return (size_t(bytes[0]) << 24) | (size_t(bytes[1]) << 16) | (size_t(bytes[2]) << 8) | size_t(bytes[3]);
+}
+
+/**
+ * @brief Write a binary frame header
+ *
+ * @param header The buffer to write to (at least HEADER_SIZE bytes)
+ * @param payloadSize The size of the payload that follows the header
+ * @param type The type of the frame
+ *
+ * @return void
+*/
+void Framing::encodeHeader(char* header, size_t payloadSize, FrameType type) {
+    uint32_t length = static_cast<uint32_t>(payloadSize);
+    header[0] = static_cast<char>(length >> 24);
+    header[1] = static_cast<char>(length >> 16);
+    header[2] = static_cast<char>(length >> 8);
+    header[3] = static_cast<char>(length);
+    header[4] = static_cast<char>(type);
+}
+
+/**
+ * @brief Build a binary frame
+ *
+ * @param payload The payload of the frame
+ * @param type The type of the frame
+ *
+ * @return std::string The header followed by the payload
+*/
+std::string Framing::encodeBinary(const std::string& payload, FrameType type) {
+    std::string frame(HEADER_SIZE, '\0');
+    encodeHeader(&frame[0], payload.size(), type);
+    frame += payload;
+    return frame;
+}
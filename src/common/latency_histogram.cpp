@@ -0,0 +1,110 @@
+/**
+ * @file common/latency_histogram.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the LatencyHistogram class
+ *
+ * This file contains the implementation of the LatencyHistogram class, which records how long an operation takes in logarithmic buckets.
+*/
+
+#include <common/latency_histogram.h>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Construct a new LatencyHistogram object
+ *
+ * @return LatencyHistogram object
+*/
+LatencyHistogram::LatencyHistogram() : total(0), sum(0) {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Record a duration
+ *
+ * @param duration The duration to count
+ *
+ * @return void
+*/
+void LatencyHistogram::record(std::chrono::nanoseconds duration) {
+    uint64_t micros = static_cast<uint64_t>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0));
+    size_t index = 0;
+    while (index + 1 < BUCKETS && (micros >> index) != 0) {
+        index++; // index = number of bits in micros
+    }
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(micros, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Get the number of durations recorded
+ *
+ * @return uint64_t The number of durations
+*/
+uint64_t LatencyHistogram::count() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Get the number of durations in a bucket
+ *
+ * @param index The bucket (durations up to upperBound(index))
+ *
+ * @return uint64_t The number of durations, 0 for a bucket that does not exist
+*/
+uint64_t LatencyHistogram::bucket(size_t index) const {
+    return index < BUCKETS ? buckets[index].load(std::memory_order_relaxed) : 0;
+}
+
+/**
+ * @brief Get the average duration
+ *
+ * @return std::chrono::microseconds The mean of the recorded durations (0 if there are none)
+*/
+std::chrono::microseconds LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return std::chrono::microseconds(n == 0 ? 0 : sum.load(std::memory_order_relaxed) / n);
+}
+
+/**
+ * @brief Get a percentile
+ *
+ * @param fraction The share of the recordings, e.g. 0.99 for the 99th percentile
+ *
+ * @return std::chrono::microseconds The upper bound of the bucket holding that percentile (0 if nothing was recorded)
+*/
+std::chrono::microseconds LatencyHistogram::percentile(double fraction) const {
+    uint64_t counts[BUCKETS];
+    uint64_t n = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        n += counts[i];
+    }
+    if (n == 0) {
+        return std::chrono::microseconds(0);
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * n)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return upperBound(i);
+        }
+    }
+    return upperBound(BUCKETS - 1);
+}
+
+/**
+ * @brief Get the longest duration a bucket counts
+ *
+ * @param index The bucket
+ *
+ * @return std::chrono::microseconds 2^index - 1 microseconds
+*/
+std::chrono::microseconds LatencyHistogram::upperBound(size_t index) {
+    return std::chrono::microseconds((1ull << std::min(index, BUCKETS - 1)) - 1);
+}
@@ -4,24 +4,35 @@
  * @author Arwa Essam Abdelaziz
  * @brief This file contains the implementation of the PasswordHasher class
  * 
- * This file contains the implementation of the PasswordHasher class, which is used to generate and verify password hashes using a random salt and SHA-256.
+ * This file contains the implementation of the PasswordHasher class, which is used to generate and verify password hashes using a random salt and SHA-256, PBKDF2 or scrypt.
 */
 
 #include <common/passhash.h>
+#include <common/thread_rng.h>
+#include <chrono>
+#include <stdexcept>
 
 using namespace CryptoPP;
 
+static const char PBKDF2_NAME[] = "pbkdf2-sha256";
+static const char SCRYPT_NAME[] = "scrypt";
+static constexpr size_t SALT_LENGTH = 32; // Length of the salt in hex characters (16 bytes * 2 characters per byte)
+static constexpr uint32_t MAX_COST = (1u << 24) - 1;
+static constexpr word64 SCRYPT_BLOCK_SIZE = 8;
+static constexpr size_t ALGORITHMS = 3;
+
 /**
  * @brief Generate a random salt of the specified length
  * 
+ * The bytes come from the calling thread's generator, no generator is seeded per salt.
+ * 
  * @param length The length of the salt to generate
  * 
  * @return std::string The generated salt
 */
 std::string PasswordHasher::GenerateRandomSalt(size_t length) {
-    AutoSeededRandomPool rng;
     byte salt[length];
-    rng.GenerateBlock(salt, sizeof(salt));
+    ThreadRng::get().GenerateBlock(salt, sizeof(salt));
     return ToHexString(salt, sizeof(salt));
 }
 
@@ -34,27 +45,264 @@ std::string PasswordHasher::GenerateRandomSalt(size_t length) {
  * @return std::string The salted hash of the password
 */
 std::string PasswordHasher::HashPassword(const std::string& password, const std::string& salt) {
-    SHA256 hash;
-    std::string digest;
-    StringSource s(password + salt, true, new HashFilter(hash, new HexEncoder(new StringSink(digest), false)));
-    return salt + digest; // {repend the salt to the hash for storage
+    return HashPassword(password, salt, Kdf());
+}
+
+/**
+ * @brief Hash the password with the given function and salt
+ * 
+ * @param password The password to hash
+ * @param salt The salt to use for hashing
+ * @param kdf The function to hash with and its cost
+ * 
+ * @return std::string The stored form of the hash, naming the function unless it is SHA-256
+*/
+std::string PasswordHasher::HashPassword(const std::string& password, const std::string& salt, const Kdf& kdf) {
+    if (!ValidKdf(kdf)) {
+        throw std::invalid_argument("Invalid password hashing cost");
+    }
+    return FormatRecord(kdf, salt, Derive(password, salt, kdf));
 }
 
 /**
  * @brief Verify the password against the salted hash
  * 
+ * The password is hashed again with the function and cost the salted hash was made with.
+ * 
  * @param password The password to verify
  * @param saltedHash The salted hash to verify against
  * 
  * @return bool True if the password matches the hash, false otherwise
 */
 bool PasswordHasher::VerifyPassword(const std::string& password, const std::string& saltedHash) {
-    size_t saltLength = 32; // Length of the salt in hex characters (16 bytes * 2 characters per byte)
-    std::string salt = saltedHash.substr(0, saltLength);
-    std::string expectedHash = saltedHash.substr(saltLength);
+    Kdf kdf;
+    std::string salt, expectedHash;
+    if (!ParseRecord(saltedHash, kdf, salt, expectedHash)) {
+        return false;
+    }
+    return Derive(password, salt, kdf) == expectedHash;
+}
+
+/**
+ * @brief Verify several passwords against their salted hashes
+ * 
+ * The SHA-256 ones are hashed side by side, taking one slot and recording the average time per password, the others are verified one by one as by VerifyPassword.
+ * 
+ * @param candidates The passwords and the salted hashes to verify them against
+ * 
+ * @return std::vector<bool> For each candidate, true if the password matches its hash
+*/
+std::vector<bool> PasswordHasher::VerifyPasswords(const std::vector<Candidate>& candidates) {
+    std::vector<bool> results(candidates.size(), false);
+    std::vector<size_t> batched; // candidates hashed side by side
+    std::vector<Sha256Lanes::Message> messages;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const Candidate& candidate = candidates[i];
+        if (IsBatchable(candidate.saltedHash)) {
+            batched.push_back(i);
+            messages.push_back({candidate.password, candidate.saltedHash.substr(0, SALT_LENGTH)});
+        } else {
+            results[i] = VerifyPassword(std::string(candidate.password), std::string(candidate.saltedHash));
+        }
+    }
+    if (messages.empty()) {
+        return results;
+    }
+    std::vector<unsigned char> digests(messages.size() * Sha256Lanes::DIGEST_SIZE);
+    {
+        ConcurrencyLimit::Slot slot(Admission());
+        auto start = std::chrono::steady_clock::now();
+        Sha256Lanes::hash(messages.data(), messages.size(), digests.data());
+        auto perPassword = (std::chrono::steady_clock::now() - start) / messages.size();
+        for (size_t i = 0; i < messages.size(); i++) {
+            Histograms()[static_cast<size_t>(Algorithm::Sha256)].record(perPassword);
+        }
+    }
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    for (size_t i = 0; i < batched.size(); i++) {
+        std::string_view expectedHash = candidates[batched[i]].saltedHash.substr(SALT_LENGTH);
+        const unsigned char* digest = &digests[i * Sha256Lanes::DIGEST_SIZE];
+        bool match = expectedHash.size() == 2 * Sha256Lanes::DIGEST_SIZE;
+        for (size_t j = 0; match && j < Sha256Lanes::DIGEST_SIZE; j++) {
+            match = expectedHash[2 * j] == HEX_DIGITS[digest[j] >> 4] && expectedHash[2 * j + 1] == HEX_DIGITS[digest[j] & 0x0f];
+        }
+        results[batched[i]] = match;
+    }
+    return results;
+}
+
+/**
+ * @brief Check if a salted hash is verified in batches
+ * 
+ * @param saltedHash The stored hash
+ * 
+ * @return bool True if it is a (well formed) SHA-256 record, which VerifyPasswords hashes together with others
+*/
+bool PasswordHasher::IsBatchable(std::string_view saltedHash) {
+    return saltedHash.size() >= SALT_LENGTH && saltedHash[0] != '$';
+}
+
+/**
+ * @brief Split a stored hash into its parts
+ * 
+ * @param saltedHash The stored hash
+ * @param kdf Set to the function and cost it was made with
+ * @param salt Set to the salt
+ * @param hash Set to the hash
+ * 
+ * @return bool False if the stored hash is malformed or names an unknown function
+*/
+bool PasswordHasher::ParseRecord(const std::string& saltedHash, Kdf& kdf, std::string& salt, std::string& hash) {
+    if (saltedHash.empty() || saltedHash[0] != '$') {
+        if (saltedHash.size() < SALT_LENGTH) {
+            return false;
+        }
+        kdf = Kdf();
+        salt = saltedHash.substr(0, SALT_LENGTH);
+        hash = saltedHash.substr(SALT_LENGTH);
+        return true;
+    }
+    // $<name>$<cost>$<salt>$<hash>
+    size_t nameEnd = saltedHash.find('$', 1);
+    size_t costEnd = nameEnd == std::string::npos ? nameEnd : saltedHash.find('$', nameEnd + 1);
+    size_t saltEnd = costEnd == std::string::npos ? costEnd : saltedHash.find('$', costEnd + 1);
+    if (saltEnd == std::string::npos || saltEnd == costEnd + 1 || saltEnd + 1 == saltedHash.size() || saltedHash.find('$', saltEnd + 1) != std::string::npos) {
+        return false;
+    }
+    std::string name = saltedHash.substr(1, nameEnd - 1);
+    std::string cost = saltedHash.substr(nameEnd + 1, costEnd - nameEnd - 1);
+    if (cost.empty() || cost.size() > 9 || cost.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    if (name == PBKDF2_NAME) {
+        kdf.algorithm = Algorithm::Pbkdf2Sha256;
+    } else if (name == SCRYPT_NAME) {
+        kdf.algorithm = Algorithm::Scrypt;
+    } else {
+        return false;
+    }
+    kdf.cost = static_cast<uint32_t>(std::stoul(cost));
+    salt = saltedHash.substr(costEnd + 1, saltEnd - costEnd - 1);
+    hash = saltedHash.substr(saltEnd + 1);
+    return ValidKdf(kdf);
+}
+
+/**
+ * @brief Make a stored hash from its parts
+ * 
+ * @param kdf The function and cost the hash was made with
+ * @param salt The salt
+ * @param hash The hash
+ * 
+ * @return std::string The stored hash
+*/
+std::string PasswordHasher::FormatRecord(const Kdf& kdf, const std::string& salt, const std::string& hash) {
+    switch (kdf.algorithm) {
+    case Algorithm::Pbkdf2Sha256:
+        return std::string("$") + PBKDF2_NAME + "$" + std::to_string(kdf.cost) + "$" + salt + "$" + hash;
+    case Algorithm::Scrypt:
+        return std::string("$") + SCRYPT_NAME + "$" + std::to_string(kdf.cost) + "$" + salt + "$" + hash;
+    default:
+        return salt + hash; // {repend the salt to the hash for storage
+    }
+}
 
-    std::string actualHash = HashPassword(password, salt).substr(saltLength); // Hash and strip the salt
-    return actualHash == expectedHash;
+/**
+ * @brief Check a function's cost
+ * 
+ * Costs are kept below 2^24 so that they fit the binary user database.
+ * 
+ * @param kdf The function and cost
+ * 
+ * @return bool True if a password can be hashed with it
+*/
+bool PasswordHasher::ValidKdf(const Kdf& kdf) {
+    switch (kdf.algorithm) {
+    case Algorithm::Sha256:
+        return true;
+    case Algorithm::Pbkdf2Sha256:
+        return kdf.cost >= 1 && kdf.cost <= MAX_COST;
+    case Algorithm::Scrypt:
+        return kdf.cost >= 2 && kdf.cost <= MAX_COST && (kdf.cost & (kdf.cost - 1)) == 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Set the number of hashes computed at once
+ * 
+ * @param limit The number of hashes, callers beyond it wait (0: no limit)
+ * 
+ * @return void
+*/
+void PasswordHasher::SetConcurrencyLimit(size_t limit) {
+    Admission().setLimit(limit);
+}
+
+/**
+ * @brief Get the time taken by the hashes made with a function
+ * 
+ * The time spent waiting for a slot is not included.
+ * 
+ * @param algorithm The function
+ * 
+ * @return const LatencyHistogram& The histogram of hash times since the process started
+*/
+const LatencyHistogram& PasswordHasher::Latency(Algorithm algorithm) {
+    return Histograms()[static_cast<size_t>(algorithm)];
+}
+
+/**
+ * @brief Hash a password
+ * 
+ * @param password The password to hash
+ * @param salt The salt to use for hashing
+ * @param kdf The function to hash with (valid)
+ * 
+ * @return std::string The hash in lowercase hex
+*/
+std::string PasswordHasher::Derive(const std::string& password, const std::string& salt, const Kdf& kdf) {
+    ConcurrencyLimit::Slot slot(Admission());
+    auto start = std::chrono::steady_clock::now();
+    std::string digest;
+    if (kdf.algorithm == Algorithm::Sha256) {
+        SHA256 hash;
+        StringSource s(password + salt, true, new HashFilter(hash, new HexEncoder(new StringSink(digest), false)));
+    } else {
+        byte derived[SHA256::DIGESTSIZE];
+        const byte* secret = reinterpret_cast<const byte*>(password.data());
+        const byte* saltBytes = reinterpret_cast<const byte*>(salt.data());
+        if (kdf.algorithm == Algorithm::Pbkdf2Sha256) {
+            PKCS5_PBKDF2_HMAC<SHA256> pbkdf2;
+            pbkdf2.DeriveKey(derived, sizeof(derived), 0, secret, password.size(), saltBytes, salt.size(), kdf.cost);
+        } else {
+            Scrypt scrypt;
+            scrypt.DeriveKey(derived, sizeof(derived), secret, password.size(), saltBytes, salt.size(), kdf.cost, SCRYPT_BLOCK_SIZE, 1);
+        }
+        StringSource s(derived, sizeof(derived), true, new HexEncoder(new StringSink(digest), false));
+    }
+    Histograms()[static_cast<size_t>(kdf.algorithm)].record(std::chrono::steady_clock::now() - start);
+    return digest;
+}
+
+/**
+ * @brief Get the slots for hashes
+ * 
+ * @return ConcurrencyLimit& The admission limit shared by every hash in the process
+*/
+ConcurrencyLimit& PasswordHasher::Admission() {
+    static ConcurrencyLimit admission;
+    return admission;
+}
+
+/**
+ * @brief Get the hash time histograms
+ * 
+ * @return LatencyHistogram* One histogram per function, indexed by Algorithm
+*/
+LatencyHistogram* PasswordHasher::Histograms() {
+    static LatencyHistogram histograms[ALGORITHMS];
+    return histograms;
 }
 
 /**
@@ -44,7 +44,7 @@ RSAWrapper::~RSAWrapper() {}
 void RSAWrapper::initializeKeys() {
     // Generate RSA keys
     CryptoPP::InvertibleRSAFunction params;
-    params.GenerateRandomWithKeySize(rng, 2048);
+    params.GenerateRandomWithKeySize(ThreadRng::get(), 2048);
 
     // Set the public and private keys
     privateKey = CryptoPP::RSA::PrivateKey(params);
@@ -54,14 +54,29 @@ void RSAWrapper::initializeKeys() {
 /**
  * @brief Encrypt data using an external public key
  * 
- * Encrypt the provided plaintext using the specified public key.
+ * Encrypt the provided plaintext using the specified public key, padded with the calling thread's random generator.
  * 
  * @param plainText The plaintext to encrypt
  * @param publicKey The public key to use for encryption
  * 
  * @return std::string The encrypted ciphertext
 */
-std::string RSAWrapper::encrypt(const std::string& plainText, const CryptoPP::RSA::PublicKey& publicKey) {
+std::string RSAWrapper::encrypt(const std::string& plainText, const CryptoPP::RSA::PublicKey& publicKey) const {
+    return encrypt(plainText, publicKey, ThreadRng::get());
+}
+
+/**
+ * @brief Encrypt data with a given random number generator
+ * 
+ * Same as encrypt, but the random number generator (used for padding) is supplied by the caller, so several threads can encrypt at the same time as long as each uses its own generator.
+ * 
+ * @param plainText The data to encrypt
+ * @param publicKey The public key to use for encryption
+ * @param rng The random number generator to use
+ * 
+ * @return std::string The encrypted data
+*/
+std::string RSAWrapper::encrypt(const std::string& plainText, const CryptoPP::RSA::PublicKey& publicKey, CryptoPP::RandomNumberGenerator& rng) const {
     std::string cipherText;
     CryptoPP::RSAES_OAEP_SHA_Encryptor e(publicKey);
     CryptoPP::StringSource(plainText, true,
@@ -77,13 +92,27 @@ std::string RSAWrapper::encrypt(const std::string& plainText, const CryptoPP::RS
 /**
  * @brief Decrypt data using the private key
  * 
- * Decrypt the provided ciphertext using the private key.
+ * Decrypt the provided ciphertext using the private key, blinded with the calling thread's random generator.
+ * 
+ * @param cipherText The ciphertext to decrypt
+ * 
+ * @return std::string The decrypted plaintext
+*/
+std::string RSAWrapper::decrypt(const std::string& cipherText) const {
+    return decrypt(cipherText, ThreadRng::get());
+}
+
+/**
+ * @brief Decrypt data with a given random number generator
+ * 
+ * Same as decrypt, but the random number generator (used for blinding) is supplied by the caller. The key is only read, so several threads can decrypt at the same time as long as each uses its own generator.
  * 
  * @param cipherText The ciphertext to decrypt
+ * @param rng The random number generator to use
  * 
  * @return std::string The decrypted plaintext
 */
-std::string RSAWrapper::decrypt(const std::string& cipherText) {
+std::string RSAWrapper::decrypt(const std::string& cipherText, CryptoPP::RandomNumberGenerator& rng) const {
     std::string recoveredText, binaryText;
     // first, decode the Base64 to binary
     CryptoPP::StringSource(cipherText, true,
@@ -0,0 +1,188 @@
+/**
+ * @file common/session_ticket.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the SessionTicket class
+ *
+ * This file contains the implementation of the SessionTicket class, which issues and checks the tickets used to resume a session without a full login.
+*/
+
+#include <common/session_ticket.h>
+#include <common/thread_rng.h>
+
+static constexpr size_t KEY_SIZE = 32; // bytes of server key and of nonce
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// Convert binary data to lowercase hex
+static std::string toHex(const std::string& data) {
+    std::string hex;
+    hex.reserve(data.size() * 2);
+    for (unsigned char c : data) {
+        hex += HEX_DIGITS[c >> 4];
+        hex += HEX_DIGITS[c & 0x0f];
+    }
+    return hex;
+}
+
+// Convert hex back to binary data, false if it is not valid hex
+static bool fromHex(const std::string& hex, std::string& data) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    data.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int value = 0;
+        for (size_t j = i; j < i + 2; j++) {
+            char c = hex[j];
+            int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            if (digit < 0) {
+                return false;
+            }
+            value = value * 16 + digit;
+        }
+        data += static_cast<char>(value);
+    }
+    return true;
+}
+
+/**
+ * @brief Construct a new SessionTicket object with a random key
+ *
+ * @param lifetime How long an issued ticket is valid
+ *
+ * @return SessionTicket object
+*/
+SessionTicket::SessionTicket(std::chrono::seconds lifetime) : ttl(lifetime) {
+    key.resize(KEY_SIZE);
+    ThreadRng::get().GenerateBlock(reinterpret_cast<CryptoPP::byte*>(&key[0]), key.size());
+}
+
+/**
+ * @brief Construct a new SessionTicket object with a given key
+ *
+ * Servers sharing a key accept each other's tickets.
+ *
+ * @param key The key tickets are authenticated with
+ * @param lifetime How long an issued ticket is valid
+ *
+ * @return SessionTicket object
+*/
+SessionTicket::SessionTicket(const std::string& key, std::chrono::seconds lifetime) : key(key), ttl(lifetime) {}
+
+/**
+ * @brief Issue a ticket
+ *
+ * @param username The user that just logged in
+ *
+ * @return Issued The ticket ("<hex username>.<expiry>.<mac>") and its secret
+*/
+SessionTicket::Issued SessionTicket::issue(const std::string& username) const {
+    int64_t expiry = std::chrono::duration_cast<std::chrono::seconds>((Clock::now() + ttl).time_since_epoch()).count();
+    std::string payload = toHex(username) + "." + std::to_string(expiry);
+    return Issued{payload + "." + mac("ticket", payload), mac("secret", payload)};
+}
+
+/**
+ * @brief Check a ticket presented by a reconnecting client
+ *
+ * The ticket must be authentic and unexpired, and the proof must be the HMAC of this connection's nonce under the ticket's secret, so a ticket replayed by someone who does not hold the secret is rejected.
+ *
+ * @param ticket The ticket
+ * @param nonce The nonce sent to the client
+ * @param proof The client's answer to the nonce
+ * @param username Set to the ticket's user if it is accepted
+ *
+ * @return bool True if the client may resume as that user
+*/
+bool SessionTicket::redeem(const std::string& ticket, const std::string& nonce, const std::string& proof, std::string& username) const {
+    size_t last = ticket.rfind('.');
+    if (last == std::string::npos || nonce.empty()) {
+        return false;
+    }
+    std::string payload = ticket.substr(0, last);
+    if (!equal(ticket.substr(last + 1), mac("ticket", payload))) {
+        return false;
+    }
+    // Authentic, so the payload is well formed
+    size_t dot = payload.find('.');
+    int64_t expiry = std::stoll(payload.substr(dot + 1));
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(Clock::now().time_since_epoch()).count();
+    if (now >= expiry || !equal(proof, SessionTicket::proof(mac("secret", payload), nonce))) {
+        return false;
+    }
+    return fromHex(payload.substr(0, dot), username);
+}
+
+/**
+ * @brief Answer a nonce
+ *
+ * @param secret The secret that came with the ticket
+ * @param nonce The nonce sent by the server
+ *
+ * @return std::string The proof to send along with the ticket
+*/
+std::string SessionTicket::proof(const std::string& secret, const std::string& nonce) {
+    return hmac(secret, nonce);
+}
+
+/**
+ * @brief Make a nonce
+ *
+ * @param rng The random generator to use (not shared between threads)
+ *
+ * @return std::string A random hex nonce
+*/
+std::string SessionTicket::makeNonce(CryptoPP::RandomNumberGenerator& rng) {
+    std::string nonce(KEY_SIZE, '\0');
+    rng.GenerateBlock(reinterpret_cast<CryptoPP::byte*>(&nonce[0]), nonce.size());
+    return toHex(nonce);
+}
+
+/**
+ * @brief Authenticate a payload with the server key
+ *
+ * The label keeps the ticket's MAC and its secret apart, although both cover the same payload.
+ *
+ * @param label What the MAC is for
+ * @param payload The data to authenticate
+ *
+ * @return std::string The hex MAC
+*/
+std::string SessionTicket::mac(const std::string& label, const std::string& payload) const {
+    return hmac(key, label + ":" + payload);
+}
+
+/**
+ * @brief Compute an HMAC-SHA256
+ *
+ * @param key The key
+ * @param message The message
+ *
+ * @return std::string The hex digest
+*/
+std::string SessionTicket::hmac(const std::string& key, const std::string& message) {
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(reinterpret_cast<const CryptoPP::byte*>(key.data()), key.size());
+    hmac.Update(reinterpret_cast<const CryptoPP::byte*>(message.data()), message.size());
+    std::string digest(CryptoPP::HMAC<CryptoPP::SHA256>::DIGESTSIZE, '\0');
+    hmac.Final(reinterpret_cast<CryptoPP::byte*>(&digest[0]));
+    return toHex(digest);
+}
+
+/**
+ * @brief Compare two strings in constant time
+ *
+ * @param a The string received
+ * @param b The expected string
+ *
+ * @return bool True if they are equal
+*/
+bool SessionTicket::equal(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
@@ -0,0 +1,239 @@
+/**
+ * @file common/sha256_lanes.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the Sha256Lanes class
+ *
+ * This file contains the implementation of the Sha256Lanes class, which computes the SHA-256 digests of eight messages side by side (FIPS 180-4), one message per vector lane.
+*/
+
+#include <common/sha256_lanes.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// The compression function is also built for AVX2 on x86, and picked at run time if the CPU has it (by hand: ifunc based target_clones breaks sanitizer builds)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LANES_AVX2 1
+#endif
+
+static constexpr size_t LANES = Sha256Lanes::LANES;
+static constexpr size_t BLOCK_SIZE = 64;
+
+static constexpr uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static constexpr uint32_t INITIAL_STATE[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+using Compress = void (*)(uint32_t (&)[8][LANES], const uint32_t (&)[16][LANES], const uint32_t (&)[LANES]);
+
+/**
+ * @brief Run the compression function on one block of every lane
+ *
+ * The loops over the lanes have no dependencies between lanes, the compiler turns each into vector instructions. Lanes whose mask is 0 keep their state. Inlined into each version below, which sets the instructions it may use.
+ *
+ * @param state The eight state words of every lane
+ * @param block The sixteen message words of every lane's block
+ * @param mask All ones for the lanes that have this block, 0 for the others
+ *
+ * @return void
+*/
+static inline __attribute__((always_inline)) void compressLanes(uint32_t (&state)[8][LANES], const uint32_t (&block)[16][LANES], const uint32_t (&mask)[LANES]) {
+    uint32_t w[64][LANES];
+    for (size_t t = 0; t < 16; t++) {
+        for (size_t l = 0; l < LANES; l++) {
+            w[t][l] = block[t][l];
+        }
+    }
+    for (size_t t = 16; t < 64; t++) {
+        for (size_t l = 0; l < LANES; l++) {
+            uint32_t s0 = rotr(w[t - 15][l], 7) ^ rotr(w[t - 15][l], 18) ^ (w[t - 15][l] >> 3);
+            uint32_t s1 = rotr(w[t - 2][l], 17) ^ rotr(w[t - 2][l], 19) ^ (w[t - 2][l] >> 10);
+            w[t][l] = w[t - 16][l] + s0 + w[t - 7][l] + s1;
+        }
+    }
+    uint32_t a[LANES], b[LANES], c[LANES], d[LANES], e[LANES], f[LANES], g[LANES], h[LANES];
+    for (size_t l = 0; l < LANES; l++) {
+        a[l] = state[0][l]; b[l] = state[1][l]; c[l] = state[2][l]; d[l] = state[3][l];
+        e[l] = state[4][l]; f[l] = state[5][l]; g[l] = state[6][l]; h[l] = state[7][l];
+    }
+    for (size_t t = 0; t < 64; t++) {
+        for (size_t l = 0; l < LANES; l++) {
+            uint32_t t1 = h[l] + (rotr(e[l], 6) ^ rotr(e[l], 11) ^ rotr(e[l], 25)) + ((e[l] & f[l]) ^ (~e[l] & g[l])) + ROUND_CONSTANTS[t] + w[t][l];
+            uint32_t t2 = (rotr(a[l], 2) ^ rotr(a[l], 13) ^ rotr(a[l], 22)) + ((a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]));
+            h[l] = g[l]; g[l] = f[l]; f[l] = e[l]; e[l] = d[l] + t1;
+            d[l] = c[l]; c[l] = b[l]; b[l] = a[l]; a[l] = t1 + t2;
+        }
+    }
+    for (size_t l = 0; l < LANES; l++) {
+        state[0][l] += a[l] & mask[l]; state[1][l] += b[l] & mask[l]; state[2][l] += c[l] & mask[l]; state[3][l] += d[l] & mask[l];
+        state[4][l] += e[l] & mask[l]; state[5][l] += f[l] & mask[l]; state[6][l] += g[l] & mask[l]; state[7][l] += h[l] & mask[l];
+    }
+}
+
+// The baseline version (SSE2 on x86-64)
+static void compressGeneric(uint32_t (&state)[8][LANES], const uint32_t (&block)[16][LANES], const uint32_t (&mask)[LANES]) {
+    compressLanes(state, block, mask);
+}
+
+#ifdef LANES_AVX2
+// The AVX2 version, a whole lane loop per instruction
+__attribute__((target("avx2"))) static void compressAvx2(uint32_t (&state)[8][LANES], const uint32_t (&block)[16][LANES], const uint32_t (&mask)[LANES]) {
+    compressLanes(state, block, mask);
+}
+#endif
+
+/**
+ * @brief Pick the version of the compression function for this CPU
+ *
+ * @return Compress The AVX2 version if the CPU has AVX2, the baseline otherwise
+*/
+static Compress pickCompress() {
+#ifdef LANES_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return compressAvx2;
+    }
+#endif
+    return compressGeneric;
+}
+
+/**
+ * @brief Copy the part of a message that falls in a block
+ *
+ * @param block The block, starting at byte start of the padded message
+ * @param start Offset of the block in the padded message
+ * @param part The part of the message
+ * @param offset Offset of the part in the message
+ *
+ * @return void
+*/
+static void copyPart(unsigned char* block, size_t start, std::string_view part, size_t offset) {
+    size_t from = std::max(start, offset);
+    size_t to = std::min(start + BLOCK_SIZE, offset + part.size());
+    if (from < to) {
+        std::memcpy(block + (from - start), part.data() + (from - offset), to - from);
+    }
+}
+
+/**
+ * @brief Make one block of a padded message
+ *
+ * The padding (a 1 bit, zeros, the length in bits) is written in place, the padded message is never built.
+ *
+ * @param message The message
+ * @param blocks Number of blocks in the padded message
+ * @param index Number of the block to make
+ * @param block Set to the block's bytes
+ *
+ * @return void
+*/
+static void loadBlock(const Sha256Lanes::Message& message, size_t blocks, size_t index, unsigned char* block) {
+    size_t length = message.head.size() + message.tail.size();
+    size_t start = index * BLOCK_SIZE;
+    std::memset(block, 0, BLOCK_SIZE);
+    copyPart(block, start, message.head, 0);
+    copyPart(block, start, message.tail, message.head.size());
+    if (length >= start && length < start + BLOCK_SIZE) {
+        block[length - start] = 0x80;
+    }
+    if (index + 1 == blocks) {
+        uint64_t bits = static_cast<uint64_t>(length) * 8;
+        for (int i = 0; i < 8; i++) {
+            block[BLOCK_SIZE - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+        }
+    }
+}
+
+/**
+ * @brief Hash up to eight messages side by side
+ *
+ * @param messages The messages
+ * @param count Number of messages (at most LANES)
+ * @param digests Set to the digests, DIGEST_SIZE bytes per message
+ *
+ * @return void
+*/
+static void hashGroup(const Sha256Lanes::Message* messages, size_t count, unsigned char* digests) {
+    static const Compress compress = pickCompress();
+    uint32_t state[8][LANES];
+    size_t blocks[LANES] = {};
+    size_t mostBlocks = 0;
+    for (size_t l = 0; l < LANES; l++) {
+        for (size_t i = 0; i < 8; i++) {
+            state[i][l] = INITIAL_STATE[i];
+        }
+        if (l < count) {
+            blocks[l] = (messages[l].head.size() + messages[l].tail.size() + 9 + BLOCK_SIZE - 1) / BLOCK_SIZE; // the 0x80 byte and the length take 9 bytes
+            mostBlocks = std::max(mostBlocks, blocks[l]);
+        }
+    }
+    uint32_t words[16][LANES];
+    uint32_t mask[LANES];
+    unsigned char block[BLOCK_SIZE];
+    for (size_t index = 0; index < mostBlocks; index++) {
+        for (size_t l = 0; l < LANES; l++) {
+            mask[l] = index < blocks[l] ? ~0u : 0u;
+            if (mask[l]) {
+                loadBlock(messages[l], blocks[l], index, block);
+            } else {
+                std::memset(block, 0, BLOCK_SIZE); // an idle lane, its result is dropped
+            }
+            for (size_t t = 0; t < 16; t++) {
+                words[t][l] = (uint32_t(block[4 * t]) << 24) | (uint32_t(block[4 * t + 1]) << 16) | (uint32_t(block[4 * t + 2]) << 8) | uint32_t(block[4 * t + 3]);
+            }
+        }
+        compress(state, words, mask);
+    }
+    for (size_t l = 0; l < count; l++) {
+        for (size_t i = 0; i < 8; i++) {
+            unsigned char* out = digests + l * Sha256Lanes::DIGEST_SIZE + 4 * i;
+            out[0] = static_cast<unsigned char>(state[i][l] >> 24);
+            out[1] = static_cast<unsigned char>(state[i][l] >> 16);
+            out[2] = static_cast<unsigned char>(state[i][l] >> 8);
+            out[3] = static_cast<unsigned char>(state[i][l]);
+        }
+    }
+}
+
+/**
+ * @brief Hash messages, eight at a time
+ *
+ * @param messages The messages
+ * @param count Number of messages
+ * @param digests Set to the digests, DIGEST_SIZE bytes per message in the order of the messages
+ *
+ * @return void
+*/
+void Sha256Lanes::hash(const Message* messages, size_t count, unsigned char* digests) {
+    for (size_t first = 0; first < count; first += LANES) {
+        hashGroup(messages + first, std::min(LANES, count - first), digests + first * DIGEST_SIZE);
+    }
+}
+
+/**
+ * @brief Get the version of the compression function picked for this CPU
+ *
+ * @return const char* "avx2" or "generic"
+*/
+const char* Sha256Lanes::implementation() {
+#ifdef LANES_AVX2
+    if (pickCompress() == compressAvx2) {
+        return "avx2";
+    }
+#endif
+    return "generic";
+}
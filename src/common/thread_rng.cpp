@@ -0,0 +1,79 @@
+/**
+ * @file common/thread_rng.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the ThreadRng class
+ *
+ * This file contains the implementation of the ThreadRng class, the per-thread random generator used by the cryptographic helpers.
+*/
+
+#include <common/thread_rng.h>
+
+/**
+ * @brief Construct a new ThreadRng object
+ *
+ * The pool seeds itself from the operating system.
+ *
+ * @return ThreadRng object
+*/
+ThreadRng::ThreadRng() : seeded(std::chrono::steady_clock::now()) {}
+
+/**
+ * @brief Get the calling thread's generator
+ *
+ * @return ThreadRng& The generator, made and seeded the first time the thread calls this
+*/
+ThreadRng& ThreadRng::get() {
+    thread_local ThreadRng rng;
+    return rng;
+}
+
+/**
+ * @brief Generate random bytes
+ *
+ * @param output Where to write the bytes
+ * @param size Number of bytes
+ *
+ * @return void
+*/
+void ThreadRng::GenerateBlock(CryptoPP::byte* output, size_t size) {
+    auto now = std::chrono::steady_clock::now();
+    if (generated >= RESEED_BYTES || now - seeded >= RESEED_INTERVAL) {
+        pool.Reseed();
+        generated = 0;
+        seeded = now;
+        reseedCount++;
+    }
+    pool.GenerateBlock(output, size);
+    generated += size;
+}
+
+/**
+ * @brief Check if entropy can be added
+ *
+ * @return bool True
+*/
+bool ThreadRng::CanIncorporateEntropy() const {
+    return true;
+}
+
+/**
+ * @brief Mix entropy into the generator
+ *
+ * @param input The entropy
+ * @param length Number of bytes
+ *
+ * @return void
+*/
+void ThreadRng::IncorporateEntropy(const CryptoPP::byte* input, size_t length) {
+    pool.IncorporateEntropy(input, length);
+}
+
+/**
+ * @brief Get the number of reseeds
+ *
+ * @return uint64_t Times this generator was reseeded since it was made
+*/
+uint64_t ThreadRng::reseeds() const {
+    return reseedCount;
+}
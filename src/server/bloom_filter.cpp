@@ -0,0 +1,87 @@
+/**
+ * @file server/bloom_filter.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the BloomFilter class
+ *
+ * This file contains the implementation of the BloomFilter class, which tells cheaply that a string is not in a set.
+*/
+
+#include <server/bloom_filter.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// FNV-1a followed by a finalizer, so both halves of the result are well mixed
+uint64_t hashItem(const std::string& item) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : item) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+} // namespace
+
+/**
+ * @brief Construct a new BloomFilter object
+ *
+ * The number of bits is rounded up to a power of two, and each item sets the number of bits that gives the fewest false positives at capacity (bitsPerItem * ln 2).
+ *
+ * @param capacity The number of items the filter is sized for
+ * @param bitsPerItem The bits spent per item at capacity
+ *
+ * @return BloomFilter object
+*/
+BloomFilter::BloomFilter(size_t capacity, size_t bitsPerItem) : bits(64), hashes(std::max<size_t>(1, static_cast<size_t>(std::lround(bitsPerItem * 0.693)))) {
+    while (bits < std::max<size_t>(capacity, 1) * bitsPerItem) {
+        bits *= 2;
+    }
+    words.reset(new std::atomic<uint64_t>[bits / 64]);
+    for (size_t i = 0; i < bits / 64; i++) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Add an item
+ *
+ * The bit positions come from two halves of one hash (double hashing), so the string is hashed once.
+ *
+ * @param item The item to add
+ *
+ * @return void
+*/
+void BloomFilter::add(const std::string& item) {
+    uint64_t hash = hashItem(item);
+    uint64_t step = (hash >> 32) | 1; // odd, so the positions do not repeat
+    for (size_t i = 0; i < hashes; i++) {
+        uint64_t bit = (hash + i * step) & (bits - 1);
+        words[bit / 64].fetch_or(1ull << (bit % 64), std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Check an item
+ *
+ * @param item The item to check
+ *
+ * @return bool False if the item was never added, true if it probably was
+*/
+bool BloomFilter::mayContain(const std::string& item) const {
+    uint64_t hash = hashItem(item);
+    uint64_t step = (hash >> 32) | 1;
+    for (size_t i = 0; i < hashes; i++) {
+        uint64_t bit = (hash + i * step) & (bits - 1);
+        if ((words[bit / 64].load(std::memory_order_acquire) & (1ull << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file server/event_loop.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the EventLoop class
+ *
+ * This file contains the implementation of the EventLoop class, an epoll based reactor that lets a single thread serve every client socket of the server.
+*/
+
+#include <server/event_loop.h>
+#include <stdexcept>
+#include <cerrno>
+#include <unistd.h>
+
+/**
+ * @brief Construct a new EventLoop object
+ *
+ * Create the epoll descriptor used to watch sockets.
+ *
+ * @return EventLoop object
+*/
+EventLoop::EventLoop() : epollFd(epoll_create1(EPOLL_CLOEXEC)), nextGeneration(0), events(64) {
+    if (epollFd == -1) {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+}
+
+/**
+ * @brief Destroy the EventLoop object
+ *
+ * Close the epoll descriptor. Watched sockets are not closed, they belong to the caller.
+ *
+ * @return void
+*/
+EventLoop::~EventLoop() {
+    close(epollFd);
+}
+
+/**
+ * @brief Start watching a socket
+ *
+ * Register a socket with epoll and store the callback to run when it becomes ready.
+ *
+ * @param fd The socket to watch
+ * @param events The epoll events to watch for (EPOLLIN, EPOLLOUT, ...)
+ * @param callback The function to call with the ready events
+ *
+ * @return bool True if the socket was registered, false otherwise
+*/
+bool EventLoop::add(int fd, uint32_t events, Callback callback) {
+    uint32_t generation = nextGeneration++;
+    epoll_event ev{};
+    ev.events = events;
+    // Pack the fd and its generation so events queued for an old socket with the same number are ignored
+    ev.data.u64 = (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        return false;
+    }
+    entries[fd] = Entry{generation, std::move(callback)};
+    return true;
+}
+
+/**
+ * @brief Change the events watched for a socket
+ *
+ * @param fd The socket to modify
+ * @param events The new set of epoll events
+ *
+ * @return bool True if the socket was modified, false otherwise
+*/
+bool EventLoop::modify(int fd, uint32_t events) {
+    auto it = entries.find(fd);
+    if (it == entries.end()) {
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = (static_cast<uint64_t>(it->second.generation) << 32) | static_cast<uint32_t>(fd);
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+/**
+ * @brief Stop watching a socket
+ *
+ * Remove the socket from epoll. Must be called before the socket is closed so a new socket with the same number does not receive its events.
+ *
+ * @param fd The socket to remove
+ *
+ * @return void
+*/
+void EventLoop::remove(int fd) {
+    if (entries.erase(fd) > 0) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+/**
+ * @brief Wait for events and dispatch them
+ *
+ * Wait until at least one socket is ready (or the timeout expires) and call the callback of every ready socket.
+ *
+ * @param timeoutMs The maximum time to wait in milliseconds (-1 waits forever)
+ *
+ * @return int The number of events handled, or -1 on error
+*/
+int EventLoop::poll(int timeoutMs) {
+    int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeoutMs);
+    if (count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < count; i++) {
+        int fd = static_cast<int>(events[i].data.u64 & 0xFFFFFFFF);
+        uint32_t generation = static_cast<uint32_t>(events[i].data.u64 >> 32);
+        auto it = entries.find(fd);
+        // Skip sockets removed (or replaced) by an earlier callback in this batch
+        if (it == entries.end() || it->second.generation != generation) {
+            continue;
+        }
+        // Copy the callback, it may remove its own socket while running
+        Callback callback = it->second.callback;
+        callback(events[i].events);
+    }
+    // Grow the buffer if it was filled so busy servers drain more events per call
+    if (count == static_cast<int>(events.size())) {
+        events.resize(events.size() * 2);
+    }
+    return count;
+}
+
+/**
+ * @brief Get the number of watched sockets
+ *
+ * @return size_t The number of sockets registered with the loop
+*/
+size_t EventLoop::size() const {
+    return entries.size();
+}
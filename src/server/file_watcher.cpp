@@ -0,0 +1,106 @@
+/**
+ * @file server/file_watcher.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the FileWatcher class
+ *
+ * This file contains the implementation of the FileWatcher class, which runs a callback when inotify reports that a file changed.
+*/
+
+#include <server/file_watcher.h>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+ * @brief Construct a new FileWatcher object
+ *
+ * Watch the file's directory for files written, created or moved in, and start the thread.
+ *
+ * @param path The file to watch (nothing is watched if empty)
+ * @param changed Called on the watcher thread after the file changed
+ *
+ * @return FileWatcher object
+*/
+FileWatcher::FileWatcher(const std::string& path, Callback changed) : changed(std::move(changed)) {
+    if (path.empty()) {
+        return;
+    }
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    name = slash == std::string::npos ? path : path.substr(slash + 1);
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd == -1 || stopFd == -1 || inotify_add_watch(inotifyFd, directory.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) == -1) {
+        if (inotifyFd != -1) {
+            close(inotifyFd);
+        }
+        if (stopFd != -1) {
+            close(stopFd);
+        }
+        throw std::runtime_error("Failed to watch " + path);
+    }
+    watcher = std::thread([this]() { watch(); });
+}
+
+/**
+ * @brief Destroy the FileWatcher object
+ *
+ * Wake the thread through the eventfd and wait for it to finish.
+ *
+ * @return void
+*/
+FileWatcher::~FileWatcher() {
+    if (!watcher.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) != sizeof(one)) {
+        // cannot fail: the counter is far from overflowing
+    }
+    watcher.join();
+    close(inotifyFd);
+    close(stopFd);
+}
+
+/**
+ * @brief Wait for changes and report them
+ *
+ * Every event queued so far is read before the callback runs, so a burst of writes costs one callback.
+ *
+ * @return void
+*/
+void FileWatcher::watch() {
+    alignas(inotify_event) char buffer[4096];
+    pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents != 0) {
+            return; // stopping
+        }
+        bool touched = false;
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* next = buffer; next < buffer + length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(next);
+                if (event->len > 0 && name == event->name) {
+                    touched = true;
+                }
+                next += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (touched) {
+            changed();
+        }
+    }
+}
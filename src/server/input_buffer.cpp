@@ -0,0 +1,132 @@
+/**
+ * @file server/input_buffer.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the InputBuffer class
+ *
+ * This file contains the implementation of the InputBuffer class, which is used to reassemble messages that arrive over several reads.
+*/
+
+#include <server/input_buffer.h>
+#include <cstring>
+
+/**
+ * @brief Construct a new InputBuffer object
+ *
+ * Initialize an empty buffer that holds no memory.
+ *
+ * @return InputBuffer object
+*/
+InputBuffer::InputBuffer() : readPos(0), writePos(0) {}
+
+/**
+ * @brief Get the unconsumed data
+ *
+ * @return const char* The start of the unconsumed data
+*/
+const char* InputBuffer::data() const {
+    return storage.data() + readPos;
+}
+
+/**
+ * @brief Get the number of unconsumed bytes
+ *
+ * @return size_t The size of the unconsumed data
+*/
+size_t InputBuffer::size() const {
+    return writePos - readPos;
+}
+
+/**
+ * @brief Check if the buffer is empty
+ *
+ * @return bool True if there is no unconsumed data, false otherwise
+*/
+bool InputBuffer::empty() const {
+    return writePos == readPos;
+}
+
+/**
+ * @brief Get the memory held by the buffer
+ *
+ * @return size_t The number of bytes allocated
+*/
+size_t InputBuffer::capacity() const {
+    return storage.size();
+}
+
+/**
+ * @brief Make room for more data
+ *
+ * Move the unconsumed data to the front of the buffer, then grow it (at least doubling) if there is still not enough room.
+ *
+ * @param length The number of bytes about to be written
+ *
+ * @return char* Where to write the new bytes
+*/
+char* InputBuffer::prepare(size_t length) {
+    if (storage.size() - writePos < length && readPos > 0) {
+        size_t used = size();
+        std::memmove(storage.data(), storage.data() + readPos, used);
+        readPos = 0;
+        writePos = used;
+    }
+    if (storage.size() - writePos < length) {
+        size_t grown = storage.size() * 2;
+        storage.resize(grown > writePos + length ? grown : writePos + length);
+    }
+    return storage.data() + writePos;
+}
+
+/**
+ * @brief Get the room left for writing
+ *
+ * @return size_t The number of bytes that can be written after prepare()
+*/
+size_t InputBuffer::writable() const {
+    return storage.size() - writePos;
+}
+
+/**
+ * @brief Commit written bytes
+ *
+ * @param length The number of bytes written after prepare()
+ *
+ * @return void
+*/
+void InputBuffer::commit(size_t length) {
+    writePos += length;
+}
+
+/**
+ * @brief Append bytes to the buffer
+ *
+ * @param data The bytes to append
+ * @param length The number of bytes to append
+ *
+ * @return void
+*/
+void InputBuffer::append(const char* data, size_t length) {
+    std::memcpy(prepare(length), data, length);
+    commit(length);
+}
+
+/**
+ * @brief Consume bytes from the front of the buffer
+ *
+ * Once the buffer is drained its positions are reset, and large allocations left behind by a big message are freed.
+ *
+ * @param length The number of bytes to drop
+ *
+ * @return void
+*/
+void InputBuffer::consume(size_t length) {
+    readPos += length;
+    if (readPos >= writePos) {
+        readPos = 0;
+        writePos = 0;
+        if (storage.size() > RETAIN_LIMIT) {
+            std::vector<char>().swap(storage);
+        }
+    }
+}
@@ -0,0 +1,251 @@
+/**
+ * @file server/lobby.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the Lobby class
+ *
+ * This file contains the implementation of the Lobby class, the lock-free queue that pairs waiting clients.
+*/
+
+#include <server/lobby.h>
+#include <thread>
+
+/**
+ * @brief Construct a new Lobby object
+ *
+ * @param capacity The maximum number of waiting clients, rounded up to a power of two
+ *
+ * @return Lobby object
+*/
+Lobby::Lobby(size_t capacity) : enqueuePos(0), dequeuePos(0), reserved(0), live(0), matched(0), totalWait(0), maxWait(0) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    cells.reset(new Cell[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Queue a client
+ *
+ * @param reactor The reactor that owns the client
+ * @param handle The client's handle in the reactor's session registry
+ *
+ * @return std::shared_ptr<Ticket> The client's ticket, to cancel if it leaves, or nullptr if the lobby is full
+*/
+std::shared_ptr<Lobby::Ticket> Lobby::enter(Reactor* reactor, uint64_t handle) {
+    if (reserved.fetch_add(1) > mask) {
+        reserved--;
+        return nullptr;
+    }
+    auto ticket = std::make_shared<Ticket>();
+    live++;
+    Entry entry{reactor, handle, ticket, Clock::now()};
+    while (!push(std::move(entry))) {
+        std::this_thread::yield(); // a cell is still being emptied, the reservation guarantees it will be free
+    }
+    return ticket;
+}
+
+/**
+ * @brief Take a client out of the lobby
+ *
+ * The entry stays in the queue and is dropped when match() reaches it. If the client was already claimed for a match, the match finds it gone on its reactor.
+ *
+ * @param ticket The ticket returned by enter()
+ *
+ * @return bool True if the client was still waiting, false if it was already claimed for a match (or had left)
+*/
+bool Lobby::leave(const std::shared_ptr<Ticket>& ticket) {
+    if (ticket->state.exchange(Ticket::Cancelled) == Ticket::Waiting) {
+        live--;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Pair the two longest waiting clients
+ *
+ * Cancelled entries met on the way are dropped. If only one live client is found it is put back, and the search repeats while at least two entries are queued: an entry added meanwhile by another thread is either seen here or by that thread's own call.
+ *
+ * @param match Set to the two clients if a pair was made
+ *
+ * @return bool True if a pair was made, false if fewer than two clients are waiting
+*/
+bool Lobby::match(Match& match) {
+    while (queued() >= 2) {
+        Entry first;
+        if (!pop(first) || !claim(first)) {
+            continue;
+        }
+        Entry second;
+        while (pop(second)) {
+            if (claim(second)) {
+                Clock::time_point now = Clock::now();
+                recordWait(first, now);
+                recordWait(second, now);
+                matched++;
+                reserved -= 2;
+                match.waiting = std::move(first);
+                match.joining = std::move(second);
+                return true;
+            }
+        }
+        // Alone: put the client back, unless it left while we held it
+        int expected = Ticket::Claimed;
+        if (!first.ticket->state.compare_exchange_strong(expected, Ticket::Waiting)) {
+            reserved--;
+            continue;
+        }
+        live++;
+        while (!push(std::move(first))) {
+            std::this_thread::yield();
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Get the number of clients waiting
+ *
+ * @return size_t The number of clients in the lobby that have not left or been matched
+*/
+size_t Lobby::waiting() const {
+    return live.load();
+}
+
+/**
+ * @brief Get the number of pairs made
+ *
+ * @return uint64_t The number of successful matches
+*/
+uint64_t Lobby::matches() const {
+    return matched.load();
+}
+
+/**
+ * @brief Get the mean wait of matched clients
+ *
+ * @return std::chrono::microseconds The average time between entering the lobby and being matched
+*/
+std::chrono::microseconds Lobby::averageWait() const {
+    uint64_t count = matched.load() * 2;
+    return std::chrono::microseconds(count > 0 ? totalWait.load() / count : 0);
+}
+
+/**
+ * @brief Get the longest wait of a matched client
+ *
+ * @return std::chrono::microseconds The longest time between entering the lobby and being matched
+*/
+std::chrono::microseconds Lobby::longestWait() const {
+    return std::chrono::microseconds(maxWait.load());
+}
+
+/**
+ * @brief Add an entry to the ring
+ *
+ * A producer claims the next cell by advancing enqueuePos, fills it and publishes it by bumping the cell's sequence.
+ *
+ * @param entry The entry to add (moved from only on success)
+ *
+ * @return bool True if the entry was added, false if the ring is full
+*/
+bool Lobby::push(Entry&& entry) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // the cell still holds the previous lap's entry
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->entry = std::move(entry);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Remove the oldest entry from the ring
+ *
+ * @param entry Set to the removed entry
+ *
+ * @return bool True if an entry was removed, false if the ring is empty
+*/
+bool Lobby::pop(Entry& entry) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeuePos.compare_exchange_weak(pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // the cell has not been filled yet
+        } else {
+            pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    entry = std::move(cell->entry);
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Get the number of entries in the ring
+ *
+ * @return size_t The number of entries added and not removed yet, cancelled ones included
+*/
+size_t Lobby::queued() const {
+    size_t head = dequeuePos.load(); // read first: enqueuePos never falls behind it
+    return enqueuePos.load() - head;
+}
+
+/**
+ * @brief Claim a popped entry for a match
+ *
+ * @param entry The popped entry
+ *
+ * @return bool True if the client is still waiting and now belongs to the caller, false if it left (the entry is dropped)
+*/
+bool Lobby::claim(Entry& entry) {
+    int expected = Ticket::Waiting;
+    if (entry.ticket->state.compare_exchange_strong(expected, Ticket::Claimed)) {
+        live--;
+        return true;
+    }
+    reserved--;
+    return false;
+}
+
+/**
+ * @brief Record the wait of a matched client
+ *
+ * @param entry The matched client
+ * @param now The time of the match
+ *
+ * @return void
+*/
+void Lobby::recordWait(const Entry& entry, Clock::time_point now) {
+    uint64_t wait = std::chrono::duration_cast<std::chrono::microseconds>(now - entry.since).count();
+    totalWait += wait;
+    uint64_t longest = maxWait.load();
+    while (wait > longest && !maxWait.compare_exchange_weak(longest, wait)) {
+    }
+}
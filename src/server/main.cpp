@@ -7,16 +7,33 @@
 */
 
 #include <server/socket_server.h>
+#include <csignal>
 
 int main() {
     // Get port from user
     std::cout << "Enter the port number: ";
     int port;
     std::cin >> port;
-    // Start the server
-    Server myServer(port);
+    // Start the server with one reactor per core
+    ServerConfig config;
+    config.reactors = std::max(1u, std::thread::hardware_concurrency());
+    // Take SIGINT and SIGTERM on a thread of our own (blocked before the reactors start so they inherit the mask)
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    Server myServer(port, config);
+    std::thread([&myServer, signals]() {
+        int signal;
+        sigwait(&signals, &signal);
+        std::cout << "Draining clients..." << std::endl;
+        myServer.shutdown(); // first signal: let clients finish receiving
+        sigwait(&signals, &signal);
+        myServer.stop(); // second signal: stop now
+    }).detach();
     std::cout << "Server started on port " << port << std::endl;
-    std::cout << "Press Ctrl+C to stop the server." << std::endl;
+    std::cout << "Press Ctrl+C to stop the server (twice to skip draining the clients)." << std::endl;
     myServer.run();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,545 @@
+/**
+ * @file server/offline_store.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the OfflineStore class
+ *
+ * This file contains the implementation of the OfflineStore class, the segmented append-only log that keeps messages for users until they log in.
+*/
+
+#include <server/offline_store.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ * @brief A segment file and its mapping
+*/
+struct OfflineStore::Segment {
+    std::string path; // file name
+    int fd = -1; // open for writing
+    char* data = nullptr; // read-only mapping of the whole file
+    size_t size = 0; // size of the file
+    size_t end = 0; // where the next record goes
+    size_t live = 0; // messages not delivered yet
+
+    ~Segment() {
+        if (data != nullptr) {
+            munmap(data, size);
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+};
+
+namespace {
+
+enum RecordKind : uint8_t {
+    End = 0, // unwritten space (segments are created zero filled)
+    Stored = 1, // a message for the recipient
+    Delivered = 2 // every earlier message for the recipient was delivered
+};
+
+// Header in front of every record, followed by the recipient and the payload
+struct RecordHeader {
+    uint32_t size; // payload size
+    uint32_t checksum; // FNV-1a of the recipient and the payload
+    uint16_t recipientSize; // recipient size
+    uint8_t kind; // RecordKind
+    uint8_t reserved;
+};
+
+constexpr size_t HEADER_SIZE = sizeof(RecordHeader);
+
+uint32_t checksum(const char* data, size_t size, uint32_t hash = 2166136261u) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// Build the header of a record
+RecordHeader makeHeader(uint8_t kind, const std::string& recipient, const char* data, size_t size) {
+    RecordHeader header{};
+    header.size = static_cast<uint32_t>(size);
+    header.checksum = checksum(data, size, checksum(recipient.data(), recipient.size()));
+    header.recipientSize = static_cast<uint16_t>(recipient.size());
+    header.kind = kind;
+    return header;
+}
+
+// Add a whole record to the end of a buffer
+void encodeRecord(std::string& buffer, uint8_t kind, const std::string& recipient, const char* data, size_t size) {
+    RecordHeader header = makeHeader(kind, recipient, data, size);
+    buffer.append(reinterpret_cast<const char*>(&header), HEADER_SIZE);
+    buffer.append(recipient);
+    if (size > 0) {
+        buffer.append(data, size);
+    }
+}
+
+// Create a directory and its missing parents
+bool makeDirectories(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0700) == -1 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+// Open and map a segment file, creating it with the given size if it does not exist
+std::shared_ptr<OfflineStore::Segment> mapSegment(const std::string& path, size_t size) {
+    auto segment = std::make_shared<OfflineStore::Segment>();
+    segment->path = path;
+    segment->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    struct stat info;
+    if (segment->fd == -1 || fstat(segment->fd, &info) == -1) {
+        return nullptr;
+    }
+    if (info.st_size == 0 && ftruncate(segment->fd, static_cast<off_t>(size)) == -1) {
+        return nullptr;
+    }
+    segment->size = info.st_size == 0 ? size : static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, segment->size, PROT_READ, MAP_SHARED, segment->fd, 0);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    segment->data = static_cast<char*>(mapping);
+    return segment;
+}
+
+} // namespace
+
+/**
+ * @brief Construct a new OfflineStore object
+ *
+ * @param directory The directory holding the segment files (created if needed)
+ * @param segmentSize The size of a segment file, the largest record it can hold
+ * @param syncInterval The time between two syncs of the log
+ * @param mailboxLimit The number of messages a recipient may have waiting
+ * @param storeLimit The disk space the segment files may take, rounded down to whole segments but at least one (0: no limit)
+ *
+ * @return OfflineStore object
+*/
+OfflineStore::OfflineStore(const std::string& directory, size_t segmentSize, std::chrono::milliseconds syncInterval, size_t mailboxLimit, size_t storeLimit)
+    : directory(directory), segmentSize(segmentSize), syncInterval(std::max(syncInterval, std::chrono::milliseconds(1))), mailboxLimit(mailboxLimit),
+      segmentLimit(storeLimit == 0 ? 0 : std::max<size_t>(storeLimit / std::max<size_t>(segmentSize, 1), 1)) {
+    if (!makeDirectories(directory)) {
+        throw std::runtime_error("Failed to create the offline message directory");
+    }
+    open();
+    syncer = std::thread([this]() { syncLoop(); });
+}
+
+/**
+ * @brief Destroy the OfflineStore object
+ *
+ * Stop the sync thread and sync what it had not synced yet.
+ *
+ * @return void
+*/
+OfflineStore::~OfflineStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    syncer.join();
+    sync();
+}
+
+/**
+ * @brief Store a message for a user
+ *
+ * Starting a new segment may delete the oldest messages of the store, if it is full.
+ *
+ * @param recipient The user to deliver the message to
+ * @param data The message, stored as is
+ * @param size The size of the message
+ *
+ * @return bool True if the message was stored, false if the recipient has too many messages waiting or it cannot be written
+*/
+bool OfflineStore::append(const std::string& recipient, const char* data, size_t size) {
+    if (recipient.size() > UINT16_MAX || HEADER_SIZE + recipient.size() + size > segmentSize) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = mailboxes.find(recipient);
+    if ((found == mailboxes.end() ? 0 : found->second.size()) >= mailboxLimit) {
+        return false;
+    }
+    size_t length = HEADER_SIZE + recipient.size() + size;
+    Segment* segment = segments.rbegin()->second.get();
+    if (segment->end + length > segment->size && !roll(length)) {
+        return false;
+    }
+    std::shared_ptr<Segment>& active = segments.rbegin()->second;
+    size_t offset = active->end;
+    if (!write(Stored, recipient, data, size)) {
+        return false;
+    }
+    mailboxes[recipient].push_back(Message{active, active->data + offset + HEADER_SIZE + recipient.size(), size}); // looked up again, rolling may have moved or dropped the mailbox
+    active->live++;
+    return true;
+}
+
+/**
+ * @brief Take the messages waiting for a user
+ *
+ * The messages are marked delivered right away: a client that drops while they are being sent does not get them again.
+ *
+ * @param recipient The user that logged in
+ *
+ * @return std::vector<Message> The messages in the order they were stored
+*/
+std::vector<OfflineStore::Message> OfflineStore::take(const std::string& recipient) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = mailboxes.find(recipient);
+    if (found == mailboxes.end()) {
+        return {};
+    }
+    std::vector<Message> messages = std::move(found->second);
+    mailboxes.erase(found);
+    Segment* segment = segments.rbegin()->second.get();
+    if (segment->end + HEADER_SIZE + recipient.size() <= segment->size || roll(HEADER_SIZE + recipient.size())) {
+        write(Delivered, recipient, nullptr, 0); // if this fails the messages are delivered again after a restart
+    }
+    for (const Message& message : messages) {
+        message.segment->live--;
+    }
+    collect();
+    return messages;
+}
+
+/**
+ * @brief Get the number of messages waiting for a user
+ *
+ * @param recipient The user
+ *
+ * @return size_t The number of undelivered messages
+*/
+size_t OfflineStore::pending(const std::string& recipient) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = mailboxes.find(recipient);
+    return found == mailboxes.end() ? 0 : found->second.size();
+}
+
+/**
+ * @brief Get the number of segment files
+ *
+ * @return size_t The number of segments kept, the one being written included
+*/
+size_t OfflineStore::segmentCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments.size();
+}
+
+/**
+ * @brief Get the number of messages dropped to keep the store under its limit
+ *
+ * @return uint64_t The number of messages deleted before they were delivered
+*/
+uint64_t OfflineStore::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return droppedMessages;
+}
+
+/**
+ * @brief Sync the log
+ *
+ * Every segment written since the last sync is flushed to the disk, outside the lock so appends are not held up.
+ *
+ * @return void
+*/
+void OfflineStore::sync() {
+    std::vector<std::shared_ptr<Segment>> pending;
+    bool created;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(unsynced);
+        created = segmentCreated;
+        segmentCreated = false;
+    }
+    for (const auto& segment : pending) {
+        fdatasync(segment->fd);
+    }
+    if (created) {
+        // Make the new file names durable too
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd != -1) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+}
+
+/**
+ * @brief Read back the log
+ *
+ * The segments are scanned in order, rebuilding the mailboxes: stored messages are added and delivery records empty them. The newest segment is written to from where its records end.
+ *
+ * @return void
+*/
+void OfflineStore::open() {
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        throw std::runtime_error("Failed to open the offline message directory");
+    }
+    std::vector<uint64_t> numbers;
+    while (dirent* entry = readdir(dir)) {
+        unsigned long long number;
+        char tail;
+        if (std::sscanf(entry->d_name, "segment-%llu.lo%c", &number, &tail) == 2 && tail == 'g') {
+            numbers.push_back(number);
+        }
+    }
+    closedir(dir);
+    std::sort(numbers.begin(), numbers.end());
+
+    for (uint64_t number : numbers) {
+        std::shared_ptr<Segment> segment = mapSegment(segmentPath(number), segmentSize);
+        if (segment == nullptr) {
+            throw std::runtime_error("Failed to open an offline message segment");
+        }
+        size_t position = 0;
+        while (position + HEADER_SIZE <= segment->size) {
+            RecordHeader header;
+            std::memcpy(&header, segment->data + position, HEADER_SIZE);
+            size_t length = HEADER_SIZE + header.recipientSize + header.size;
+            if (header.kind == End || position + length > segment->size) {
+                break;
+            }
+            const char* recipient = segment->data + position + HEADER_SIZE;
+            const char* payload = recipient + header.recipientSize;
+            if (checksum(payload, header.size, checksum(recipient, header.recipientSize)) != header.checksum) {
+                break; // cut short by a crash
+            }
+            std::string name(recipient, header.recipientSize);
+            if (header.kind == Stored) {
+                mailboxes[name].push_back(Message{segment, payload, header.size});
+                segment->live++;
+            } else if (header.kind == Delivered) {
+                auto found = mailboxes.find(name);
+                if (found != mailboxes.end()) {
+                    for (const Message& message : found->second) {
+                        message.segment->live--;
+                    }
+                    mailboxes.erase(found);
+                }
+            }
+            position += length;
+        }
+        segment->end = position;
+        segments.emplace(number, std::move(segment));
+    }
+    if (segments.empty() && !roll(0)) {
+        throw std::runtime_error("Failed to create an offline message segment");
+    }
+    collect();
+    trim(); // the limit may have been lowered since the log was written
+}
+
+/**
+ * @brief Start a new segment
+ *
+ * The older segments are then reclaimed: the ones done with are deleted, the mailboxes keeping the oldest ones are compacted into the new segment, and the store is trimmed back to its limit.
+ *
+ * @param reserve The size of the record the caller writes next, compaction leaves room for it
+ *
+ * @return bool True if the new segment is the one written to, false if it could not be created
+*/
+bool OfflineStore::roll(size_t reserve) {
+    uint64_t number = segments.empty() ? 1 : segments.rbegin()->first + 1;
+    std::shared_ptr<Segment> segment = mapSegment(segmentPath(number), segmentSize);
+    if (segment == nullptr) {
+        unlink(segmentPath(number).c_str());
+        return false;
+    }
+    segments.emplace(number, std::move(segment));
+    segmentCreated = true;
+    compact(reserve); // the previous segment may have been waiting only for this one to be replaced
+    trim();
+    return true;
+}
+
+/**
+ * @brief Append a record to the newest segment
+ *
+ * The caller checked that the record fits. The header, recipient and payload are written with one system call.
+ *
+ * @param kind The record kind
+ * @param recipient The user the record is about
+ * @param data The payload
+ * @param size The size of the payload
+ *
+ * @return bool True if the record was written
+*/
+bool OfflineStore::write(uint8_t kind, const std::string& recipient, const char* data, size_t size) {
+    RecordHeader header = makeHeader(kind, recipient, data, size);
+    iovec parts[3] = {{&header, HEADER_SIZE}, {const_cast<char*>(recipient.data()), recipient.size()}, {const_cast<char*>(data), size}};
+    return write(parts, 3, HEADER_SIZE + recipient.size() + size);
+}
+
+/**
+ * @brief Append encoded records to the newest segment
+ *
+ * The caller checked that they fit.
+ *
+ * @param parts The pieces of the records, written in order with one system call
+ * @param count The number of pieces
+ * @param length The total size of the pieces
+ *
+ * @return bool True if the records were written
+*/
+bool OfflineStore::write(const iovec* parts, int count, size_t length) {
+    const std::shared_ptr<Segment>& segment = segments.rbegin()->second;
+    if (pwritev(segment->fd, parts, count, static_cast<off_t>(segment->end)) != static_cast<ssize_t>(length)) {
+        return false;
+    }
+    segment->end += length;
+    if (unsynced.empty() || unsynced.back() != segment) {
+        unsynced.push_back(segment);
+    }
+    return true;
+}
+
+/**
+ * @brief Delete the segments that are done
+ *
+ * Segments are deleted oldest first while they hold no undelivered message. The newest one is kept, it is being written to. A deleted segment stays mapped until the last message taken from it is released.
+ *
+ * @return void
+*/
+void OfflineStore::collect() {
+    while (segments.size() > 1 && segments.begin()->second->live == 0) {
+        unlink(segments.begin()->second->path.c_str());
+        segments.erase(segments.begin());
+    }
+}
+
+/**
+ * @brief Free the oldest segments from the few messages keeping them
+ *
+ * A segment is only deleted once every message in it was delivered, so a handful of messages for users who never log in would keep it, and all the segments after it, forever. While the mailboxes holding messages in the oldest segment are small, each of them is written again at the end of the log: a delivery record, then a copy of every message in order, so a restart reads back the copies only. The copies are synced before the segment is deleted. At most a quarter of a segment is copied per call.
+ *
+ * @param reserve The room to leave in the newest segment for the record the caller writes next
+ *
+ * @return void
+*/
+void OfflineStore::compact(size_t reserve) {
+    size_t budget = segmentSize / 4;
+    collect();
+    while (segments.size() > 1) {
+        std::shared_ptr<Segment> oldest = segments.begin()->second;
+        std::vector<std::string> pinning; // a mailbox is in log order, so its messages in the oldest segment come first
+        size_t length = 0;
+        for (const auto& entry : mailboxes) {
+            if (!entry.second.empty() && entry.second.front().segment == oldest) {
+                pinning.push_back(entry.first);
+                length += HEADER_SIZE + entry.first.size();
+                for (const Message& message : entry.second) {
+                    length += HEADER_SIZE + entry.first.size() + message.size;
+                }
+            }
+        }
+        const std::shared_ptr<Segment>& active = segments.rbegin()->second;
+        if (pinning.empty() || length > budget || active->end + length + reserve > active->size) {
+            return;
+        }
+        budget -= length;
+        for (const std::string& recipient : pinning) {
+            std::vector<Message>& mailbox = mailboxes[recipient];
+            std::string records;
+            encodeRecord(records, Delivered, recipient, nullptr, 0);
+            for (const Message& message : mailbox) {
+                encodeRecord(records, Stored, recipient, message.data, message.size);
+            }
+            size_t offset = active->end + HEADER_SIZE + recipient.size(); // past the delivery record
+            iovec part = {&records[0], records.size()};
+            if (!write(&part, 1, records.size())) {
+                return; // the mailbox stays where it was
+            }
+            for (Message& message : mailbox) {
+                size_t size = message.size;
+                message.segment->live--;
+                message = Message{active, active->data + offset + HEADER_SIZE + recipient.size(), size};
+                active->live++;
+                offset += HEADER_SIZE + recipient.size() + size;
+            }
+        }
+        if (oldest->live != 0) {
+            return; // messages taken from it are still being counted out
+        }
+        fdatasync(active->fd);
+        collect();
+    }
+}
+
+/**
+ * @brief Keep the store under its size limit
+ *
+ * While there are more segments than the limit allows, the oldest one is deleted along with the messages still waiting in it: the oldest messages give way to new ones, so no user can fill the disk. compact() has saved what it could first.
+ *
+ * @return void
+*/
+void OfflineStore::trim() {
+    while (segmentLimit != 0 && segments.size() > segmentLimit) {
+        std::shared_ptr<Segment> oldest = segments.begin()->second;
+        for (auto it = mailboxes.begin(); it != mailboxes.end();) {
+            std::vector<Message>& mailbox = it->second;
+            auto kept = std::find_if(mailbox.begin(), mailbox.end(), [&oldest](const Message& message) { return message.segment != oldest; });
+            if (kept == mailbox.begin()) {
+                ++it;
+                continue;
+            }
+            droppedMessages += kept - mailbox.begin();
+            mailbox.erase(mailbox.begin(), kept);
+            it = mailbox.empty() ? mailboxes.erase(it) : std::next(it);
+        }
+        unlink(oldest->path.c_str());
+        segments.erase(segments.begin());
+    }
+}
+
+/**
+ * @brief Get the file name of a segment
+ *
+ * @param number The segment number
+ *
+ * @return std::string The path of the segment file
+*/
+std::string OfflineStore::segmentPath(uint64_t number) const {
+    char name[48];
+    std::snprintf(name, sizeof(name), "/segment-%020llu.log", static_cast<unsigned long long>(number));
+    return directory + name;
+}
+
+/**
+ * @brief Sync the log periodically
+ *
+ * Runs on the store's own thread until the store is destroyed, so neither the reactors nor the workers ever wait for the disk.
+ *
+ * @return void
+*/
+void OfflineStore::syncLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, syncInterval, [this]() { return stopping; });
+        lock.unlock();
+        sync();
+        lock.lock();
+    }
+}
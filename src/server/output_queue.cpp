@@ -0,0 +1,128 @@
+/**
+ * @file server/output_queue.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the OutputQueue class
+ *
+ * This file contains the implementation of the OutputQueue class, which keeps the data a slow client has not read yet and writes it with scatter/gather I/O once the client catches up.
+*/
+
+#include <server/output_queue.h>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Construct a new OutputQueue object
+ *
+ * @return OutputQueue object
+*/
+OutputQueue::OutputQueue() : bytes(0) {}
+
+/**
+ * @brief Queue a copy of some data
+ *
+ * @param data The data to queue
+ *
+ * @return void
+*/
+void OutputQueue::push(std::string data) {
+    if (data.empty()) {
+        return;
+    }
+    auto owner = std::make_shared<const std::string>(std::move(data));
+    push(owner, owner->data(), owner->size());
+}
+
+/**
+ * @brief Queue part of a shared buffer
+ *
+ * The queue keeps a reference to the buffer until the data is written, so the same buffer can be queued for many clients.
+ *
+ * @param buffer The buffer that owns the data
+ * @param data The first byte to queue (inside the buffer)
+ * @param size The number of bytes to queue
+ *
+ * @return void
+*/
+void OutputQueue::push(std::shared_ptr<const std::string> buffer, const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    queue.push_back(Chunk{std::move(buffer), data, size});
+    bytes += size;
+}
+
+/**
+ * @brief Write queued data to a socket
+ *
+ * Hand up to MAX_IOV chunks to the kernel in one call and drop whatever was written, repeating until the queue is empty or the socket is full. sendmsg is used rather than writev so a closed client cannot raise SIGPIPE.
+ *
+ * @param socket The (non-blocking) socket to write to
+ *
+ * @return bool True if the socket is healthy (even if it is full), false if the write failed
+*/
+bool OutputQueue::flush(int socket) {
+    while (!queue.empty()) {
+        iovec parts[MAX_IOV];
+        size_t count = 0;
+        size_t total = 0;
+        for (auto it = queue.begin(); it != queue.end() && count < MAX_IOV; ++it, ++count) {
+            parts[count] = {const_cast<char*>(it->data), it->size};
+            total += it->size;
+        }
+        msghdr msg{};
+        msg.msg_iov = parts;
+        msg.msg_iovlen = count;
+        ssize_t written = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        size_t left = static_cast<size_t>(written);
+        bytes -= left;
+        while (left > 0) {
+            Chunk& front = queue.front();
+            if (left < front.size) {
+                front.data += left;
+                front.size -= left;
+                break;
+            }
+            left -= front.size;
+            queue.pop_front();
+        }
+        if (static_cast<size_t>(written) < total) {
+            return true; // short write, the socket is full
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check if the queue is empty
+ *
+ * @return bool True if no data is waiting, false otherwise
+*/
+bool OutputQueue::empty() const {
+    return queue.empty();
+}
+
+/**
+ * @brief Get the number of bytes waiting
+ *
+ * @return size_t The queue depth in bytes
+*/
+size_t OutputQueue::size() const {
+    return bytes;
+}
+
+/**
+ * @brief Get the number of chunks waiting
+ *
+ * @return size_t The queue depth in chunks
+*/
+size_t OutputQueue::chunks() const {
+    return queue.size();
+}
@@ -0,0 +1,195 @@
+/**
+ * @file server/presence_index.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the PresenceIndex class
+ *
+ * This file contains the implementation of the PresenceIndex class, the sharded map of logged in users and of the sessions watching them.
+*/
+
+#include <server/presence_index.h>
+#include <algorithm>
+#include <functional>
+
+/**
+ * @brief Construct a new PresenceIndex object
+ *
+ * @param shards The number of independently locked parts of the map (at least one)
+ *
+ * @return PresenceIndex object
+*/
+PresenceIndex::PresenceIndex(size_t shards) : shards(new Shard[std::max<size_t>(shards, 1)]), shardCount(std::max<size_t>(shards, 1)) {}
+
+/**
+ * @brief Record a login
+ *
+ * A user logged in twice is reachable through its newest session. Its watchers are only told when its first session starts.
+ *
+ * @param user The username
+ * @param session The session the user logged in with
+ *
+ * @return std::vector<Session> The sessions watching the user, empty if it was already logged in
+*/
+std::vector<PresenceIndex::Session> PresenceIndex::setOnline(const std::string& user, Session session) {
+    Shard& shard = shardOf(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::vector<Session>& sessions = shard.sessions[user];
+    sessions.push_back(session);
+    if (sessions.size() > 1) {
+        return {};
+    }
+    auto it = shard.watchers.find(user);
+    return it != shard.watchers.end() ? it->second : std::vector<Session>();
+}
+
+/**
+ * @brief Record a logout
+ *
+ * The user goes offline with its last session.
+ *
+ * @param user The username
+ * @param session The session that ended
+ *
+ * @return std::vector<Session> The sessions watching the user, empty if the user is still logged in with another session
+*/
+std::vector<PresenceIndex::Session> PresenceIndex::setOffline(const std::string& user, Session session) {
+    Shard& shard = shardOf(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(user);
+    if (it == shard.sessions.end()) {
+        return {};
+    }
+    std::vector<Session>& sessions = it->second;
+    auto ended = std::find(sessions.begin(), sessions.end(), session);
+    if (ended == sessions.end()) {
+        return {};
+    }
+    sessions.erase(ended);
+    if (!sessions.empty()) {
+        return {};
+    }
+    shard.sessions.erase(it);
+    auto watching = shard.watchers.find(user);
+    return watching != shard.watchers.end() ? watching->second : std::vector<Session>();
+}
+
+/**
+ * @brief Look up a user
+ *
+ * @param user The username
+ * @param session Set to the user's newest session if the user is online
+ *
+ * @return bool True if the user is online, false otherwise
+*/
+bool PresenceIndex::find(const std::string& user, Session& session) const {
+    Shard& shard = shardOf(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(user);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+    session = it->second.back();
+    return true;
+}
+
+/**
+ * @brief Follow a user's session to another reactor
+ *
+ * @param user The username
+ * @param from The session before the move
+ * @param to The session after the move
+ *
+ * @return void
+*/
+void PresenceIndex::relocate(const std::string& user, Session from, Session to) {
+    Shard& shard = shardOf(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(user);
+    if (it != shard.sessions.end()) {
+        std::replace(it->second.begin(), it->second.end(), from, to);
+    }
+}
+
+/**
+ * @brief Watch a user
+ *
+ * @param user The username to watch (it does not have to exist)
+ * @param watcher The session to tell about the user's changes
+ *
+ * @return bool True if the user is online now, false otherwise
+*/
+bool PresenceIndex::watch(const std::string& user, Session watcher) {
+    Shard& shard = shardOf(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::vector<Session>& list = shard.watchers[user];
+    if (std::find(list.begin(), list.end(), watcher) == list.end()) {
+        list.push_back(watcher);
+    }
+    return shard.sessions.count(user) > 0;
+}
+
+/**
+ * @brief Stop watching a user
+ *
+ * @param user The username
+ * @param watcher The session that watched it
+ *
+ * @return void
+*/
+void PresenceIndex::unwatch(const std::string& user, Session watcher) {
+    Shard& shard = shardOf(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.watchers.find(user);
+    if (it == shard.watchers.end()) {
+        return;
+    }
+    std::vector<Session>& list = it->second;
+    list.erase(std::remove(list.begin(), list.end(), watcher), list.end());
+    if (list.empty()) {
+        shard.watchers.erase(it);
+    }
+}
+
+/**
+ * @brief Follow a watcher to another reactor
+ *
+ * @param user The username it watches
+ * @param from The watcher before the move
+ * @param to The watcher after the move
+ *
+ * @return void
+*/
+void PresenceIndex::relocateWatcher(const std::string& user, Session from, Session to) {
+    Shard& shard = shardOf(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.watchers.find(user);
+    if (it == shard.watchers.end()) {
+        return;
+    }
+    std::replace(it->second.begin(), it->second.end(), from, to);
+}
+
+/**
+ * @brief Get the number of users logged in
+ *
+ * @return size_t The number of users with a session (the shards are counted one at a time)
+*/
+size_t PresenceIndex::online() const {
+    size_t count = 0;
+    for (size_t i = 0; i < shardCount; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        count += shards[i].sessions.size();
+    }
+    return count;
+}
+
+/**
+ * @brief Find the shard holding a user
+ *
+ * @param user The username
+ *
+ * @return Shard& The shard
+*/
+PresenceIndex::Shard& PresenceIndex::shardOf(const std::string& user) const {
+    return shards[std::hash<std::string>()(user) % shardCount];
+}
@@ -0,0 +1,123 @@
+/**
+ * @file server/reactor.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the Reactor class
+ *
+ * This file contains the implementation of the Reactor class, one event loop thread of the server together with its listening socket, timers, connections and the mailbox other threads use to hand it work.
+*/
+
+#include <server/reactor.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/**
+ * @brief Construct a new Reactor object
+ *
+ * Create the eventfd used to wake the loop and watch it, so tasks posted from other threads run promptly.
+ *
+ * @param listenSocket The listening socket of the reactor (owned by the reactor from now on)
+ * @param timerResolution The tick of the reactor's timer wheel
+ *
+ * @return Reactor object
+*/
+Reactor::Reactor(int listenSocket, std::chrono::milliseconds timerResolution) : listenSocket(listenSocket), timers(timerResolution), readBuffer(64 * 1024), queuedBytes(0), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (wakeFd == -1) {
+        throw std::runtime_error("Failed to create eventfd");
+    }
+    loop.add(wakeFd, EPOLLIN, [this](uint32_t) {
+        uint64_t value;
+        while (read(wakeFd, &value, sizeof(value)) > 0) {
+        }
+        runTasks();
+    });
+}
+
+/**
+ * @brief Destroy the Reactor object
+ *
+ * Close the wake descriptor and the listening socket. Connections must have been closed by the server already.
+ *
+ * @return void
+*/
+Reactor::~Reactor() {
+    loop.remove(wakeFd);
+    close(wakeFd);
+    if (listenSocket != -1) {
+        close(listenSocket);
+    }
+}
+
+/**
+ * @brief Run the reactor
+ *
+ * Serve the reactor's sockets until running is cleared or the reactor is stopped: expire deadlines, then sleep until the next one is due, a socket is ready or a task is posted. Whoever clears running must post a task to wake the loop.
+ *
+ * @param running Flag checked between polls
+ *
+ * @return void
+*/
+void Reactor::run(const std::atomic<bool>& running) {
+    while (running && !stopped) {
+        auto now = TimerWheel::Clock::now();
+        timers.advance(now);
+        if (loop.poll(timers.nextTimeoutMs(now)) < 0) {
+            std::cerr << "Error waiting for events." << std::endl;
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Stop the reactor
+ *
+ * Called from the reactor's own thread (a task or a callback), the loop returns once the current iteration is done.
+ *
+ * @return void
+*/
+void Reactor::stop() {
+    stopped = true;
+}
+
+/**
+ * @brief Post a task to the reactor
+ *
+ * Queue the task and wake the loop. Only the first task of a batch writes to the eventfd.
+ *
+ * @param task The task to run on the reactor thread
+ *
+ * @return void
+*/
+void Reactor::post(Task task) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        wake = mailbox.empty();
+        mailbox.push_back(std::move(task));
+    }
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written; // the counter cannot overflow with one write per batch
+    }
+}
+
+/**
+ * @brief Run the posted tasks
+ *
+ * Swap the mailbox out under the lock and run the tasks without holding it, so a task may post again.
+ *
+ * @return void
+*/
+void Reactor::runTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        tasks.swap(mailbox);
+    }
+    for (Task& task : tasks) {
+        task();
+    }
+}
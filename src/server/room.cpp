@@ -0,0 +1,144 @@
+/**
+ * @file server/room.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the Room and SharedFrame classes
+ *
+ * This file contains the implementation of the Room class, the members of a chat, and of the SharedFrame class, which lets one message be queued for every member without copying it per member.
+*/
+
+#include <server/room.h>
+#include <server/connection.h>
+#include <common/framing.h>
+
+/**
+ * @brief Construct a new Room object
+ *
+ * @param name The name clients join the room by, empty for a pair made by the lobby
+ *
+ * @return Room object
+*/
+Room::Room(std::string name) : congested(0), roomName(std::move(name)) {}
+
+/**
+ * @brief Get the name of the room
+ *
+ * @return const std::string& The name, empty for a pair
+*/
+const std::string& Room::name() const {
+    return roomName;
+}
+
+/**
+ * @brief Check if the room is a pair made by the lobby
+ *
+ * @return bool True for a pair, false for a room joined by name
+*/
+bool Room::isPair() const {
+    return roomName.empty();
+}
+
+/**
+ * @brief Add a member
+ *
+ * @param member The client joining the room
+ *
+ * @return void
+*/
+void Room::add(Connection& member) {
+    member.roomIndex = memberList.size();
+    memberList.push_back(&member);
+}
+
+/**
+ * @brief Remove a member
+ *
+ * The last member takes the removed member's place, so removal does not depend on the room size.
+ *
+ * @param member The client leaving the room
+ *
+ * @return void
+*/
+void Room::remove(Connection& member) {
+    size_t index = member.roomIndex;
+    if (index >= memberList.size() || memberList[index] != &member) {
+        return;
+    }
+    memberList[index] = memberList.back();
+    memberList[index]->roomIndex = index;
+    memberList.pop_back();
+}
+
+/**
+ * @brief Get the number of members
+ *
+ * @return size_t The number of clients in the room
+*/
+size_t Room::size() const {
+    return memberList.size();
+}
+
+/**
+ * @brief Get the members
+ *
+ * @return const std::vector<Connection*>& The clients in the room
+*/
+const std::vector<Connection*>& Room::members() const {
+    return memberList;
+}
+
+/**
+ * @brief Construct a new SharedFrame object
+ *
+ * @param data The message, usually in the reactor's read buffer
+ * @param size The message size
+ *
+ * @return SharedFrame object
+*/
+SharedFrame::SharedFrame(const char* data, size_t size) : payload(data), length(size) {}
+
+/**
+ * @brief Get the message
+ *
+ * @return const char* The message
+*/
+const char* SharedFrame::data() const {
+    return payload;
+}
+
+/**
+ * @brief Get the message size
+ *
+ * @return size_t The message size
+*/
+size_t SharedFrame::size() const {
+    return length;
+}
+
+/**
+ * @brief Get the message framed for sending
+ *
+ * The copy is made the first time a framing is asked for and shared by every later caller.
+ *
+ * @param binary True for a binary frame (header then message), false for JSON framing (message then newline)
+ *
+ * @return const std::shared_ptr<const std::string>& The framed message
+*/
+const std::shared_ptr<const std::string>& SharedFrame::framed(bool binary) {
+    std::shared_ptr<const std::string>& frame = frames[binary ? 1 : 0];
+    if (!frame) {
+        std::string wire;
+        wire.reserve(length + Framing::HEADER_SIZE);
+        if (binary) {
+            char header[Framing::HEADER_SIZE];
+            Framing::encodeHeader(header, length, Framing::FrameType::Json);
+            wire.append(header, sizeof(header));
+            wire.append(payload, length);
+        } else {
+            wire.append(payload, length);
+            wire.push_back('\n');
+        }
+        frame = std::make_shared<const std::string>(std::move(wire));
+    }
+    return frame;
+}
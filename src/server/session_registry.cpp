@@ -0,0 +1,154 @@
+/**
+ * @file server/session_registry.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the SessionRegistry class
+ *
+ * This file contains the implementation of the SessionRegistry class, a slab of connection slots with generation checked handles.
+*/
+
+#include <server/session_registry.h>
+#include <server/connection.h>
+
+/**
+ * @brief Construct a new SessionRegistry object
+ *
+ * @return SessionRegistry object
+*/
+SessionRegistry::SessionRegistry() : freeHead(NO_SLOT), count(0) {}
+
+/**
+ * @brief Destroy the SessionRegistry object
+ *
+ * @return void
+*/
+SessionRegistry::~SessionRegistry() {
+    clear();
+}
+
+/**
+ * @brief Add a connection
+ *
+ * Take a free slot (or grow the slab if there is none) and store the connection's handle in it.
+ *
+ * @param connection The connection to add
+ *
+ * @return Handle The connection's handle
+*/
+SessionRegistry::Handle SessionRegistry::insert(std::unique_ptr<Connection> connection) {
+    uint32_t index = freeHead;
+    if (index == NO_SLOT) {
+        index = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    } else {
+        freeHead = slots[index].nextFree;
+    }
+    Slot& slot = slots[index];
+    Handle handle = (static_cast<Handle>(slot.generation) << 32) | index;
+    connection->handle = handle;
+    slot.connection = std::move(connection);
+    count++;
+    return handle;
+}
+
+/**
+ * @brief Remove a connection without freeing it
+ *
+ * The slot is freed and its generation bumped, so the handle stops resolving. Used to hand a connection over to another reactor.
+ *
+ * @param handle The connection's handle
+ *
+ * @return std::unique_ptr<Connection> The connection, or nullptr if the handle is stale
+*/
+std::unique_ptr<Connection> SessionRegistry::release(Handle handle) {
+    if (get(handle) == nullptr) {
+        return nullptr;
+    }
+    uint32_t index = static_cast<uint32_t>(handle);
+    Slot& slot = slots[index];
+    std::unique_ptr<Connection> connection = std::move(slot.connection);
+    slot.generation++;
+    slot.nextFree = freeHead;
+    freeHead = index;
+    count--;
+    return connection;
+}
+
+/**
+ * @brief Remove and free a connection
+ *
+ * @param handle The connection's handle
+ *
+ * @return bool True if the connection was freed, false if the handle is stale
+*/
+bool SessionRegistry::erase(Handle handle) {
+    return release(handle) != nullptr;
+}
+
+/**
+ * @brief Look up a connection
+ *
+ * @param handle The connection's handle
+ *
+ * @return Connection* The connection, or nullptr if it was removed
+*/
+Connection* SessionRegistry::get(Handle handle) const {
+    uint32_t index = static_cast<uint32_t>(handle);
+    uint32_t generation = static_cast<uint32_t>(handle >> 32);
+    if (index >= slots.size() || slots[index].generation != generation) {
+        return nullptr;
+    }
+    return slots[index].connection.get();
+}
+
+/**
+ * @brief Visit every live connection
+ *
+ * The visitor must not add or remove connections.
+ *
+ * @param visit The function to call with each connection
+ *
+ * @return void
+*/
+void SessionRegistry::forEach(const std::function<void(Connection&)>& visit) const {
+    for (const Slot& slot : slots) {
+        if (slot.connection != nullptr) {
+            visit(*slot.connection);
+        }
+    }
+}
+
+/**
+ * @brief Free every connection
+ *
+ * Every handle becomes stale, the slots are kept for reuse.
+ *
+ * @return void
+*/
+void SessionRegistry::clear() {
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (slots[i].connection != nullptr) {
+            erase((static_cast<Handle>(slots[i].generation) << 32) | i);
+        }
+    }
+}
+
+/**
+ * @brief Get the number of live connections
+ *
+ * @return size_t The number of connections in the registry
+*/
+size_t SessionRegistry::size() const {
+    return count;
+}
+
+/**
+ * @brief Get the number of slots
+ *
+ * Grows only to the peak number of live connections.
+ *
+ * @return size_t The number of slots allocated
+*/
+size_t SessionRegistry::capacity() const {
+    return slots.size();
+}
@@ -8,26 +8,79 @@
 */
 
 #include <server/socket_server.h>
-#include <server/userhandler.h>
 
 using json = nlohmann::json;
 
 /**
  * @brief Construct a new Server object
  * 
- * Initialize the server object with the specified port and RSA keys.
+ * Initialize the server object with the specified port and RSA keys, and create the reactors with one listening socket each.
  * 
  * @param port The port number to listen on
+ * @param config The limits and timeouts to use
  * 
  * @return Server object
 */
-Server::Server(int port) : rsa(), isRunning(true) {
+Server::Server(int port, const ServerConfig& config) : rsa(), tickets(config.ticketLifetime), isRunning(true), draining(false), config(config), lobby(config.lobbyCapacity),
+    offline(config.offlineDirectory, config.offlineSegmentSize, config.offlineSyncInterval, config.offlineMailboxLimit, config.offlineStoreLimit), users(config.usersFile, config.usersDatabase, config.passwordKdf), verifier(config.verifyBatch),
+    usersWatcher(config.watchUsersFile ? config.usersFile : "", [this]() { refreshUsers(); }),
+    workers(config.authWorkers > 0 ? config.authWorkers : std::max(1u, std::thread::hardware_concurrency()), config.authQueueLimit) {
+    publicKeyMessage = RSAWrapper::sendPublicKey(rsa.getPublicKey());
+    users.Refresh(); // users appended after the file was loaded but before it was watched
+    PasswordHasher::SetConcurrencyLimit(config.hashConcurrency > 0 ? config.hashConcurrency : std::max(1u, std::thread::hardware_concurrency() / 2));
+    size_t count = std::max<size_t>(config.reactors, 1);
+    for (size_t i = 0; i < count; i++) {
+        reactors.push_back(std::make_unique<Reactor>(openListener(port), config.timerResolution));
+        Reactor* reactor = reactors.back().get();
+        reactor->presenceFlush.callback = [this, reactor]() { flushPresence(*reactor); };
+    }
+}
+
+/**
+ * @brief Destroy the Server object
+ * 
+ * Destroy the Server object and free any allocated resources.
+ * 
+ * @return void
+*/
+Server::~Server() {
+    // Stop the server
+    isRunning = false;
+    for (auto& reactor : reactors) {
+        reactor->runTasks(); // take in clients that were being handed over, so they are closed below
+    }
+    // Close all client sockets
+    for (auto& reactor : reactors) {
+        reactor->connections.forEach([&reactor](Connection& connection) {
+            reactor->loop.remove(connection.socket);
+            close(connection.socket);
+        });
+        reactor->connections.clear();
+    }
+}
+
+/**
+ * @brief Open a listening socket
+ * 
+ * Create a non-blocking socket listening on the port. SO_REUSEPORT lets every reactor bind its own socket to the same port, and the kernel spreads new connections over them.
+ * 
+ * @param port The port number to listen on
+ * 
+ * @return int The listening socket
+*/
+int Server::openListener(int port) {
     // Create a socket
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int serverSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0); // non-blocking so accepting never stalls the event loop
     if (serverSocket == -1) { // Check if the socket was created successfully
         std::cerr << "Failed to create socket." << std::endl;
         exit(EXIT_FAILURE);
     }
+    int reuse = 1;
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+        std::cerr << "Failed to share the port." << std::endl;
+        close(serverSocket);
+        exit(EXIT_FAILURE);
+    }
 
     // Server address
     sockaddr_in serverAddr{};
@@ -42,45 +95,227 @@ Server::Server(int port) : rsa(), isRunning(true) {
         close(serverSocket);
         exit(EXIT_FAILURE);
     }
-    if (listen(serverSocket, 10) < 0) {  // Listen for more connections
+    if (listen(serverSocket, SOMAXCONN) < 0) {  // Listen for more connections
         std::cerr << "Listening failed." << std::endl;
         close(serverSocket);
         exit(EXIT_FAILURE);
     }
+    return serverSocket;
 }
 
 /**
- * @brief Destroy the Server object
+ * @brief Run the server
  * 
- * Destroy the Server object and free any allocated resources.
+ * Start one thread per extra reactor and serve the first reactor on the calling thread. Each reactor accepts clients on its own listening socket, relays their messages and handles their deadlines. Returns once the server was stopped, or once every reactor finished draining after shutdown().
  * 
  * @return void
 */
-Server::~Server() {
-    // Stop the server
+void Server::run() {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < reactors.size(); i++) {
+        threads.emplace_back([this, i]() { runReactor(*reactors[i]); });
+    }
+    runReactor(*reactors[0]);
+    if (!draining) {
+        stop(); // the first reactor failed or the server was stopped, stop the others too
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
     isRunning = false;
-    // Close all threads
-    clientThreads.clear();
-    close(serverSocket);
 }
 
 /**
- * @brief Run the server
+ * @brief Shut the server down gracefully
  * 
- * Start the server and listen for incoming connections.
+ * Every reactor stops accepting (closing its listening socket, so a restarted server sharing the port gets the new clients), tells its clients the server is going away and closes each of them as soon as what is queued for it is written. Clients still not flushed when the drain timeout expires are closed anyway. run() returns once every reactor is done. The reactors are woken through their eventfd, so this takes effect at once even if they are idle.
  * 
  * @return void
 */
-void Server::run() {
-    while (isRunning) {
-        // Accept clients
-        int clientSocket1, clientSocket2;
-        // Wait for clients to connect
-        while (!waitForClients(clientSocket1));
-        while (!waitForClients(clientSocket2));
-        // Create a thread to handle the client pair and store it in the linked list
-        std::thread newThread(&Server::handlePair, this, clientSocket1, clientSocket2);
-        clientThreads.addThread(std::move(newThread));
+void Server::shutdown() {
+    if (draining.exchange(true)) {
+        return;
+    }
+    for (auto& reactor : reactors) {
+        Reactor* target = reactor.get();
+        target->post([this, target]() { drainReactor(*target); });
+    }
+}
+
+/**
+ * @brief Stop the server at once
+ * 
+ * Clear the running flag and wake every reactor so it sees it. run() returns and the destructor closes the clients without waiting for their output.
+ * 
+ * @return void
+*/
+void Server::stop() {
+    isRunning = false;
+    for (auto& reactor : reactors) {
+        reactor->post([]() {}); // wake the loop so it sees the flag
+    }
+}
+
+/**
+ * @brief Serve one reactor
+ * 
+ * Accept clients when the reactor's listening socket is readable and run its loop until the server stops.
+ * 
+ * @param reactor The reactor to serve
+ * 
+ * @return void
+*/
+void Server::runReactor(Reactor& reactor) {
+    reactor.loop.add(reactor.listenSocket, EPOLLIN, [this, &reactor](uint32_t) { acceptClient(reactor); });
+    reactor.run(isRunning);
+    reactor.loop.remove(reactor.listenSocket);
+}
+
+/**
+ * @brief Accept new clients
+ * 
+ * Accept every pending connection without blocking, register it with the reactor's event loop and start its handshake. The handshake itself is driven by readiness events, so a slow client never stops other clients from connecting.
+ * 
+ * @param reactor The reactor whose listening socket is readable
+ * 
+ * @return void
+*/
+void Server::acceptClient(Reactor& reactor) {
+    while (true) {
+        sockaddr_in clientAddr{};
+        socklen_t clientAddrLen = sizeof(clientAddr);
+        int clientSocket = accept4(reactor.listenSocket, (struct sockaddr*)&clientAddr, &clientAddrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSocket < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Error accepting client." << std::endl;
+            }
+            return;
+        }
+        // Successfully accepted a client
+        char address[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &clientAddr.sin_addr, address, sizeof(address));
+        std::cout << getFormattedCurrentTime() << ": Client connected from " << address << ":" << ntohs(clientAddr.sin_port) << std::endl;
+
+        auto connection = std::make_unique<Connection>(clientSocket, &reactor);
+        Connection* client = connection.get();
+        client->messageBucket = TokenBucket(config.messageRate, config.messageBurst);
+        client->byteBucket = TokenBucket(config.byteRate, config.byteBurst);
+        reactor.connections.insert(std::move(connection));
+        if (!watchClient(*client)) {
+            continue;
+        }
+        // The client must finish the handshake before the deadline
+        if (config.handshakeTimeout.count() > 0) {
+            reactor.timers.schedule(client->deadline, config.handshakeTimeout);
+        }
+        // Share the public key with the client, the rest of the handshake happens in verifyClient
+        client->nonce = SessionTicket::makeNonce(ThreadRng::get());
+        sendPublicKey(*client);
+    }
+}
+
+/**
+ * @brief Send the server's public key to a client
+ * 
+ * The message is built once, only the client's nonce is added to it.
+ * 
+ * @param client The client starting its handshake
+ * 
+ * @return void
+*/
+void Server::sendPublicKey(Connection& client) {
+    std::string message = publicKeyMessage;
+    message.pop_back(); // closing brace
+    message += ",\"nonce\":\"" + client.nonce + "\"}";
+    notifyClient(client, message);
+}
+
+/**
+ * @brief Watch a client
+ * 
+ * Register the client with the event loop of the reactor that owns it and point its deadlines at the server. Used for new clients and for clients handed over from another reactor. If the socket cannot be watched the client is closed.
+ * 
+ * @param client The client to watch
+ * 
+ * @return bool True if the client is watched, false if it was closed
+*/
+bool Server::watchClient(Connection& client) {
+    Connection* target = &client;
+    if (!client.reactor->loop.add(client.socket, EPOLLIN, [this, target](uint32_t events) { handleClientEvents(*target, events); })) {
+        std::cerr << "Error watching client socket." << std::endl;
+        close(client.socket);
+        client.reactor->connections.erase(client.handle);
+        return false;
+    }
+    client.deadline.callback = [this, target]() { handleDeadline(*target); };
+    client.writeDeadline.callback = [this, target]() { disconnectClient(*target); };
+    client.rateTimer.callback = [this, target]() { resumeClient(*target); };
+    return true;
+}
+
+/**
+ * @brief Start draining a reactor
+ * 
+ * @param reactor The reactor to drain (the calling thread's)
+ * 
+ * @return void
+*/
+void Server::drainReactor(Reactor& reactor) {
+    reactor.draining = true;
+    if (reactor.listenSocket != -1) {
+        reactor.loop.remove(reactor.listenSocket);
+        close(reactor.listenSocket);
+        reactor.listenSocket = -1;
+    }
+    std::vector<Connection*> clients;
+    reactor.connections.forEach([&clients](Connection& client) { clients.push_back(&client); });
+    for (Connection* client : clients) {
+        drainClient(*client);
+    }
+    if (config.drainTimeout.count() > 0) {
+        Reactor* target = &reactor;
+        reactor.drainDeadline.callback = [this, target]() {
+            std::vector<Connection*> left;
+            target->connections.forEach([&left](Connection& client) { left.push_back(&client); });
+            for (Connection* client : left) {
+                closeConnection(*client);
+            }
+            target->stop();
+        };
+        reactor.timers.schedule(reactor.drainDeadline, config.drainTimeout);
+    }
+    finishDrain(reactor);
+}
+
+/**
+ * @brief Say goodbye to a client of a draining reactor
+ * 
+ * The client is no longer read from. It is closed right away if everything sent to it was written, otherwise handleWritable closes it once its output queue is flushed.
+ * 
+ * @param client The client to close
+ * 
+ * @return void
+*/
+void Server::drainClient(Connection& client) {
+    notifyClient(client, json{{"type", "warning"}, {"message", "Server is going away, please reconnect later."}}.dump());
+    if (client.output.empty()) {
+        closeConnection(client);
+        return;
+    }
+    updateEvents(client); // stops reading
+}
+
+/**
+ * @brief Stop a draining reactor once it has no clients left
+ * 
+ * @param reactor The reactor (the calling thread's)
+ * 
+ * @return void
+*/
+void Server::finishDrain(Reactor& reactor) {
+    if (reactor.draining && reactor.connections.size() == 0) {
+        reactor.drainDeadline.cancel();
+        reactor.stop();
     }
 }
 
@@ -94,242 +329,1508 @@ void Server::run() {
 std::string Server::getFormattedCurrentTime() {
     auto now = std::chrono::system_clock::now();
     std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-    std::tm* local_time = std::localtime(&now_c);
+    std::tm local_time{};
+    localtime_r(&now_c, &local_time); // thread safe, reactors log concurrently
     std::stringstream ss;
-    ss << std::put_time(local_time, "%Y-%m-%d %H:%M:%S");
+    ss << std::put_time(&local_time, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
 /**
- * @brief Wait for clients to connect
+ * @brief Advance a client's handshake
  * 
- * Wait for clients to connect to the server and verify their identity.
+ * Verify the client's identity one message at a time: first the client's RSA public key, then the username and password it sends after being prompted. Each call handles one message and never waits for the next one, the credentials themselves are checked on the worker pool. A client may send a resumption ticket instead of its public key, which skips the rest.
  * 
- * @param clientSocket The socket to store the client connection
+ * @param client The client being verified
+ * @param message The message received from the client
  * 
- * @return bool True if the client was successfully accepted and verified, false otherwise
+ * @return bool True if the client is still connected, false if it was rejected and closed
 */
-bool Server::waitForClients(int& clientSocket) {
-    sockaddr_in clientAddr{};
-    // Accept a client
-    socklen_t clientAddrLen = sizeof(clientAddr);
-    clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
-    if (clientSocket < 0) {
-        std::cerr << "Error accepting client." << std::endl;
-        return false;
+bool Server::verifyClient(Connection& client, const std::string& message) {
+    if (client.state == Connection::State::AwaitingPublicKey) {
+        json request = json::parse(message, nullptr, false);
+        if (request.is_object() && request.value("type", json()) == "resume") {
+            return resumeSession(client, request);
+        }
+        // Read the client's public key, a short one could not even carry the ticket's secret
+        std::string pub = message;
+        if (!RSAWrapper::receivePublicKey(pub, client.publicKey) || client.publicKey.GetModulus().BitCount() < MIN_CLIENT_KEY_BITS) {
+            std::cerr << "Error reading client's public key." << std::endl;
+            notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Invalid request."}}.dump());
+            closeConnection(client);
+            return false;
+        }
+        // Prompt the client to send their username and password, accepting binary framing if the client asked for it
+        bool binary = config.binaryFraming && request.is_object() && request.value("framing", json()) == "binary";
+        client.state = Connection::State::AwaitingCredentials;
+        if (binary) {
+            notifyClient(client, json{{"type", "prompt"}, {"framing", "binary"}}.dump());
+            client.binaryFraming = true; // everything after the prompt is framed
+        } else {
+            notifyClient(client, json{{"type", "prompt"}}.dump());
+        }
+        return true;
     }
-    // Successfully accepted a client
-    std::cout << getFormattedCurrentTime() << ": Client connected from " << inet_ntoa(clientAddr.sin_addr) << ":" << ntohs(clientAddr.sin_port) << std::endl;
-    // Verify the client
-    if (!verifyClient(clientSocket)) {
+
+    // Check the credentials off the reactor, the verdict comes back through finishAuthentication
+    json j = json::parse(message, nullptr, false); // no exceptions, discarded on invalid input
+    json type = j.is_object() ? j.value("type", json()) : json(); // not necessarily a string
+    if (type != "create" && type != "verify") {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Invalid request."}}.dump());
+        closeConnection(client);
         return false;
     }
-    // Send a welcome message to the client
-    notifyClient(clientSocket, json{{"type", "success"},{"message", "Welcome!"}}.dump());
-    return true;
+    return authenticate(client, type == "create", message);
 }
 
 /**
- * @brief Verify the client's identity
+ * @brief Hand a client's credentials to the worker pool
+ * 
+ * RSA decryption and password hashing are the most expensive steps of a login, so they run on the worker pool instead of the reactor. The worker also issues the client's resumption ticket, encrypting its secret with the client's public key. The client's reads are paused until the worker posts its verdict back to the client's reactor. If too many logins are already waiting, the client is turned away.
  * 
- * Verify the client's identity by exchanging RSA public keys and prompting the client to send their username and password.
+ * Passwords of existing users are checked by the verify batcher, together with those of the other logins in progress.
  * 
- * @param clientSocket The client socket to verify
+ * @param client The client that sent its credentials
+ * @param create True to create a new user, false to verify an existing one
+ * @param message The credentials message
  * 
- * @return bool True if the client was successfully verified, false otherwise
+ * @return bool True if the client is still connected, false if it was turned away and closed
 */
-bool Server::verifyClient(int clientSocket){
-    // Share the public key with the client
-    std::string publicKey = RSAWrapper::sendPublicKey(rsa.getPublicKey());
-    notifyClient(clientSocket, publicKey);
-    // Wait for the client to send their public key
-    char buffer[1024] = {0};
-    ssize_t len = read(clientSocket, buffer, sizeof(buffer) - 1);
-    if (len == 0) {
-        std::cerr << "Error reading client's public key." << std::endl;
-    }
-    // Successfully read the client's public key
-    std::string pub(buffer, len);
-    RSAWrapper::receivePublicKey(pub, rsa.publicKeyB);
-    // Prompt the client to send their username and password
-    notifyClient(clientSocket, json{{"type", "prompt"}}.dump());
-    // Read user response
-    char buffer2[1024] = {0};
-    int len2 = read(clientSocket, buffer2, sizeof(buffer2) - 1);
-    if (len2 == 0) {
-        std::cerr << "Error reading client's credentials." << std::endl;
+bool Server::authenticate(Connection& client, bool create, const std::string& message) {
+    ConnectionRef ref{client.reactor, client.handle};
+    bool queued = workers.submit([this, ref, create, message, publicKey = client.publicKey]() {
+        bool success = false;
+        std::string username, password, saltedHash;
+        try {
+            if (create) {
+                success = createUser(message, username);
+            } else if (readCredentials(message, username, password, saltedHash)) {
+                // The password is checked with those of the other logins waiting, the verdict may be reported by another worker
+                verifier.verify(std::move(password), std::move(saltedHash), [this, ref, username, publicKey](bool verified) {
+                    reportAuthentication(ref, Login::Verify, verified, username, publicKey);
+                });
+                return;
+            }
+        } catch (const nlohmann::json::exception& e) {
+            // malformed credentials (e.g. a username that is not a string), rejected
+        }
+        reportAuthentication(ref, create ? Login::Create : Login::Verify, success, username, publicKey);
+    });
+    if (!queued) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Server is busy, try again later."}}.dump());
+        closeConnection(client);
         return false;
     }
+    client.state = Connection::State::Authenticating;
+    client.readPaused = true;
+    updateEvents(client);
+    return true;
+}
 
-    // Attempt to create or verify the user
-    std::string user(buffer2, len2);
-    auto j = json::parse(user);
-    if (j["type"] == "create") {
-        if (createUser(user)) {
-            notifyClient(clientSocket, json{{"type", "success"},{"message", "User created successfully."}}.dump());
-        } else {
-            notifyClient(clientSocket, json{{"type", "error"},{"status", "error"}, {"message", "User already exists."}}.dump());
-            close(clientSocket);
-            return false;
-        }
-    } else if (j["type"] == "verify") {
-        if (verifyUser(user)) {
-            notifyClient(clientSocket, json{{"type", "success"},{"message", "User verified successfully."}}.dump());
-        } else {
-            notifyClient(clientSocket, json{{"type", "error"},{"status", "error"}, {"message", "Invalid credentials."}}.dump());
-            close(clientSocket);
-            return false;
+/**
+ * @brief Report a login's verdict to the client's reactor
+ * 
+ * A client that logged in is also issued its resumption ticket, its secret encrypted with the client's public key. If that fails, the client is let in without a ticket. Runs on a worker (or in a verify batcher callback), so nothing may throw from here.
+ * 
+ * @param ref The client
+ * @param login How the client logged in
+ * @param success True if the credentials were accepted
+ * @param username The client's username
+ * @param publicKey The client's public key
+ * 
+ * @return void
+*/
+void Server::reportAuthentication(ConnectionRef ref, Login login, bool success, const std::string& username, const CryptoPP::RSA::PublicKey& publicKey) {
+    std::string ticket;
+    if (success && tickets.lifetime().count() > 0) {
+        try {
+            SessionTicket::Issued issued = tickets.issue(username);
+            ticket = json{{"type", "ticket"}, {"ticket", issued.ticket}, {"secret", rsa.encrypt(issued.secret, publicKey)},
+                {"lifetime", tickets.lifetime().count()}}.dump();
+        } catch (const CryptoPP::Exception& e) {
+            ticket.clear(); // the client's key cannot carry the secret, it logs in without a ticket
         }
+    }
+    ref.reactor->post([this, ref, login, success, username, ticket]() { finishAuthentication(ref, login, success, username, ticket); });
+}
+
+/**
+ * @brief Log a client in with a resumption ticket
+ * 
+ * The ticket and the client's answer to its nonce are checked right on the reactor, it only takes a few HMACs. An accepted client skips the credentials: it is told at once (switching to binary framing if it asked for it) and finishes logging in like a client whose password was checked, from the reactor's task queue so the messages it already sent are handled in order. A rejected client is told so and sent the public key again, to log in with its password.
+ * 
+ * @param client The client that sent the ticket
+ * @param request The resume request
+ * 
+ * @return bool True (the client stays connected either way)
+*/
+bool Server::resumeSession(Connection& client, const json& request) {
+    std::string username;
+    bool accepted = false;
+    bool binary = false;
+    try {
+        accepted = tickets.redeem(request.value("ticket", ""), client.nonce, request.value("proof", ""), username);
+        binary = config.binaryFraming && request.value("framing", "") == "binary";
+    } catch (const json::exception& e) {
+        // a field that is not a string, rejected
+    }
+    if (!accepted) {
+        notifyClient(client, json{{"type", "resume_failed"}, {"message", "Session expired, please log in again."}}.dump());
+        sendPublicKey(client);
+        return true;
+    }
+    if (binary) {
+        notifyClient(client, json{{"type", "resumed"}, {"framing", "binary"}}.dump());
+        client.binaryFraming = true; // everything after this reply is framed
     } else {
-        notifyClient(clientSocket, json{{"type", "error"},{"status", "error"}, {"message", "Invalid request."}}.dump());
-        close(clientSocket);
-        return false;
+        notifyClient(client, json{{"type", "resumed"}}.dump());
     }
+    ConnectionRef ref{client.reactor, client.handle};
+    client.state = Connection::State::Authenticating;
+    client.readPaused = true;
+    updateEvents(client);
+    client.reactor->post([this, ref, username]() { finishAuthentication(ref, Login::Resume, true, username, ""); });
     return true;
 }
 
+/**
+ * @brief Act on a worker's verdict
+ * 
+ * Runs on the client's reactor once its credentials (or ticket) were checked. A rejected client is told why and closed. An accepted client is sent its resumption ticket (after a password login), welcomed, handed the messages kept for it while it was offline, shown as online to the users watching it, its reads resume (handling anything it sent meanwhile) and it is paired.
+ * 
+ * @param ref The client whose credentials were checked
+ * @param login How the client logged in
+ * @param success The worker's verdict
+ * @param username The user the client logged in as
+ * @param ticket The resumption ticket message to send the client, empty if none was issued
+ * 
+ * @return void
+*/
+void Server::finishAuthentication(ConnectionRef ref, Login login, bool success, const std::string& username, const std::string& ticket) {
+    Connection* found = ref.reactor->connections.get(ref.handle);
+    if (found == nullptr) {
+        return; // the client left (or timed out) while its credentials were checked
+    }
+    Connection& client = *found;
+    if (!success) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", login == Login::Create ? "User already exists." : "Invalid credentials."}}.dump());
+        closeConnection(client);
+        return;
+    }
+    const char* status = login == Login::Create ? "User created successfully." : login == Login::Verify ? "User verified successfully." : "Session resumed.";
+    notifyClient(client, json{{"type", "success"},{"message", status}}.dump());
+    if (!ticket.empty()) {
+        notifyClient(client, ticket);
+    }
+
+    // Send a welcome message to the client and pair it
+    client.state = Connection::State::Verified;
+    client.username = username;
+    publishPresence(username, presence.setOnline(username, PresenceIndex::Session{client.reactor, client.handle}), true);
+    client.deadline.cancel();
+    if (config.idleTimeout.count() > 0) {
+        client.reactor->timers.schedule(client.deadline, config.idleTimeout);
+    }
+    notifyClient(client, json{{"type", "success"},{"message", "Welcome!"}}.dump());
+    deliverStored(client);
+    client.readPaused = false;
+    updateEvents(client);
+    if (!processBuffered(client)) {
+        return; // the client was closed, or moved to another reactor
+    }
+    if (client.room == nullptr && !client.lobbyTicket) {
+        enterLobby(client); // unless a command sent along with the credentials already put it in a room (or chat)
+    }
+}
 
 /**
- * @brief Handle a pair of clients
+ * @brief Queue a verified client for a partner
  * 
- * Handle a pair of clients by creating a chat session between them.
+ * Put the client in the lobby, giving up the place it may already hold, then make every pair that is ready. The pairs are not necessarily this client's: any reactor may pair any two waiting clients, each pair is started by the reactor of its joining client.
  * 
- * @param clientSocket1 The first client socket
- * @param clientSocket2 The second client socket
+ * @param client The client looking for a partner
  * 
  * @return void
 */
-void Server::handlePair(int clientSocket1, int clientSocket2) {
-    notifyClient(clientSocket1, json{{"type", "connected"},{"message", "You are now chatting!"}}.dump());
-    notifyClient(clientSocket2, json{{"type", "info"},{"message", "You are now chatting!"}}.dump());
-    // Create a thread to handle the chat
-    fd_set readfds;
-    // Set of socket descriptors
-    int max_sd;
-    bool disconnected = false;
+void Server::enterLobby(Connection& client) {
+    if (draining) {
+        return; // the client is closed by the drain
+    }
+    if (client.lobbyTicket) {
+        lobby.leave(client.lobbyTicket); // a client queued twice could be matched with itself
+        client.lobbyTicket.reset();
+    }
+    client.lobbyTicket = lobby.enter(client.reactor, client.handle);
+    if (!client.lobbyTicket) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Server is busy, try again later."}}.dump());
+        closeConnection(client);
+        return;
+    }
+    Lobby::Match match;
+    while (lobby.match(match)) {
+        pairClients(ConnectionRef{match.waiting.reactor, match.waiting.handle}, ConnectionRef{match.joining.reactor, match.joining.handle});
+    }
+}
 
-    while (isRunning) {
-        if (disconnected) { // Check if a client disconnected
+/**
+ * @brief Start a chat between two clients taken from the lobby
+ * 
+ * Runs on the joining client's reactor: the pair is started there if both clients share it, otherwise the joining client is handed over to the waiting client's reactor. A client whose partner left before the pair was started goes back to the lobby.
+ * 
+ * @param waiting The client that waited longer
+ * @param joining Its partner
+ * 
+ * @return void
+*/
+void Server::pairClients(ConnectionRef waiting, ConnectionRef joining) {
+    joining.reactor->post([this, waiting, joining]() {
+        Connection* client = joining.reactor->connections.get(joining.handle);
+        if (client == nullptr || client->room != nullptr) {
+            waiting.reactor->post([this, waiting]() { requeueClient(waiting); });
             return;
         }
-        // Clear the socket set
-        FD_ZERO(&readfds);
+        client->lobbyTicket.reset();
+        if (waiting.reactor != joining.reactor) {
+            migrateClient(*client, *waiting.reactor, [this, waiting](Connection& moved) { pairWith(moved, waiting); });
+            return;
+        }
+        pairWith(*client, waiting);
+    });
+}
 
-        // Add client sockets to set
-        FD_SET(clientSocket1, &readfds);
-        FD_SET(clientSocket2, &readfds);
-        // Find the maximum socket descriptor
-        max_sd = (clientSocket1 > clientSocket2) ? clientSocket1 : clientSocket2;
+/**
+ * @brief Put a matched client back in the lobby
+ * 
+ * Runs on the client's reactor when the partner it was matched with left before the chat started.
+ * 
+ * @param ref The client to put back
+ * 
+ * @return void
+*/
+void Server::requeueClient(ConnectionRef ref) {
+    Connection* client = ref.reactor->connections.get(ref.handle);
+    if (client != nullptr && client->room == nullptr) {
+        enterLobby(*client);
+    }
+}
 
-        // Wait for activity on any of the sockets
-        int activity = select(max_sd + 1, &readfds, NULL, NULL, NULL);
+/**
+ * @brief Pair a client with a waiting client of the same reactor
+ * 
+ * If the waiting client left, or joined a room, in the meantime, the client goes back to the lobby.
+ * 
+ * @param client The joining client
+ * @param partner The waiting client
+ * 
+ * @return void
+*/
+void Server::pairWith(Connection& client, ConnectionRef partner) {
+    Connection* first = client.reactor->connections.get(partner.handle);
+    if (first == nullptr || first->room != nullptr) {
+        enterLobby(client);
+        return;
+    }
+    startSession(*first, client);
+}
 
-        // Check for errors
-        if ((activity < 0) && (errno != EINTR)) { // Disconnect if there is an error
-            disconnected = true;
+/**
+ * @brief Hand a client over to another reactor
+ * 
+ * Detach the client from its reactor (event loop, timers and ownership) and post it to the target reactor, which takes it over and continues with it. Only the client's socket and state move, no data is copied, except for the messages that followed the one being handled (if the client is moved by one of its own commands): those were not handled yet and go along in its input buffer. The client must not be in a room, and must not be touched by this reactor afterwards.
+ * 
+ * @param client The client to move
+ * @param target The reactor to move it to
+ * @param resume What to do with the client once the target reactor owns it
+ * 
+ * @return void
+*/
+void Server::migrateClient(Connection& client, Reactor& target, std::function<void(Connection&)> resume) {
+    Reactor& source = *client.reactor;
+    if (client.unhandled.data() != nullptr) {
+        if (client.input.empty()) {
+            client.input.append(client.unhandled.data(), client.unhandled.size()); // still in the reactor's read buffer
+        } else {
+            client.input.consume(client.input.size() - client.unhandled.size()); // being handled from the input buffer itself
         }
-
-        processClientMessage(clientSocket1, clientSocket2, readfds);
-        processClientMessage(clientSocket2, clientSocket1, readfds);
+        client.unhandled = std::string_view();
     }
+    client.deadline.cancel();
+    client.writeDeadline.cancel();
+    client.rateTimer.cancel();
+    source.loop.remove(client.socket);
+    source.queuedBytes -= client.output.size();
+    ConnectionRef from{&source, client.handle};
+    Connection* moved = source.connections.release(client.handle).release();
+    Reactor* reactor = &target;
+    reactor->post([this, reactor, moved, from, resume = std::move(resume)]() { adoptClient(*reactor, moved, from, resume); });
 }
 
 /**
- * @brief Process a message from a client
+ * @brief Take over a client handed over by another reactor
  * 
- * Process a message from a client by reading the message and sending it to the target client.
+ * Watch the client on its new reactor, restart its deadlines, point the presence index at its new handle and continue with it. The messages it brought along are handled after that, in the order they were sent.
  * 
- * @param sourceSock The source client socket
- * @param targetSock The target client socket
- * @param readfds The set of socket descriptors
+ * @param reactor The reactor taking the client over (the calling thread's)
+ * @param client The migrated client (ownership is taken)
+ * @param from Where the client was before the move
+ * @param resume What to do with the client now
  * 
  * @return void
 */
-void Server::processClientMessage(int sourceSock, int targetSock, fd_set &readfds) {
-    // Check if the source socket is set
-    if (FD_ISSET(sourceSock, &readfds)) {
-        char buffer[1024] = {0};
-        ssize_t bytesRead = read(sourceSock, buffer, sizeof(buffer) - 1);
-        if (bytesRead == 0) { // Check if the client disconnected
-            notifyClient(targetSock, json{{"type", "error"},{"status", "error"}, {"message", "The other user disconnected."}}.dump());
-            close(sourceSock);
-            close(targetSock);
-            return;
-        } else if (bytesRead > 0) { // Check if the message is valid
-            try {
-                json msg = json::parse(std::string(buffer, bytesRead));
-                notifyClient(targetSock, msg.dump());
-            } catch (const json::parse_error& e) {
-                notifyClient(sourceSock, json{{"type", "error"},{"status", "error"}, {"message", "Invalid JSON format."}}.dump());
-            }
+void Server::adoptClient(Reactor& reactor, Connection* client, ConnectionRef from, const std::function<void(Connection&)>& resume) {
+    client->reactor = &reactor;
+    reactor.connections.insert(std::unique_ptr<Connection>(client));
+    PresenceIndex::Session before{from.reactor, from.handle};
+    PresenceIndex::Session after{&reactor, client->handle};
+    if (!client->username.empty()) {
+        presence.relocate(client->username, before, after);
+    }
+    for (const std::string& user : client->watching) {
+        presence.relocateWatcher(user, before, after);
+    }
+    if (!client->presenceUpdates.empty()) {
+        std::vector<std::pair<std::string, bool>> updates;
+        updates.swap(client->presenceUpdates); // were waiting for the old reactor's flush
+        for (const auto& update : updates) {
+            queuePresence(*client, update.first, update.second);
         }
     }
+    if (!watchClient(*client)) {
+        return;
+    }
+    reactor.queuedBytes += client->output.size();
+    updateEvents(*client);
+    if (config.idleTimeout.count() > 0) {
+        reactor.timers.schedule(client->deadline, config.idleTimeout);
+    }
+    if (!client->output.empty() && config.writeStallTimeout.count() > 0) {
+        reactor.timers.schedule(client->writeDeadline, config.writeStallTimeout);
+    }
+    if (reactor.draining) {
+        drainClient(*client); // arrived too late
+        return;
+    }
+    if (client->rateLimited) {
+        delayClient(*client); // restart its timer here
+    }
+    SessionRegistry::Handle handle = client->handle;
+    resume(*client);
+    Connection* adopted = reactor.connections.get(handle);
+    if (adopted != nullptr && !adopted->rateLimited) {
+        processBuffered(*adopted); // a delayed client's are handled when its rate timer fires
+    }
 }
 
 /**
- * @brief Notify a client
+ * @brief Start a chat session between two clients
  * 
- * Notify a client of any information by sending a JSON message.
+ * Put the two clients in a new room of their own and tell both they are now chatting. The first client is told to start the key exchange.
  * 
- * @param clientSocket The client socket to notify
- * @param jsonMessage The JSON message to send
+ * @param first The client that was waiting
+ * @param second The client that just joined
  * 
  * @return void
 */
-void Server::notifyClient(int clientSocket, const std::string &jsonMessage) {
-    std::string msg = jsonMessage + "\n";
-    send(clientSocket, msg.c_str(), msg.size(), 0);
+void Server::startSession(Connection& first, Connection& second) {
+    first.lobbyTicket.reset();
+    second.lobbyTicket.reset();
+    auto room = std::make_shared<Room>();
+    room->add(first);
+    room->add(second);
+    first.room = room;
+    second.room = room;
+    notifyClient(first, json{{"type", "connected"},{"message", "You are now chatting!"}}.dump());
+    notifyClient(second, json{{"type", "info"},{"message", "You are now chatting!"}}.dump());
 }
 
 /**
- * @brief Create a new user
+ * @brief Run a command sent to the server
  * 
- * Create a new user by reading the username and password from a JSON message and adding the user to the users file.
+ * Commands arrive in control frames, so they are never mistaken for (or relayed as) chat messages:
+ * - {"type":"join","room":"name"} moves the client to a named room
+ * - {"type":"leave"} takes it out of its room and back to the lobby
+ * - {"type":"chat","user":"name"} starts a chat with a user waiting for a partner
+ * - {"type":"watch","users":["name", ...]} reports the presence of users, now and whenever it changes
+ * - {"type":"message","user":"name","message":...} sends a message to a user, online or not
  * 
- * @param user The JSON message containing the username and password
+ * @param client The client that sent the command
+ * @param data The command
+ * @param size The size of the command
  * 
- * @return bool True if the user was successfully created, false otherwise
+ * @return void
 */
-bool Server::createUser(std::string& user) {
-    // Read user message
-    auto j = json::parse(user);
-    std::string username = j["username"];
-    std::string password = j["password"];
-
-    // Decrypt the username and password
-    username = this->rsa.decrypt(username);
-    password = this->rsa.decrypt(password);
-
-    // Add the user to the users file using the user handler
-    UserHandler userHandler("assets/users.txt");
-    if (userHandler.AddUser(username, password)) {
-        return true;
+void Server::handleControl(Connection& client, const char* data, size_t size) {
+    try {
+        json command = json::parse(data, data + size);
+        std::string type = command.value("type", "");
+        if (type == "join") {
+            std::string name = command.value("room", "");
+            if (name.empty() || name.size() > MAX_ROOM_NAME) {
+                notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Invalid room name."}}.dump());
+                return;
+            }
+            enterRoom(client, name);
+        } else if (type == "leave") {
+            if (client.room == nullptr) {
+                return; // already waiting in the lobby
+            }
+            std::shared_ptr<Room> room = leaveRoom(client);
+            roomDeparture(*room);
+            enterLobby(client);
+        } else if (type == "chat") {
+            openChat(client, command.value("user", ""));
+        } else if (type == "watch") {
+            watchUsers(client, command.value("users", json::array()));
+        } else if (type == "message") {
+            messageUser(client, command.value("user", ""), command.value("message", json()));
+        } else {
+            notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Unknown command."}}.dump());
+        }
+    } catch (const json::exception& e) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Invalid command."}}.dump());
     }
-    return false;
 }
 
 /**
- * @brief Verify a user
+ * @brief Send a client to a named room
  * 
- * Verify a user by reading the username and password from a JSON message and checking if the user exists in the users file.
+ * The client leaves the lobby or its current room first. Every room name is hosted by one reactor, chosen by hashing the name, so a client on another reactor is handed over to it.
  * 
- * @param user The JSON message containing the username and password
+ * @param client The client joining the room
+ * @param name The room name
  * 
- * @return bool True if the user was successfully verified, false otherwise
+ * @return void
 */
-bool Server::verifyUser(std::string& user) {
-    auto j = json::parse(user);
-    std::string username = j["username"];
-    std::string password = j["password"];
-    // Decrypt credentials received from the client
-    username = this->rsa.decrypt(username);
-    password = this->rsa.decrypt(password);
+void Server::enterRoom(Connection& client, const std::string& name) {
+    if (client.lobbyTicket) {
+        lobby.leave(client.lobbyTicket);
+        client.lobbyTicket.reset();
+    }
+    if (client.room != nullptr) {
+        if (client.room->name() == name) {
+            return;
+        }
+        std::shared_ptr<Room> room = leaveRoom(client);
+        roomDeparture(*room);
+    }
+    Reactor& home = *reactors[std::hash<std::string>()(name) % reactors.size()];
+    if (&home == client.reactor) {
+        joinRoom(client, name);
+        return;
+    }
+    migrateClient(client, home, [this, name](Connection& moved) { joinRoom(moved, name); });
+}
 
-    // Verify the user using the user handler
-    UserHandler userHandler("assets/users.txt");
-    if (userHandler.VerifyUser(username, password)) {
-        return true;
-    } else {
-        return false;
+/**
+ * @brief Add a client to a named room of its reactor
+ * 
+ * The room is created by its first member. The members already there are told someone joined.
+ * 
+ * @param client The client joining the room
+ * @param name The room name
+ * 
+ * @return void
+*/
+void Server::joinRoom(Connection& client, const std::string& name) {
+    std::shared_ptr<Room> room = client.reactor->rooms[name].lock();
+    if (!room) {
+        room = std::make_shared<Room>(name);
+        client.reactor->rooms[name] = room;
     }
+    std::string joined = json{{"type", "info"},{"message", "A user joined the room."}}.dump();
+    for (Connection* member : room->members()) {
+        notifyClient(*member, joined);
+    }
+    room->add(client);
+    client.room = room;
+    notifyClient(client, json{{"type", "info"},{"message", "You joined room " + name + " (" + std::to_string(room->size()) + " users)."}}.dump());
+}
+
+/**
+ * @brief Take a client out of its room
+ * 
+ * If the client was the reason the room was congested, the members paused for it are read again. A named room is forgotten by its reactor once its last member left.
+ * 
+ * @param client The client leaving (must be in a room)
+ * 
+ * @return std::shared_ptr<Room> The room the client left
+*/
+std::shared_ptr<Room> Server::leaveRoom(Connection& client) {
+    std::shared_ptr<Room> room = std::move(client.room);
+    room->remove(client);
+    if (client.readPaused) {
+        client.readPaused = false;
+        updateEvents(client);
+    }
+    if (client.congested) {
+        client.congested = false;
+        if (--room->congested == 0) {
+            resumeRoom(*room);
+        }
+    }
+    if (room->size() == 0 && !room->isPair()) {
+        client.reactor->rooms.erase(room->name());
+    }
+    return room;
+}
+
+/**
+ * @brief Handle a member leaving a room
+ * 
+ * The members of a named room are told and keep chatting. The member left alone in a pair is told and goes back to the lobby to find a new partner.
+ * 
+ * @param room The room someone left
+ * 
+ * @return void
+*/
+void Server::roomDeparture(Room& room) {
+    if (room.isPair()) {
+        if (room.size() == 0) {
+            return;
+        }
+        Connection& survivor = *room.members().front();
+        leaveRoom(survivor);
+        notifyClient(survivor, json{{"type", "warning"}, {"message", "The other user disconnected, waiting for a new partner."}}.dump());
+        enterLobby(survivor);
+        return;
+    }
+    std::string left = json{{"type", "info"},{"message", "A user left the room."}}.dump();
+    for (Connection* member : room.members()) {
+        notifyClient(*member, left);
+    }
+}
+
+/**
+ * @brief Resume reading from the members of a room
+ * 
+ * Called when the last congested member of the room drained its output queue.
+ * 
+ * @param room The room that is no longer congested
+ * 
+ * @return void
+*/
+void Server::resumeRoom(Room& room) {
+    for (Connection* member : room.members()) {
+        if (member->readPaused) {
+            member->readPaused = false;
+            updateEvents(*member);
+        }
+    }
+}
+
+/**
+ * @brief Send a message to the rest of a room
+ * 
+ * Every other member gets the message from one SharedFrame: it is written straight from the read buffer where the socket takes it, and the members that queue it share one copy. Receiving a message keeps a member's session alive. If a member's queue goes over the high watermark the room is congested and the sender's reads are paused until it drains.
+ * 
+ * @param source The member that sent the message
+ * @param data The message
+ * @param size The size of the message
+ * 
+ * @return void
+*/
+void Server::broadcast(Connection& source, const char* data, size_t size) {
+    Room& room = *source.room;
+    SharedFrame message(data, size);
+    for (Connection* member : room.members()) {
+        if (member == &source) {
+            continue;
+        }
+        sendFrame(*member, message);
+        if (config.idleTimeout.count() > 0) {
+            source.reactor->timers.schedule(member->deadline, config.idleTimeout);
+        }
+        if (!member->congested && member->output.size() > config.outputHighWatermark) {
+            member->congested = true;
+            room.congested++;
+        }
+    }
+    // Stop reading from a sender while a member is not keeping up, resumed by handleWritable
+    if (room.congested > 0 && !source.readPaused) {
+        source.readPaused = true;
+        updateEvents(source);
+    }
+}
+
+/**
+ * @brief Start a chat with a user by name
+ * 
+ * The user is found through the presence index in O(1). Only a user waiting in the lobby can be invited: its reactor takes it out of the lobby, then the requester leaves its own chat and is brought over.
+ * 
+ * @param client The client asking for the chat
+ * @param user The user to chat with
+ * 
+ * @return void
+*/
+void Server::openChat(Connection& client, const std::string& user) {
+    PresenceIndex::Session target;
+    if (user.empty() || user == client.username || !presence.find(user, target)) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "User is not online."}}.dump());
+        return;
+    }
+    ConnectionRef requester{client.reactor, client.handle};
+    ConnectionRef invited{target.reactor, target.handle};
+    invited.reactor->post([this, invited, requester]() { inviteClient(invited, requester); });
+}
+
+/**
+ * @brief Take an invited client out of the lobby
+ * 
+ * Runs on the invited client's reactor. A client that is chatting, or was just matched by the lobby, is busy and the requester is told so.
+ * 
+ * @param target The invited client
+ * @param requester The client that asked for the chat
+ * 
+ * @return void
+*/
+void Server::inviteClient(ConnectionRef target, ConnectionRef requester) {
+    Connection* invited = target.reactor->connections.get(target.handle);
+    if (invited == nullptr || invited->room != nullptr || !invited->lobbyTicket || !lobby.leave(invited->lobbyTicket)) {
+        requester.reactor->post([this, requester]() {
+            Connection* client = requester.reactor->connections.get(requester.handle);
+            if (client != nullptr) {
+                notifyClient(*client, json{{"type", "error"},{"status", "error"}, {"message", "User is busy."}}.dump());
+            }
+        });
+        return;
+    }
+    invited->lobbyTicket.reset();
+    requester.reactor->post([this, requester, target]() { startDirectChat(requester, target); });
+}
+
+/**
+ * @brief Pair a requester with the client it invited
+ * 
+ * Runs on the requester's reactor once the invited client left the lobby. The requester leaves the lobby or its chat, then is paired on the invited client's reactor. If the requester is gone, the invited client goes back to the lobby.
+ * 
+ * @param requester The client that asked for the chat
+ * @param target The invited client
+ * 
+ * @return void
+*/
+void Server::startDirectChat(ConnectionRef requester, ConnectionRef target) {
+    Connection* client = requester.reactor->connections.get(requester.handle);
+    if (client == nullptr) {
+        target.reactor->post([this, target]() { requeueClient(target); });
+        return;
+    }
+    if (client->lobbyTicket) {
+        lobby.leave(client->lobbyTicket);
+        client->lobbyTicket.reset();
+    }
+    if (client->room != nullptr) {
+        std::shared_ptr<Room> room = leaveRoom(*client);
+        roomDeparture(*room);
+    }
+    if (target.reactor == client->reactor) {
+        pairWith(*client, target);
+        return;
+    }
+    migrateClient(*client, *target.reactor, [this, target](Connection& moved) { pairWith(moved, target); });
+}
+
+/**
+ * @brief Send a message to a user
+ * 
+ * The message is wrapped (with the sender and the time) once, here. A logged in user gets it right away on its reactor, otherwise it is kept in the offline store and sent when the user logs in. The server does not read the message, so clients may encrypt it however they like.
+ * 
+ * @param client The sender
+ * @param user The recipient
+ * @param message The message
+ * 
+ * @return void
+*/
+void Server::messageUser(Connection& client, const std::string& user, const json& message) {
+    if (user.empty() || message.is_null()) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Invalid command."}}.dump());
+        return;
+    }
+    ConnectionRef sender{client.reactor, client.handle};
+    std::string wrapped = json{{"type", "message"}, {"from", client.username}, {"time", getFormattedCurrentTime()}, {"message", message}}.dump();
+    PresenceIndex::Session target;
+    if (!presence.find(user, target)) {
+        storeMessage(sender, user, wrapped);
+        return;
+    }
+    ConnectionRef recipient{target.reactor, target.handle};
+    recipient.reactor->post([this, recipient, sender, user, wrapped]() {
+        Connection* found = recipient.reactor->connections.get(recipient.handle);
+        if (found == nullptr) {
+            storeMessage(sender, user, wrapped); // logged out meanwhile
+            return;
+        }
+        notifyClient(*found, wrapped);
+    });
+}
+
+/**
+ * @brief Keep a message for a logged out user
+ * 
+ * Writing to the store may wait for the disk, so it runs on the worker pool along with the check that the user exists. If the user logged in while the message was written, its reactor is asked to deliver it. The sender is told the outcome.
+ * 
+ * @param sender The client that sent the message
+ * @param user The recipient
+ * @param message The wrapped message
+ * 
+ * @return void
+*/
+void Server::storeMessage(ConnectionRef sender, const std::string& user, const std::string& message) {
+    bool queued = workers.submit([this, sender, user, message]() {
+        if (!users.HasUser(user)) {
+            notifyRemote(sender, json{{"type", "error"},{"status", "error"}, {"message", "Unknown user."}}.dump());
+            return;
+        }
+        if (!offline.append(user, message.data(), message.size())) {
+            notifyRemote(sender, json{{"type", "error"},{"status", "error"}, {"message", "User's mailbox is full."}}.dump());
+            return;
+        }
+        notifyRemote(sender, json{{"type", "info"}, {"message", "User is offline, the message will be delivered when they log in."}}.dump());
+        PresenceIndex::Session target;
+        if (presence.find(user, target)) {
+            ConnectionRef recipient{target.reactor, target.handle};
+            recipient.reactor->post([this, recipient]() {
+                Connection* found = recipient.reactor->connections.get(recipient.handle);
+                if (found != nullptr) {
+                    deliverStored(*found);
+                }
+            });
+        }
+    });
+    if (!queued) {
+        notifyRemote(sender, json{{"type", "error"},{"status", "error"}, {"message", "Server is busy, try again later."}}.dump());
+    }
+}
+
+/**
+ * @brief Send a client the messages kept for it
+ * 
+ * The messages are written to the socket straight from the store's mapping.
+ * 
+ * @param client The client that logged in
+ * 
+ * @return void
+*/
+void Server::deliverStored(Connection& client) {
+    for (const OfflineStore::Message& message : offline.take(client.username)) {
+        sendFrame(client, message.data, message.size);
+    }
+}
+
+/**
+ * @brief Notify a client owned by any reactor
+ * 
+ * @param ref The client
+ * @param message The JSON message to send
+ * 
+ * @return void
+*/
+void Server::notifyRemote(ConnectionRef ref, const std::string& message) {
+    ref.reactor->post([this, ref, message]() {
+        Connection* client = ref.reactor->connections.get(ref.handle);
+        if (client != nullptr) {
+            notifyClient(*client, message);
+        }
+    });
+}
+
+/**
+ * @brief Watch users for presence changes
+ * 
+ * The client is told right away which of the users are online, then gets their changes in batches.
+ * 
+ * @param client The client watching
+ * @param users The usernames to watch
+ * 
+ * @return void
+*/
+void Server::watchUsers(Connection& client, const json& users) {
+    if (!users.is_array()) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Invalid command."}}.dump());
+        return;
+    }
+    PresenceIndex::Session self{client.reactor, client.handle};
+    json online = json::array();
+    json offline = json::array();
+    for (const json& entry : users) {
+        if (!entry.is_string()) {
+            continue;
+        }
+        std::string user = entry.get<std::string>();
+        if (std::find(client.watching.begin(), client.watching.end(), user) == client.watching.end()) {
+            if (client.watching.size() >= config.maxWatches) {
+                notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Too many watched users."}}.dump());
+                break;
+            }
+            client.watching.push_back(user);
+        }
+        (presence.watch(user, self) ? online : offline).push_back(user);
+    }
+    notifyClient(client, json{{"type", "presence"}, {"online", online}, {"offline", offline}}.dump());
+}
+
+/**
+ * @brief Hand a presence change to its watchers' reactors
+ * 
+ * Watchers are grouped by reactor, so each reactor gets one task per change however many of its clients watch the user.
+ * 
+ * @param user The user that logged in or out
+ * @param watchers The sessions watching the user
+ * @param online True for a login, false for a logout
+ * 
+ * @return void
+*/
+void Server::publishPresence(const std::string& user, const std::vector<PresenceIndex::Session>& watchers, bool online) {
+    std::unordered_map<Reactor*, std::vector<SessionRegistry::Handle>> byReactor;
+    for (const PresenceIndex::Session& watcher : watchers) {
+        byReactor[watcher.reactor].push_back(watcher.handle);
+    }
+    for (auto& entry : byReactor) {
+        Reactor* reactor = entry.first;
+        reactor->post([this, reactor, handles = std::move(entry.second), user, online]() {
+            for (SessionRegistry::Handle handle : handles) {
+                Connection* client = reactor->connections.get(handle);
+                if (client != nullptr) {
+                    queuePresence(*client, user, online);
+                }
+            }
+        });
+    }
+}
+
+/**
+ * @brief Add a presence change to a client's next batch
+ * 
+ * The first change of a batch marks the client for the reactor's next presence flush, and starts the flush timer if it is not running.
+ * 
+ * @param client The client watching the user
+ * @param user The user that logged in or out
+ * @param online True for a login, false for a logout
+ * 
+ * @return void
+*/
+void Server::queuePresence(Connection& client, const std::string& user, bool online) {
+    Reactor& reactor = *client.reactor;
+    if (client.presenceUpdates.empty()) {
+        reactor.presenceDirty.push_back(client.handle);
+    }
+    client.presenceUpdates.emplace_back(user, online);
+    if (!reactor.presenceFlush.isScheduled()) {
+        reactor.timers.schedule(reactor.presenceFlush, config.presenceInterval);
+    }
+}
+
+/**
+ * @brief Send the gathered presence changes
+ * 
+ * Every client with changes gets one message listing who came online and who went offline since the last batch. A user that changed more than once is listed with its latest state.
+ * 
+ * @param reactor The reactor whose clients to update (the calling thread's)
+ * 
+ * @return void
+*/
+void Server::flushPresence(Reactor& reactor) {
+    std::vector<SessionRegistry::Handle> dirty;
+    dirty.swap(reactor.presenceDirty);
+    for (SessionRegistry::Handle handle : dirty) {
+        Connection* client = reactor.connections.get(handle);
+        if (client == nullptr) {
+            continue;
+        }
+        std::unordered_map<std::string, bool> latest;
+        for (const auto& update : client->presenceUpdates) {
+            latest[update.first] = update.second;
+        }
+        client->presenceUpdates.clear();
+        json online = json::array();
+        json offline = json::array();
+        for (const auto& entry : latest) {
+            (entry.second ? online : offline).push_back(entry.first);
+        }
+        notifyClient(*client, json{{"type", "presence"}, {"online", online}, {"offline", offline}}.dump());
+    }
+}
+
+/**
+ * @brief Handle readiness events of a client socket
+ * 
+ * Resume writing to a client that was stalled, then read whatever the client sent.
+ * 
+ * @param client The client whose socket is ready
+ * @param events The ready epoll events
+ * 
+ * @return void
+*/
+void Server::handleClientEvents(Connection& client, uint32_t events) {
+    if ((events & EPOLLOUT) && !handleWritable(client)) {
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        processClientMessage(client); // may close the client, must be last
+    }
+}
+
+/**
+ * @brief Handle an expired deadline
+ * 
+ * A client that did not finish its handshake in time is closed. A logged in client that stayed idle too long is disconnected and its partner is told.
+ * 
+ * @param client The client whose deadline expired
+ * 
+ * @return void
+*/
+void Server::handleDeadline(Connection& client) {
+    if (client.state != Connection::State::Verified) {
+        notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Handshake timed out."}}.dump());
+        closeConnection(client);
+        return;
+    }
+    notifyClient(client, json{{"type", "error"},{"status", "error"}, {"message", "Session timed out due to inactivity."}}.dump());
+    disconnectClient(client);
+}
+
+/**
+ * @brief Handle a stalled client becoming writable
+ * 
+ * Write as much of the client's output queue as the socket accepts. Progress restarts the write deadline, an empty queue cancels it. Once the queue is below the low watermark the client no longer holds its room back, and if no other member does the members whose reads were paused are read again.
+ * 
+ * @param client The client whose socket is writable
+ * 
+ * @return bool True if the client is still connected, false if it was closed
+*/
+bool Server::handleWritable(Connection& client) {
+    size_t before = client.output.size();
+    if (!client.output.flush(client.socket)) {
+        disconnectClient(client);
+        return false;
+    }
+    client.reactor->queuedBytes -= before - client.output.size();
+    if (client.output.empty() && client.reactor->draining) {
+        closeConnection(client); // its goodbye was delivered
+        return false;
+    }
+    if (client.output.empty()) {
+        client.writeDeadline.cancel();
+    } else if (client.output.size() < before && config.writeStallTimeout.count() > 0) {
+        client.reactor->timers.schedule(client.writeDeadline, config.writeStallTimeout);
+    }
+    updateEvents(client);
+    if (client.congested && client.output.size() <= config.outputLowWatermark) {
+        client.congested = false;
+        if (--client.room->congested == 0) {
+            resumeRoom(*client.room);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Update the events watched for a client
+ * 
+ * A client is watched for reads unless backpressure or its rate limits paused them (or its reactor is draining), and for writability only while its output queue holds data.
+ * 
+ * @param client The client to update
+ * 
+ * @return void
+*/
+void Server::updateEvents(Connection& client) {
+    uint32_t events = 0;
+    if (!client.readPaused && !client.rateLimited && !client.reactor->draining) {
+        events |= EPOLLIN;
+    }
+    if (!client.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    client.reactor->loop.modify(client.socket, events);
+}
+
+/**
+ * @brief Disconnect a client
+ * 
+ * Close the client and, if it was chatting, tell the rest of its room. A partner left alone in a pair goes back to the lobby to find a new one.
+ * 
+ * @param client The client to disconnect
+ * 
+ * @return void
+*/
+void Server::disconnectClient(Connection& client) {
+    std::shared_ptr<Room> room = client.room;
+    closeConnection(client);
+    if (room != nullptr) {
+        roomDeparture(*room);
+    }
+}
+
+/**
+ * @brief Close a client connection
+ * 
+ * Stop watching the client socket, close it and free its state. The connection must not be used after this call.
+ * 
+ * @param connection The connection to close
+ * 
+ * @return void
+*/
+void Server::closeConnection(Connection& connection) {
+    int socket = connection.socket;
+    Reactor& reactor = *connection.reactor;
+    if (connection.lobbyTicket) {
+        lobby.leave(connection.lobbyTicket); // its lobby entry is dropped when the matchmaking reaches it
+    }
+    PresenceIndex::Session session{&reactor, connection.handle};
+    if (!connection.username.empty()) {
+        publishPresence(connection.username, presence.setOffline(connection.username, session), false);
+    }
+    for (const std::string& user : connection.watching) {
+        presence.unwatch(user, session);
+    }
+    if (connection.room != nullptr) {
+        leaveRoom(connection);
+    }
+    connection.output.flush(socket); // last attempt to deliver queued messages (e.g. the reason for closing)
+    reactor.queuedBytes -= connection.output.size();
+    reactor.loop.remove(socket);
+    close(socket);
+    reactor.connections.erase(connection.handle); // frees the connection
+    finishDrain(reactor);
+}
+
+/**
+ * @brief Process a message from a client
+ * 
+ * Read from a client and handle every complete message. Data that does not form a complete message yet is kept in the connection's input buffer until the rest arrives. If the client disconnected, the partner is told and both connections are closed.
+ * 
+ * @param source The client whose socket is readable
+ * 
+ * @return void
+*/
+void Server::processClientMessage(Connection& source) {
+    // Read into the connection's buffer if it holds a partial message, otherwise into the shared read buffer so complete messages are never copied
+    InputBuffer& input = source.input;
+    std::vector<char>& readBuffer = source.reactor->readBuffer;
+    bool buffered = !input.empty();
+    char* target = buffered ? input.prepare(readBuffer.size()) : readBuffer.data();
+    size_t space = buffered ? std::min(input.writable(), readBuffer.size()) : readBuffer.size();
+    ssize_t bytesRead = read(source.socket, target, space);
+    if (bytesRead == 0 || (bytesRead < 0 && errno != EINTR && errno != EAGAIN)) { // Check if the client disconnected
+        disconnectClient(source);
+        return;
+    } else if (bytesRead < 0) {
+        return;
+    }
+
+    // Activity keeps the sender's session alive (its messages keep the recipients' alive)
+    if (source.room != nullptr && config.idleTimeout.count() > 0) {
+        source.reactor->timers.schedule(source.deadline, config.idleTimeout);
+    }
+
+    const char* data = target;
+    size_t size = static_cast<size_t>(bytesRead);
+    if (buffered) {
+        input.commit(size);
+        data = input.data();
+        size = input.size();
+    }
+    size_t consumed;
+    if (!processFrames(source, data, size, consumed)) {
+        return; // the client was closed, or moved to another reactor with the rest of the data
+    }
+    // Keep the incomplete tail for the next read
+    if (buffered) {
+        input.consume(consumed);
+    } else if (consumed < size) {
+        input.append(data + consumed, size - consumed);
+    }
+}
+
+/**
+ * @brief Handle every complete message in a block of data
+ * 
+ * Split the data into messages using the client's framing and handle each of them. Messages larger than the configured maximum, and binary frames of an unknown type, are refused and the client is disconnected, since the stream cannot be resynchronized.
+ * 
+ * Every message of a logged in client is charged to its rate limits. The clock is read once for the whole block, so the limits cost no system call. A client over its limits is handled by the configured policy: delayed (the rest of the data waits in its input buffer), its message dropped, or disconnected.
+ * 
+ * @param source The client that sent the data
+ * @param data The data received from the client
+ * @param size The size of the data
+ * @param consumed Set to the number of bytes that were handled (the rest is an incomplete message)
+ * 
+ * @return bool True if the client is still connected, false if it was closed or handed over to another reactor
+*/
+bool Server::processFrames(Connection& source, const char* data, size_t size, size_t& consumed) {
+    consumed = 0;
+    bool limited = source.messageBucket.limited() || source.byteBucket.limited();
+    TokenBucket::Clock::time_point now = limited ? TokenBucket::Clock::now() : TokenBucket::Clock::time_point();
+    while (consumed < size) {
+        if (source.state == Connection::State::Authenticating) {
+            return true; // the rest waits until the credentials are checked
+        }
+        const char* frame = data + consumed;
+        size_t available = size - consumed;
+        size_t start;
+        size_t end;
+        size_t pending; // size of the message (so far, if it is incomplete)
+        Framing::FrameType type = Framing::FrameType::Json;
+        if (source.binaryFraming) {
+            end = Framing::scanBinary(frame, available, start, type);
+            pending = available >= Framing::HEADER_SIZE ? Framing::binaryLength(frame) : 0;
+        } else {
+            end = Framing::scanJson(frame, available, start, source.scan);
+            if (end == Framing::INCOMPLETE && start == available) {
+                consumed = size; // only whitespace left
+                return true;
+            }
+            pending = available - start;
+        }
+        if (end == Framing::INVALID && source.binaryFraming) {
+            // An unknown frame type: the length prefixes cannot be trusted any more, everything after would be read from the middle of a payload
+            notifyClient(source, json{{"type", "error"},{"status", "error"}, {"message", "Invalid frame."}}.dump());
+            disconnectClient(source);
+            return false;
+        }
+        if (end == Framing::INVALID) {
+            notifyClient(source, json{{"type", "error"},{"status", "error"}, {"message", "Invalid JSON format."}}.dump());
+            source.scan = Framing::JsonScanState();
+            consumed = size; // the rest of the data cannot be framed, drop it
+            return true;
+        }
+        if (end != Framing::INCOMPLETE) {
+            pending = end - start;
+        }
+        if (pending > config.maxMessageSize) {
+            notifyClient(source, json{{"type", "error"},{"status", "error"}, {"message", "Message too large."}}.dump());
+            disconnectClient(source);
+            return false;
+        }
+        if (end == Framing::INCOMPLETE) {
+            return true; // wait for the rest of the message
+        }
+        if (limited && source.state == Connection::State::Verified) {
+            if (!source.messageBucket.ready(now) || !source.byteBucket.ready(now)) {
+                if (config.ratePolicy == ServerConfig::RatePolicy::Delay) {
+                    delayClient(source);
+                    return true; // the message is handled when the client is resumed
+                }
+                if (config.ratePolicy == ServerConfig::RatePolicy::Disconnect) {
+                    notifyClient(source, json{{"type", "error"},{"status", "error"}, {"message", "Rate limit exceeded."}}.dump());
+                    disconnectClient(source);
+                    return false;
+                }
+                if (!source.rateWarned) {
+                    notifyClient(source, json{{"type", "warning"}, {"message", "Rate limit exceeded, messages are dropped."}}.dump());
+                    source.rateWarned = true;
+                }
+                consumed += end;
+                continue;
+            }
+            source.rateWarned = false;
+            source.messageBucket.consume(1);
+            source.byteBucket.consume(static_cast<double>(end - start));
+        }
+        source.unhandled = std::string_view(frame + end, available - end); // taken along if the message moves the client to another reactor
+        if (!handleClientFrame(source, type, frame + start, end - start)) {
+            return false;
+        }
+        source.unhandled = std::string_view();
+        consumed += end;
+    }
+    return true;
+}
+
+/**
+ * @brief Handle the messages waiting in a client's input buffer
+ * 
+ * Used when a client whose messages were put on hold (during its login, or while over its rate limits) may go on: the messages it sent meanwhile are handled before anything new is read.
+ * 
+ * @param client The client to go on with
+ * 
+ * @return bool True if the client is still connected, false if it was closed or handed over to another reactor
+*/
+bool Server::processBuffered(Connection& client) {
+    if (client.input.empty()) {
+        return true;
+    }
+    size_t consumed;
+    if (!processFrames(client, client.input.data(), client.input.size(), consumed)) {
+        return false;
+    }
+    client.input.consume(consumed);
+    return true;
+}
+
+/**
+ * @brief Hold a client back until it is under its rate limits again
+ * 
+ * Reads stop, so the data it keeps sending fills its socket buffers and TCP slows it down. The rate timer resumes it once its buckets are out of debt.
+ * 
+ * @param client The client over its limits
+ * 
+ * @return void
+*/
+void Server::delayClient(Connection& client) {
+    if (!client.rateLimited) {
+        client.rateLimited = true;
+        updateEvents(client);
+    }
+    auto wait = std::max(client.messageBucket.delay(), client.byteBucket.delay());
+    client.reactor->timers.schedule(client.rateTimer, std::max(std::chrono::ceil<std::chrono::milliseconds>(wait), std::chrono::milliseconds(1)));
+}
+
+/**
+ * @brief Resume a client held back by its rate limits
+ * 
+ * @param client The delayed client
+ * 
+ * @return void
+*/
+void Server::resumeClient(Connection& client) {
+    client.rateLimited = false;
+    if (!processBuffered(client) || client.rateLimited) {
+        return; // closed, moved to another reactor, or over its limits again
+    }
+    updateEvents(client);
+}
+
+/**
+ * @brief Handle one message from a client
+ * 
+ * During the handshake the message is passed to verifyClient. After it, control frames are run by the server and every other message is relayed to the rest of the room exactly as it was received: the payload is encrypted between the clients, so the server does not parse it unless strict JSON checking is enabled.
+ * 
+ * @param source The client that sent the message
+ * @param type The frame type (always Json for JSON framing)
+ * @param data The message
+ * @param size The size of the message
+ * 
+ * @return bool True if the client is still connected, false if it was closed or handed over to another reactor
+*/
+bool Server::handleClientFrame(Connection& source, Framing::FrameType type, const char* data, size_t size) {
+    if (source.state != Connection::State::Verified) {
+        return verifyClient(source, std::string(data, size));
+    }
+    if (type == Framing::FrameType::Control) {
+        Reactor& reactor = *source.reactor;
+        SessionRegistry::Handle handle = source.handle;
+        handleControl(source, data, size);
+        return reactor.connections.get(handle) != nullptr; // a command may close the client or move it to another reactor
+    }
+    if (source.room == nullptr) {
+        notifyClient(source, json{{"type", "warning"}, {"message", "Waiting for another user to join."}}.dump());
+        return true;
+    }
+    if (config.strictJson && !json::accept(data, data + size)) {
+        notifyClient(source, json{{"type", "error"},{"status", "error"}, {"message", "Invalid JSON format."}}.dump());
+        return true;
+    }
+    broadcast(source, data, size); // forward straight from the read buffer
+    return true;
+}
+
+/**
+ * @brief Notify a client
+ * 
+ * Notify a client of any information by sending a JSON message.
+ * 
+ * @param client The client to notify
+ * @param jsonMessage The JSON message to send
+ * 
+ * @return void
+*/
+void Server::notifyClient(Connection& client, const std::string &jsonMessage) {
+    sendFrame(client, jsonMessage.data(), jsonMessage.size());
+}
+
+/**
+ * @brief Send a message to a client
+ * 
+ * Send the message framed for the client (followed by a newline, or preceded by a binary header) in a single system call, without copying the message. Whatever the socket does not accept, and every message sent while older data is still queued, goes to the client's output queue and is written when the socket becomes writable. If the client does not read it in time, the write deadline drops the client.
+ * 
+ * @param client The client to send to
+ * @param data The message
+ * @param size The size of the message
+ * 
+ * @return void
+*/
+void Server::sendFrame(Connection& client, const char* data, size_t size) {
+    SharedFrame message(data, size);
+    sendFrame(client, message);
+}
+
+/**
+ * @brief Send a message that may go to several clients
+ * 
+ * Same as sending a single message, except that what the socket does not take is queued from the message's shared framed copy, so every recipient that falls behind holds a reference to the same buffer instead of its own copy.
+ * 
+ * @param client The client to send to
+ * @param message The message
+ * 
+ * @return void
+*/
+void Server::sendFrame(Connection& client, SharedFrame& message) {
+    char newline = '\n';
+    char header[Framing::HEADER_SIZE];
+    size_t total = message.size() + (client.binaryFraming ? sizeof(header) : 1);
+    size_t sent = 0;
+    if (client.output.empty()) { // nothing queued, so the message may go out directly
+        iovec parts[2];
+        if (client.binaryFraming) {
+            Framing::encodeHeader(header, message.size(), Framing::FrameType::Json);
+            parts[0] = {header, sizeof(header)};
+            parts[1] = {const_cast<char*>(message.data()), message.size()};
+        } else {
+            parts[0] = {const_cast<char*>(message.data()), message.size()};
+            parts[1] = {&newline, 1};
+        }
+        msghdr msg{};
+        msg.msg_iov = parts;
+        msg.msg_iovlen = 2;
+        ssize_t result = sendmsg(client.socket, &msg, MSG_NOSIGNAL); // a closed client must not kill the whole server with SIGPIPE
+        if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return; // the socket is broken, reading from it will fail and close the client
+        }
+        sent = result > 0 ? static_cast<size_t>(result) : 0;
+        if (sent == total) {
+            return;
+        }
+    }
+
+    // Queue the part the socket did not take
+    const std::shared_ptr<const std::string>& frame = message.framed(client.binaryFraming);
+    bool wasEmpty = client.output.empty();
+    client.reactor->queuedBytes += total - sent;
+    client.output.push(frame, frame->data() + sent, total - sent);
+    if (wasEmpty) {
+        updateEvents(client);
+        if (config.writeStallTimeout.count() > 0) {
+            client.reactor->timers.schedule(client.writeDeadline, config.writeStallTimeout);
+        }
+    }
+}
+
+/**
+ * @brief Get the number of connected clients
+ * 
+ * @return size_t The number of clients on all reactors, including those still in their handshake
+*/
+size_t Server::connectionCount() const {
+    size_t count = 0;
+    for (const auto& reactor : reactors) {
+        count += reactor->connections.size();
+    }
+    return count;
+}
+
+/**
+ * @brief Get the number of logged in users
+ * 
+ * @return size_t The number of users in the presence index
+*/
+size_t Server::onlineUsers() const {
+    return presence.online();
+}
+
+/**
+ * @brief Get the unknown user statistics
+ * 
+ * @return UserHandler::FilterStats The user lookups, and how many of them the Bloom filter answered without looking
+*/
+UserHandler::FilterStats Server::unknownUserStats() const {
+    return users.GetFilterStats();
+}
+
+/**
+ * @brief Pick up the users appended to the users file
+ * 
+ * Runs on the users file watcher's thread whenever the file changes, including when this server appends a new user to it (those are already known and skipped).
+ * 
+ * @return void
+*/
+void Server::refreshUsers() {
+    size_t added = users.Refresh();
+    if (added > 0) {
+        std::cout << getFormattedCurrentTime() << ": " << added << " user(s) added from " << config.usersFile << std::endl;
+    }
+}
+
+/**
+ * @brief Get the matchmaking statistics
+ * 
+ * @return const Lobby& The lobby, for its queue depth, match count and wait times
+*/
+const Lobby& Server::lobbyStats() const {
+    return lobby;
+}
+
+/**
+ * @brief Get the output queue depth
+ * 
+ * @return size_t The number of bytes waiting to be written to all clients
+*/
+size_t Server::outputQueueDepth() const {
+    size_t depth = 0;
+    for (const auto& reactor : reactors) {
+        depth += reactor->queuedBytes; // kept per reactor so this can be read from any thread
+    }
+    return depth;
+}
+
+/**
+ * @brief Create a new user
+ * 
+ * Create a new user by reading the username and password from a JSON message and adding the user to the users file.
+ * 
+ * @param user The JSON message containing the username and password
+ * @param username Set to the decrypted username
+ * 
+ * @return bool True if the user was successfully created, false otherwise
+*/
+bool Server::createUser(const std::string& user, std::string& username) {
+    // Read user message
+    auto j = json::parse(user);
+    username = j.value("username", "");
+    std::string password = j.value("password", "");
+
+    // Decrypt the username and password
+    try {
+        username = this->rsa.decrypt(username);
+        password = this->rsa.decrypt(password);
+    } catch (const CryptoPP::Exception& e) {
+        return false; // not encrypted with our public key
+    }
+
+    // Add the user to the users file using the user handler (which refuses names the file cannot hold, e.g. with spaces)
+    if (users.AddUser(username, password)) {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Read the credentials of a user logging in
+ * 
+ * Read the username and password from a JSON message, decrypt them and find the user's salted hash in the users file. The password is not checked here: the caller hands it to the verify batcher with the salted hash.
+ * 
+ * The username is decrypted and looked up first: during a credential stuffing burst most usernames do not exist, and the user handler's Bloom filter turns them away before the password is decrypted, halving the RSA work spent on them.
+ * 
+ * @param user The JSON message containing the username and password
+ * @param username Set to the decrypted username
+ * @param password Set to the decrypted password
+ * @param saltedHash Set to the user's salted hash
+ * 
+ * @return bool True if the user exists and the credentials were decrypted, false otherwise
+*/
+bool Server::readCredentials(const std::string& user, std::string& username, std::string& password, std::string& saltedHash) {
+    auto j = json::parse(user);
+    username = j.value("username", "");
+    password = j.value("password", "");
+    // Decrypt credentials received from the client
+    try {
+        username = this->rsa.decrypt(username);
+        auto saltedHashOpt = users.FindUserSaltedHash(username);
+        if (!saltedHashOpt.has_value()) {
+            return false; // unknown user, the password is not needed
+        }
+        saltedHash = saltedHashOpt.value();
+        password = this->rsa.decrypt(password);
+    } catch (const CryptoPP::Exception& e) {
+        return false; // not encrypted with our public key
+    }
+    return true;
 }
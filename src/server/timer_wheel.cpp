@@ -0,0 +1,263 @@
+/**
+ * @file server/timer_wheel.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the TimerWheel class
+ *
+ * This file contains the implementation of the TimerWheel class, a hierarchical timer wheel used by the server to enforce handshake, idle and write deadlines on every connection without a thread or system call per connection.
+*/
+
+#include <server/timer_wheel.h>
+
+/**
+ * @brief Construct a new Timer object
+ *
+ * Initialize an unscheduled timer.
+ *
+ * @return Timer object
+*/
+TimerWheel::Timer::Timer() : wheel(nullptr), prev(nullptr), next(nullptr), expiry(0) {}
+
+/**
+ * @brief Destroy the Timer object
+ *
+ * Cancel the timer so the wheel never calls a destroyed timer.
+ *
+ * @return void
+*/
+TimerWheel::Timer::~Timer() {
+    cancel();
+}
+
+/**
+ * @brief Cancel the timer
+ *
+ * Remove the timer from its wheel in O(1). Does nothing if the timer is not scheduled.
+ *
+ * @return void
+*/
+void TimerWheel::Timer::cancel() {
+    if (wheel != nullptr) {
+        wheel->count--;
+        wheel = nullptr;
+    }
+    unlink();
+}
+
+/**
+ * @brief Check if the timer is scheduled
+ *
+ * @return bool True if the timer is waiting to expire, false otherwise
+*/
+bool TimerWheel::Timer::isScheduled() const {
+    return wheel != nullptr;
+}
+
+/**
+ * @brief Unlink the timer
+ *
+ * Remove the timer from the circular list it is linked into.
+ *
+ * @return void
+*/
+void TimerWheel::Timer::unlink() {
+    if (next != nullptr) {
+        prev->next = next;
+        next->prev = prev;
+        prev = nullptr;
+        next = nullptr;
+    }
+}
+
+/**
+ * @brief Construct a new TimerWheel object
+ *
+ * @param tick The resolution of the wheel, timers expire on tick boundaries
+ * @param start The time of tick 0
+ *
+ * @return TimerWheel object
+*/
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, Clock::time_point start) : tick(tick), start(start), currentTick(0), count(0) {
+    // Every slot head starts as an empty circular list
+    for (auto& level : slots) {
+        for (auto& head : level) {
+            head.prev = &head;
+            head.next = &head;
+        }
+    }
+}
+
+/**
+ * @brief Destroy the TimerWheel object
+ *
+ * Unlink every scheduled timer so their owners can still be destroyed safely.
+ *
+ * @return void
+*/
+TimerWheel::~TimerWheel() {
+    for (auto& level : slots) {
+        for (auto& head : level) {
+            while (head.next != &head) {
+                head.next->cancel();
+            }
+        }
+    }
+}
+
+/**
+ * @brief Schedule a timer
+ *
+ * Schedule the timer to expire after the given delay, replacing any previous schedule. Runs in O(1).
+ *
+ * @param timer The timer to schedule
+ * @param delay The time until the timer expires
+ *
+ * @return void
+*/
+void TimerWheel::schedule(Timer& timer, std::chrono::milliseconds delay) {
+    timer.cancel();
+    // Round up so a timer never fires early
+    auto due = Clock::now() + delay - start;
+    uint64_t expiry = static_cast<uint64_t>((due + tick - Clock::duration(1)) / tick);
+    timer.expiry = expiry > currentTick ? expiry : currentTick + 1;
+    timer.wheel = this;
+    count++;
+    insert(timer);
+}
+
+/**
+ * @brief Insert a timer into the wheel
+ *
+ * Link the timer into the level that covers its distance from the current tick, at the slot selected by its expiry.
+ *
+ * @param timer The timer to insert
+ *
+ * @return void
+*/
+void TimerWheel::insert(Timer& timer) {
+    uint64_t maxDelta = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+    if (timer.expiry - currentTick > maxDelta) {
+        timer.expiry = currentTick + maxDelta; // further than the wheel can hold
+    }
+    uint64_t delta = timer.expiry - currentTick;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    Timer& head = slots[level][(timer.expiry >> (SLOT_BITS * level)) & SLOT_MASK];
+    // Link at the tail of the slot
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+}
+
+/**
+ * @brief Cascade a level
+ *
+ * Move every timer in the current slot of a level to the level below, they are now close enough to be tracked with a finer resolution.
+ *
+ * @param level The level to cascade
+ *
+ * @return void
+*/
+void TimerWheel::cascade(int level) {
+    Timer& head = slots[level][(currentTick >> (SLOT_BITS * level)) & SLOT_MASK];
+    while (head.next != &head) {
+        Timer* timer = head.next;
+        timer->unlink();
+        insert(*timer);
+    }
+}
+
+/**
+ * @brief Expire a slot
+ *
+ * Run the callback of every timer in a level 0 slot. Callbacks may cancel or destroy other timers, including ones in the same slot.
+ *
+ * @param head The slot head
+ *
+ * @return void
+*/
+void TimerWheel::expire(Timer& head) {
+    while (head.next != &head) {
+        Timer* timer = head.next;
+        timer->cancel();
+        // Copy the callback, it may destroy its own timer while running
+        std::function<void()> callback = timer->callback;
+        if (callback) {
+            callback();
+        }
+    }
+}
+
+/**
+ * @brief Advance the wheel
+ *
+ * Process every tick up to the given time, cascading higher levels and running expired timers.
+ *
+ * @param now The current time
+ *
+ * @return void
+*/
+void TimerWheel::advance(Clock::time_point now) {
+    if (now < start) {
+        return;
+    }
+    uint64_t target = static_cast<uint64_t>((now - start) / tick);
+    if (count == 0) {
+        // Nothing can expire, skip the idle ticks
+        if (target > currentTick) {
+            currentTick = target;
+        }
+        return;
+    }
+    while (currentTick < target) {
+        currentTick++;
+        // When a level wraps around, the next slot of the level above comes due
+        for (int level = 1; level < LEVELS; level++) {
+            if ((currentTick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+        expire(slots[0][currentTick & SLOT_MASK]);
+    }
+}
+
+/**
+ * @brief Get the time until the wheel needs to advance again
+ *
+ * Used as the event loop timeout: the time until the next non-empty level 0 slot, or until the next cascade if level 0 is empty.
+ *
+ * @param now The current time
+ *
+ * @return int Milliseconds until the next advance, or -1 if no timers are scheduled
+*/
+int TimerWheel::nextTimeoutMs(Clock::time_point now) const {
+    if (count == 0) {
+        return -1;
+    }
+    uint64_t ticks = 1;
+    while (ticks < SLOTS - (currentTick & SLOT_MASK)) {
+        const Timer& head = slots[0][(currentTick + ticks) & SLOT_MASK];
+        if (head.next != &head) {
+            break;
+        }
+        ticks++;
+    }
+    auto due = start + (currentTick + ticks) * tick;
+    if (due <= now) {
+        return 0;
+    }
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+}
+
+/**
+ * @brief Get the number of scheduled timers
+ *
+ * @return size_t The number of timers waiting to expire
+*/
+size_t TimerWheel::size() const {
+    return count;
+}
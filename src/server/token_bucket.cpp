@@ -0,0 +1,76 @@
+/**
+ * @file server/token_bucket.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the TokenBucket class
+ *
+ * This file contains the implementation of the TokenBucket class, which limits the rate at which a client's messages are handled.
+*/
+
+#include <server/token_bucket.h>
+#include <algorithm>
+
+/**
+ * @brief Construct a new TokenBucket object
+ *
+ * The bucket starts full.
+ *
+ * @param rate The tokens added per second (0 for no limit)
+ * @param burst The most tokens the bucket holds
+ *
+ * @return TokenBucket object
+*/
+TokenBucket::TokenBucket(double rate, double burst) : rate(rate), burst(burst), tokens(burst), last() {}
+
+/**
+ * @brief Check if work may go ahead
+ *
+ * @param now The current time
+ *
+ * @return bool True if the bucket is not in debt (or does not limit)
+*/
+bool TokenBucket::ready(Clock::time_point now) {
+    if (rate <= 0) {
+        return true;
+    }
+    if (now > last) {
+        double elapsed = std::chrono::duration<double>(now - last).count();
+        tokens = std::min(burst, tokens + elapsed * rate);
+        last = now;
+    }
+    return tokens >= 0;
+}
+
+/**
+ * @brief Take the cost of some work out of the bucket
+ *
+ * @param cost The tokens the work costs
+ *
+ * @return void
+*/
+void TokenBucket::consume(double cost) {
+    if (rate > 0) {
+        tokens -= cost;
+    }
+}
+
+/**
+ * @brief Get the time until the bucket is out of debt
+ *
+ * @return Clock::duration The time until ready() returns true again, zero if it already does
+*/
+TokenBucket::Clock::duration TokenBucket::delay() const {
+    if (rate <= 0 || tokens >= 0) {
+        return Clock::duration::zero();
+    }
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(-tokens / rate));
+}
+
+/**
+ * @brief Check if the bucket limits anything
+ *
+ * @return bool True if a rate was set
+*/
+bool TokenBucket::limited() const {
+    return rate > 0;
+}
@@ -0,0 +1,380 @@
+/**
+ * @file server/user_database.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the UserDatabase class
+ *
+ * This file contains the implementation of the UserDatabase class, the binary user database that is mapped in memory instead of being loaded.
+*/
+
+#include <server/user_database.h>
+#include <common/passhash.h>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'H', 'A', 'T', 'U', 'S', 'R', 'S'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t SALT_SIZE = 16; // bytes, PasswordHasher::GenerateRandomSalt(16)
+constexpr size_t HASH_SIZE = 32; // bytes, SHA-256
+constexpr size_t MIN_BUCKETS = 16;
+
+// Start of the file
+struct FileHeader {
+    char magic[8]; // MAGIC
+    uint32_t version; // VERSION
+    uint32_t recordSize; // sizeof(Record)
+    uint64_t count; // number of records
+    uint64_t buckets; // number of table buckets
+    uint64_t recordsOffset; // where the records start
+    uint64_t tableOffset; // where the table starts
+    uint64_t namesOffset; // where the usernames start
+    uint64_t namesSize; // size of the usernames, they end the file
+};
+
+// One user
+struct Record {
+    uint64_t nameOffset; // username, from the start of the usernames
+    uint32_t nameSize; // size of the username
+    uint32_t kdf; // function the hash was made with (top 8 bits) and its cost (0 for SHA-256)
+    unsigned char salt[SALT_SIZE];
+    unsigned char hash[HASH_SIZE];
+};
+
+static_assert(sizeof(FileHeader) == 64, "the header is part of the file format");
+static_assert(sizeof(Record) == 64, "records are part of the file format");
+
+// FNV-1a, the top half is kept in the table to skip most records without reading them
+uint64_t hashName(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Convert hex to bytes, accepting only the given case (the salt is upper case and the hash lower case, the salt is hashed as text so its case must survive)
+bool fromHex(const char* hex, unsigned char* bytes, size_t size, bool upper) {
+    for (size_t i = 0; i < size * 2; i++) {
+        char c = hex[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : upper && c >= 'A' && c <= 'F' ? c - 'A' + 10 : !upper && c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) {
+            return false;
+        }
+        bytes[i / 2] = static_cast<unsigned char>(i % 2 == 0 ? digit << 4 : bytes[i / 2] | digit);
+    }
+    return true;
+}
+
+std::string toHex(const unsigned char* bytes, size_t size, bool upper) {
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    std::string hex;
+    hex.reserve(size * 2);
+    for (size_t i = 0; i < size; i++) {
+        hex += digits[bytes[i] >> 4];
+        hex += digits[bytes[i] & 0x0f];
+    }
+    return hex;
+}
+
+// Fill a record's salt, hash and function from a salted hash, false if it cannot be stored
+bool pack(const std::string& saltedHash, Record& record) {
+    PasswordHasher::Kdf kdf;
+    std::string salt, hash;
+    if (!PasswordHasher::ParseRecord(saltedHash, kdf, salt, hash) || salt.size() != 2 * SALT_SIZE || hash.size() != 2 * HASH_SIZE) {
+        return false;
+    }
+    record.kdf = static_cast<uint32_t>(kdf.algorithm) << 24 | kdf.cost; // ParseRecord checked that the cost fits
+    return fromHex(salt.data(), record.salt, SALT_SIZE, true) && fromHex(hash.data(), record.hash, HASH_SIZE, false);
+}
+
+} // namespace
+
+/**
+ * @brief Construct a new UserDatabase object
+ *
+ * Map the file and check its header. The records are checked as they are used.
+ *
+ * @param path The database file
+ *
+ * @return UserDatabase object
+*/
+UserDatabase::UserDatabase(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1 || static_cast<size_t>(info.st_size) < sizeof(FileHeader)) {
+        if (fd != -1) {
+            close(fd);
+        }
+        throw std::runtime_error("Failed to open the user database " + path);
+    }
+    fileSize = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map the user database " + path);
+    }
+    data = static_cast<const unsigned char*>(mapping);
+    madvise(mapping, fileSize, MADV_RANDOM); // lookups jump around, read ahead would be wasted
+
+    FileHeader header;
+    memcpy(&header, data, sizeof(header));
+    bool valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION && header.recordSize == sizeof(Record)
+        && header.count <= fileSize / sizeof(Record) && header.buckets <= fileSize / sizeof(uint64_t) // keeps the sums below from overflowing
+        && header.buckets >= MIN_BUCKETS && (header.buckets & (header.buckets - 1)) == 0 && header.count < header.buckets
+        && header.recordsOffset == sizeof(FileHeader) && header.tableOffset == header.recordsOffset + header.count * sizeof(Record)
+        && header.namesOffset == header.tableOffset + header.buckets * sizeof(uint64_t) && header.namesOffset + header.namesSize == fileSize;
+    if (!valid) {
+        munmap(mapping, fileSize);
+        throw std::runtime_error("Invalid user database " + path);
+    }
+    count = header.count;
+    buckets = header.buckets;
+    records = data + header.recordsOffset;
+    table = reinterpret_cast<const uint64_t*>(data + header.tableOffset);
+    names = reinterpret_cast<const char*>(data + header.namesOffset);
+    namesSize = header.namesSize;
+}
+
+/**
+ * @brief Destroy the UserDatabase object
+ *
+ * @return void
+*/
+UserDatabase::~UserDatabase() {
+    munmap(const_cast<unsigned char*>(data), fileSize);
+}
+
+/**
+ * @brief Find a user's salted hash
+ *
+ * Probe the table from the username's bucket until an empty bucket. Only buckets with the same hash bits lead to a record.
+ *
+ * @param username The username to find
+ *
+ * @return std::optional<std::string> The salted hash of the user, or std::nullopt if the user was not found
+*/
+std::optional<std::string> UserDatabase::find(const std::string& username) const {
+    uint64_t hash = hashName(username.data(), username.size());
+    uint64_t mask = buckets - 1;
+    for (uint64_t i = hash & mask, probes = 0; probes < buckets; i = (i + 1) & mask, probes++) {
+        uint64_t bucket = table[i];
+        if (bucket == 0) {
+            return std::nullopt;
+        }
+        if (bucket >> 32 != hash >> 32) {
+            continue;
+        }
+        uint64_t record = (bucket & 0xffffffffu) - 1;
+        const char* name;
+        uint32_t size;
+        if (nameOf(record, name, size) && size == username.size() && memcmp(name, username.data(), size) == 0) {
+            return saltedHashOf(record);
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Get the number of users
+ *
+ * @return size_t The number of users in the database
+*/
+size_t UserDatabase::size() const {
+    return count;
+}
+
+/**
+ * @brief Visit every user
+ *
+ * Used to merge a database into a new one. Damaged records are skipped.
+ *
+ * @param visit Called with each username and its salted hash, in record order
+ *
+ * @return void
+*/
+void UserDatabase::forEach(const std::function<void(const std::string&, const std::string&)>& visit) const {
+    for (uint64_t record = 0; record < count; record++) {
+        const char* name;
+        uint32_t size;
+        if (nameOf(record, name, size)) {
+            visit(std::string(name, size), saltedHashOf(record));
+        }
+    }
+}
+
+/**
+ * @brief Parse a line of the users file
+ *
+ * The server (at startup and when the file grows) and tools/convert_users all read the file through this, so they agree on every line. A line holds a username and a salted hash separated by whitespace, anything after them is ignored.
+ *
+ * @param line The line, without its newline
+ * @param username Set to the username of a User line
+ * @param saltedHash Set to the salted hash of a User line
+ *
+ * @return Line What the line holds
+*/
+UserDatabase::Line UserDatabase::parseLine(const std::string& line, std::string& username, std::string& saltedHash) {
+    std::istringstream iss(line);
+    if (iss >> username >> saltedHash && validUsername(username)) {
+        return Line::User;
+    }
+    return line.find_first_not_of(" \t\r") == std::string::npos ? Line::Blank : Line::Malformed;
+}
+
+/**
+ * @brief Check a username
+ *
+ * The users file separates a username from its salted hash with whitespace and ends the line with a newline, so a username with either would be read back as another user.
+ *
+ * @param username The username
+ *
+ * @return bool True if the username can be stored
+*/
+bool UserDatabase::validUsername(const std::string& username) {
+    if (username.empty()) {
+        return false;
+    }
+    for (unsigned char c : username) {
+        if (c <= ' ' || c == 0x7f) {
+            return false; // whitespace or a control character
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Write a database
+ *
+ * The file is built under a temporary name, synced and renamed over the path, so a reader never maps a half written database.
+ *
+ * @param path The database file
+ * @param users The users and their salted hashes, as in the users file
+ *
+ * @return void
+*/
+void UserDatabase::write(const std::string& path, const std::vector<Entry>& users) {
+    // Keep the first entry of each username and check the salted hashes
+    std::vector<const Entry*> kept;
+    std::unordered_set<std::string_view> seen;
+    uint64_t namesSize = 0;
+    for (const Entry& user : users) {
+        if (!seen.insert(user.first).second) {
+            continue;
+        }
+        Record record;
+        if (!pack(user.second, record)) {
+            throw std::runtime_error("Invalid salted hash for user " + user.first);
+        }
+        kept.push_back(&user);
+        namesSize += user.first.size();
+    }
+    if (kept.size() >= 0xffffffffu) {
+        throw std::runtime_error("Too many users for one database");
+    }
+    FileHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.recordSize = sizeof(Record);
+    header.count = kept.size();
+    header.buckets = MIN_BUCKETS;
+    while (header.buckets < 2 * header.count) {
+        header.buckets *= 2;
+    }
+    header.recordsOffset = sizeof(FileHeader);
+    header.tableOffset = header.recordsOffset + header.count * sizeof(Record);
+    header.namesOffset = header.tableOffset + header.buckets * sizeof(uint64_t);
+    header.namesSize = namesSize;
+    size_t size = header.namesOffset + header.namesSize;
+
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1 || ftruncate(fd, static_cast<off_t>(size)) == -1) {
+        if (fd != -1) {
+            close(fd);
+        }
+        throw std::runtime_error("Failed to create " + temporary);
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Failed to map " + temporary);
+    }
+    unsigned char* out = static_cast<unsigned char*>(mapping);
+    memcpy(out, &header, sizeof(header));
+    uint64_t* buckets = reinterpret_cast<uint64_t*>(out + header.tableOffset); // zero filled by ftruncate
+    uint64_t mask = header.buckets - 1;
+    uint64_t nameOffset = 0;
+    for (uint64_t i = 0; i < kept.size(); i++) {
+        const Entry& user = *kept[i];
+        Record record{};
+        record.nameOffset = nameOffset;
+        record.nameSize = static_cast<uint32_t>(user.first.size());
+        pack(user.second, record);
+        memcpy(out + header.recordsOffset + i * sizeof(Record), &record, sizeof(record));
+        memcpy(out + header.namesOffset + nameOffset, user.first.data(), user.first.size());
+        nameOffset += user.first.size();
+        uint64_t hash = hashName(user.first.data(), user.first.size());
+        uint64_t bucket = hash & mask;
+        while (buckets[bucket] != 0) {
+            bucket = (bucket + 1) & mask;
+        }
+        buckets[bucket] = (hash >> 32 << 32) | (i + 1);
+    }
+    bool synced = msync(mapping, size, MS_SYNC) == 0;
+    munmap(mapping, size);
+    synced = fsync(fd) == 0 && synced;
+    close(fd);
+    if (!synced || rename(temporary.c_str(), path.c_str()) == -1) {
+        unlink(temporary.c_str());
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+/**
+ * @brief Get the text form of a record's salted hash
+ *
+ * @param record The record number
+ *
+ * @return std::string The salted hash, as PasswordHasher::HashPassword makes it
+*/
+std::string UserDatabase::saltedHashOf(uint64_t record) const {
+    const Record* entry = reinterpret_cast<const Record*>(records + record * sizeof(Record));
+    PasswordHasher::Kdf kdf;
+    kdf.algorithm = static_cast<PasswordHasher::Algorithm>(entry->kdf >> 24);
+    kdf.cost = entry->kdf & 0xffffffu;
+    if (!PasswordHasher::ValidKdf(kdf)) {
+        return ""; // damaged, matches no password
+    }
+    return PasswordHasher::FormatRecord(kdf, toHex(entry->salt, SALT_SIZE, true), toHex(entry->hash, HASH_SIZE, false));
+}
+
+/**
+ * @brief Locate a record's username
+ *
+ * @param record The record number
+ * @param name Set to the username (not null terminated)
+ * @param size Set to the size of the username
+ *
+ * @return bool False if the record does not exist or its username is outside the file
+*/
+bool UserDatabase::nameOf(uint64_t record, const char*& name, uint32_t& size) const {
+    if (record >= count) {
+        return false;
+    }
+    const Record* entry = reinterpret_cast<const Record*>(records + record * sizeof(Record));
+    if (entry->nameOffset > namesSize || entry->nameSize > namesSize - entry->nameOffset) {
+        return false;
+    }
+    name = names + entry->nameOffset;
+    size = entry->nameSize;
+    return true;
+}
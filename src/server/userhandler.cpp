@@ -8,23 +8,41 @@
 */
 
 #include <server/userhandler.h>
+#include <algorithm>
 #include <iostream>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 /**
  * @brief Construct a new UserHandler object
  * 
- * Initialize a new UserHandler object with the specified filename.
+ * Initialize a new UserHandler object with the specified filename and load the users already in it. The binary database is mapped if the file exists, an invalid one (or an invalid hashing cost) throws. Then every username is added to the Bloom filter.
  * 
  * @param filename The filename to use for storing user information
+ * @param database The binary database made from earlier users files (none if empty)
+ * @param kdf The function new passwords are hashed with (existing users keep theirs)
+ * @param shards Number of independently locked parts of the index
  * 
  * @return UserHandler object
 */
-UserHandler::UserHandler(const std::string& filename) : filename(filename) {}
+UserHandler::UserHandler(const std::string& filename, const std::string& database, const PasswordHasher::Kdf& kdf, size_t shards) : filename(filename), kdf(kdf), shards(new Shard[std::max<size_t>(shards, 1)]), shardCount(std::max<size_t>(shards, 1)) {
+    if (!PasswordHasher::ValidKdf(kdf)) {
+        throw std::invalid_argument("Invalid password hashing cost");
+    }
+    if (!database.empty() && access(database.c_str(), F_OK) == 0) {
+        this->database = std::make_unique<UserDatabase>(database);
+    }
+    Load();
+    BuildFilter();
+}
 
 /**
  * @brief Add a new user to the user database
  * 
- * Add a new user with the specified username and password to the user database.
+ * Add a new user with the specified username and password to the user database. The password is hashed without holding any lock, the name is then taken atomically.
  * 
  * @param username The username of the new user
  * @param password The password of the new user
@@ -32,16 +50,42 @@ UserHandler::UserHandler(const std::string& filename) : filename(filename) {}
  * @return bool True if the user was added successfully, false otherwise
 */
 bool UserHandler::AddUser(const std::string& username, const std::string& password) {
-    std::ofstream file(filename, std::ios::app);
-    if (!file.is_open()) {
+    // Check if the username is usable and free (saves hashing, InsertIfAbsent checks again)
+    if (!UserDatabase::validUsername(username) || FindUserSaltedHash(username).has_value()) {
         return false;
     }
-    // Check if the username already exists
-    if (FindUserSaltedHash(username).has_value()) {
+    std::string saltedHash = PasswordHasher::HashPassword(password, PasswordHasher::GenerateRandomSalt(16), kdf);
+    return InsertIfAbsent(username, saltedHash);
+}
+
+/**
+ * @brief Add a user unless the name is taken
+ * 
+ * The shard's lock is held from the check until the user is in the index, so of two concurrent calls for one name exactly one succeeds. The user is added to the index only once it was written to the file.
+ * 
+ * @param username The username of the new user
+ * @param saltedHash The user's salted hash, as made by PasswordHasher::HashPassword
+ * 
+ * @return bool True if the user was added, false if the name is taken or cannot be stored (see UserDatabase::validUsername) or the file cannot be written
+*/
+bool UserHandler::InsertIfAbsent(const std::string& username, const std::string& saltedHash) {
+    if (!UserDatabase::validUsername(username)) {
+        return false; // would be read back as another user, or not at all
+    }
+    Shard& shard = ShardOf(username);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if (shard.users.count(username) != 0 || (database && database->find(username).has_value())) {
         return false;
     }
-    std::string saltedHash = PasswordHasher::HashPassword(password, PasswordHasher::GenerateRandomSalt(16));
-    file << username << " " << saltedHash << std::endl;
+    {
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        std::ofstream file(filename, std::ios::app);
+        if (!file.is_open() || !(file << username << " " << saltedHash << std::endl)) {
+            return false;
+        }
+    }
+    filter->add(username); // before the index, so a lookup that finds the user also passes the filter
+    shard.users.emplace(username, saltedHash);
     return true;
 }
 
@@ -63,30 +107,193 @@ bool UserHandler::VerifyUser(const std::string& username, const std::string& pas
     return PasswordHasher::VerifyPassword(password, saltedHashOpt.value());
 }
 
+/**
+ * @brief Check if a user exists
+ * 
+ * @param username The username to look for
+ * 
+ * @return bool True if the user is in the user database, false otherwise
+*/
+bool UserHandler::HasUser(const std::string& username) {
+    return FindUserSaltedHash(username).has_value();
+}
+
 /**
  * @brief Find a user's salted hash
  * 
- * Find the salted hash for the specified username in the user database.
+ * Find the salted hash for the specified username in the index, then in the binary database. Usernames the Bloom filter has never seen are not looked up.
  * 
  * @param username The username to find
  * 
  * @return std::optional<std::string> The salted hash of the user, or std::nullopt if the user was not found
 */
 std::optional<std::string> UserHandler::FindUserSaltedHash(const std::string& username) {
+    lookups.fetch_add(1, std::memory_order_relaxed);
+    if (!filter->mayContain(username)) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    Shard& shard = ShardOf(username);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.users.find(username);
+    if (it != shard.users.end()) {
+        return it->second;
+    }
+    lock.unlock();
+    return database ? database->find(username) : std::nullopt;
+}
+
+/**
+ * @brief Get the Bloom filter statistics
+ * 
+ * @return FilterStats The number of lookups, and of lookups the filter answered without the index
+*/
+UserHandler::FilterStats UserHandler::GetFilterStats() const {
+    FilterStats stats;
+    stats.lookups = lookups.load(std::memory_order_relaxed);
+    stats.rejected = rejected.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * @brief Add the users appended to the file
+ * 
+ * Read the file from where the last read stopped, so the cost is that of the new lines, and add the users not known yet: the file's earlier lines, the database and users added through this object (whose lines are read back too) win, as at startup. A line not ended yet is left for the next refresh, it may still be being written. The new lines are read and parsed without any lock, each user is then inserted under its shard's lock, so lookups only wait for one insert. If the file was replaced or rewritten it is read again from the start.
+ * 
+ * @return size_t The number of users added
+*/
+size_t UserHandler::Refresh() {
+    std::lock_guard<std::mutex> lock(refreshMutex);
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return 0; // no file yet
+    }
+    std::string appended = ReadAppended(fd);
+    close(fd);
+    size_t end = appended.rfind('\n');
+    if (end == std::string::npos) {
+        return 0; // no complete line yet
+    }
+    readSize += static_cast<std::streamoff>(end + 1);
+
+    size_t added = 0;
+    std::istringstream lines(appended.substr(0, end + 1));
+    std::string line;
+    while (getline(lines, line)) {
+        std::string storedUsername, storedSaltedHash;
+        if (UserDatabase::parseLine(line, storedUsername, storedSaltedHash) != UserDatabase::Line::User) {
+            continue; // blank or malformed line, skipped as by Load
+        }
+        Shard& shard = ShardOf(storedUsername);
+        std::unique_lock<std::shared_mutex> shardLock(shard.mutex);
+        if (shard.users.count(storedUsername) != 0 || (database && database->find(storedUsername).has_value())) {
+            continue;
+        }
+        filter->add(storedUsername); // before the index, as in InsertIfAbsent
+        shard.users.emplace(storedUsername, storedSaltedHash);
+        added++;
+    }
+    return added;
+}
+
+/**
+ * @brief Read what was appended to the file since the last refresh
+ * 
+ * Where the last read stopped only means something in the same file: if the open file is not the one read so far (it was moved over, or deleted and created again), is shorter than what was read, or the byte before that point is no longer the end of a line (it was rewritten in place), it is read from the start. The caller holds refreshMutex.
+ * 
+ * @param fd The users file, open for reading
+ * 
+ * @return std::string The file's data from readSize on (readSize is reset to 0 first if the file is read again)
+*/
+std::string UserHandler::ReadAppended(int fd) {
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        return "";
+    }
+    char last = '\n';
+    if (info.st_dev != readDevice || info.st_ino != readInode || info.st_size < readSize
+        || (readSize > 0 && (pread(fd, &last, 1, readSize - 1) != 1 || last != '\n'))) {
+        readSize = 0; // replaced or rewritten
+        readDevice = info.st_dev;
+        readInode = info.st_ino;
+    }
+    std::string appended(static_cast<size_t>(info.st_size - readSize), '\0');
+    size_t done = 0;
+    while (done < appended.size()) {
+        ssize_t length = pread(fd, &appended[done], appended.size() - done, readSize + static_cast<off_t>(done));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(length);
+    }
+    appended.resize(done);
+    return appended;
+}
+
+/**
+ * @brief Get the shard of a username
+ * 
+ * @param username The username
+ * 
+ * @return Shard& The shard its entry belongs to
+*/
+UserHandler::Shard& UserHandler::ShardOf(const std::string& username) {
+    return shards[std::hash<std::string>()(username) % shardCount];
+}
+
+/**
+ * @brief Load the user database
+ * 
+ * Read every line of the file into the index. A missing file is an empty database (it is created by the first AddUser). If a username appears twice, the first line wins, as it did when the file was searched. Blank and malformed lines are skipped, as Refresh() skips them. Refresh() continues from the end of the file as it is now (the file is identified first, so one that replaces it meanwhile is read in full).
+ * 
+ * @return void
+*/
+void UserHandler::Load() {
+    struct stat info;
+    if (stat(filename.c_str(), &info) == 0) {
+        readDevice = info.st_dev;
+        readInode = info.st_ino;
+    }
     std::ifstream file(filename);
     if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return std::nullopt;
+        return; // no users yet
     }
     std::string line;
     while (getline(file, line)) {
-        std::istringstream iss(line);
         std::string storedUsername, storedSaltedHash;
-        if (!(iss >> storedUsername >> storedSaltedHash)) { break; } // error
+        if (UserDatabase::parseLine(line, storedUsername, storedSaltedHash) != UserDatabase::Line::User) {
+            continue; // blank or malformed line, skipped (as by Refresh) so the users after it are not lost
+        }
 
-        if (storedUsername == username) {
-            return storedSaltedHash;
+        ShardOf(storedUsername).users.emplace(storedUsername, storedSaltedHash); // not shared yet, no lock needed
+    }
+    file.clear();
+    file.seekg(0, std::ios::end);
+    readSize = std::max<std::streamoff>(file.tellg(), 0);
+}
+
+/**
+ * @brief Build the Bloom filter
+ * 
+ * Sized for twice the users there are now, so new users keep its false positives low for a while.
+ * 
+ * @return void
+*/
+void UserHandler::BuildFilter() {
+    size_t count = database ? database->size() : 0;
+    for (size_t i = 0; i < shardCount; i++) {
+        count += shards[i].users.size();
+    }
+    filter = std::make_unique<BloomFilter>(std::max<size_t>(2 * count, 1024));
+    for (size_t i = 0; i < shardCount; i++) {
+        for (const auto& user : shards[i].users) {
+            filter->add(user.first);
         }
     }
-    return std::nullopt;
+    if (database) {
+        database->forEach([this](const std::string& username, const std::string&) { filter->add(username); });
+    }
 }
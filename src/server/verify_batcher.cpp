@@ -0,0 +1,87 @@
+/**
+ * @file server/verify_batcher.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the VerifyBatcher class
+ *
+ * This file contains the implementation of the VerifyBatcher class, which checks the passwords of concurrent logins together.
+*/
+
+#include <server/verify_batcher.h>
+#include <common/passhash.h>
+#include <algorithm>
+#include <iterator>
+
+/**
+ * @brief Construct a new VerifyBatcher object
+ *
+ * @param maxBatch The most passwords checked together (at least one)
+ *
+ * @return VerifyBatcher object
+*/
+VerifyBatcher::VerifyBatcher(size_t maxBatch) : maxBatch(std::max<size_t>(maxBatch, 1)) {}
+
+/**
+ * @brief Check a password
+ *
+ * A password stored with a slow function is checked right away. Otherwise it is queued, and unless another worker is already checking batches, this worker checks batches until the queue is empty, delivering every verdict in them.
+ *
+ * @param password The password
+ * @param saltedHash The salted hash it must match
+ * @param done Called with the verdict
+ *
+ * @return void
+*/
+void VerifyBatcher::verify(std::string password, std::string saltedHash, Done done) {
+    if (!PasswordHasher::IsBatchable(saltedHash)) {
+        done(PasswordHasher::VerifyPassword(password, saltedHash));
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.push_back(Pending{std::move(password), std::move(saltedHash), std::move(done)});
+    if (checking) {
+        return; // the worker checking batches takes it
+    }
+    checking = true;
+    while (!queue.empty()) {
+        std::vector<Pending> batch;
+        if (queue.size() <= maxBatch) {
+            batch.swap(queue);
+        } else {
+            batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + maxBatch));
+            queue.erase(queue.begin(), queue.begin() + maxBatch);
+        }
+        lock.unlock();
+        std::vector<PasswordHasher::Candidate> candidates;
+        candidates.reserve(batch.size());
+        for (const Pending& pending : batch) {
+            candidates.push_back({pending.password, pending.saltedHash});
+        }
+        std::vector<bool> verdicts = PasswordHasher::VerifyPasswords(candidates);
+        batchCount.fetch_add(1, std::memory_order_relaxed);
+        passwordCount.fetch_add(batch.size(), std::memory_order_relaxed);
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch[i].done(verdicts[i]);
+        }
+        lock.lock();
+    }
+    checking = false;
+}
+
+/**
+ * @brief Get the number of batches checked
+ *
+ * @return uint64_t Batches checked so far
+*/
+uint64_t VerifyBatcher::batches() const {
+    return batchCount.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Get the number of passwords checked in batches
+ *
+ * @return uint64_t Passwords checked in batches so far (batched() / batches() is the average batch size)
+*/
+uint64_t VerifyBatcher::batched() const {
+    return passwordCount.load(std::memory_order_relaxed);
+}
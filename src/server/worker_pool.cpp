@@ -0,0 +1,105 @@
+/**
+ * @file server/worker_pool.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief This file contains the implementation of the WorkerPool class
+ *
+ * This file contains the implementation of the WorkerPool class, a bounded job queue served by a fixed number of threads.
+*/
+
+#include <server/worker_pool.h>
+
+/**
+ * @brief Construct a new WorkerPool object
+ *
+ * Start the threads, they sleep until jobs are submitted.
+ *
+ * @param threads The number of threads (at least one is started)
+ * @param capacity The maximum number of queued jobs
+ *
+ * @return WorkerPool object
+*/
+WorkerPool::WorkerPool(size_t threads, size_t capacity) : capacity(capacity), stopping(false) {
+    size_t count = threads > 0 ? threads : 1;
+    for (size_t i = 0; i < count; i++) {
+        this->threads.emplace_back([this]() { work(); });
+    }
+}
+
+/**
+ * @brief Destroy the WorkerPool object
+ *
+ * Drop the jobs that have not started and wait for the running ones to finish.
+ *
+ * @return void
+*/
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    ready.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Queue a job
+ *
+ * @param job The job to run on a pool thread
+ *
+ * @return bool True if the job was queued, false if the queue is full or the pool is stopping
+*/
+bool WorkerPool::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || jobs.size() >= capacity) {
+            return false;
+        }
+        jobs.push_back(std::move(job));
+    }
+    ready.notify_one();
+    return true;
+}
+
+/**
+ * @brief Get the number of queued jobs
+ *
+ * @return size_t The number of jobs waiting for a thread
+*/
+size_t WorkerPool::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size();
+}
+
+/**
+ * @brief Get the number of threads
+ *
+ * @return size_t The number of pool threads
+*/
+size_t WorkerPool::size() const {
+    return threads.size();
+}
+
+/**
+ * @brief Run jobs until the pool stops
+ *
+ * @return void
+*/
+void WorkerPool::work() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
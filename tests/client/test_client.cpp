@@ -6,4 +6,75 @@
 // Placeholder test so that the test suite runs
 TEST(PlaceholderTest, Placeholder) {
     EXPECT_EQ(1, 1);
-}
\ No newline at end of file
+}
+// Test Case: newline framed messages are extracted one at a time and partial data is kept
+TEST(ClientFramingTest, ExtractsNewlineMessages) {
+    std::string ip = "127.0.0.1";
+    Client client(ip, 0, "user", "password", 1);
+    std::string buffer = "{\"a\":1}\n{\"b\":2}\n{\"c\"";
+    std::string message;
+    ASSERT_TRUE(client.nextMessage(buffer, message));
+    EXPECT_EQ(message, "{\"a\":1}");
+    ASSERT_TRUE(client.nextMessage(buffer, message));
+    EXPECT_EQ(message, "{\"b\":2}");
+    EXPECT_FALSE(client.nextMessage(buffer, message));
+    EXPECT_EQ(buffer, "{\"c\"");
+}
+
+// Test Case: binary frames are extracted once their whole payload has arrived
+TEST(ClientFramingTest, ExtractsBinaryFrames) {
+    std::string ip = "127.0.0.1";
+    Client client(ip, 0, "user", "password", 1);
+    client.binaryFraming = true;
+    std::string frame = Framing::encodeBinary("{\"a\":1}");
+    std::string buffer = frame.substr(0, 3);
+    std::string message;
+    EXPECT_FALSE(client.nextMessage(buffer, message));
+    buffer += frame.substr(3);
+    ASSERT_TRUE(client.nextMessage(buffer, message));
+    EXPECT_EQ(message, "{\"a\":1}");
+    EXPECT_TRUE(buffer.empty());
+}
+
+// Test Case: presence entries that are not user names (e.g. relayed by a partner) are skipped instead of throwing
+TEST(ClientMessageTest, PresenceSkipsNonStrings) {
+    std::string ip = "127.0.0.1";
+    Client client(ip, 0, "user", "password", 1);
+    EXPECT_NO_THROW(client.handleJsonMessage("{\"type\":\"presence\",\"online\":[1,\"bob\"],\"offline\":[{}]}", nullptr));
+}
+
+// Test Case: once the chat started, handshake messages (which a partner could send) no longer change the session
+TEST(ClientMessageTest, HandshakeMessagesIgnoredAfterLogin) {
+    std::string ip = "127.0.0.1";
+    Client client(ip, 0, "user", "password", 1);
+    client.handleJsonMessage("{\"type\":\"success\",\"message\":\"User verified successfully.\"}", nullptr);
+    nlohmann::json ticket = {{"type", "ticket"}, {"ticket", "issued"}, {"secret", client.rsa.encrypt("secret", client.rsa.getPublicKey())}};
+    client.handleJsonMessage(ticket.dump(), nullptr);
+    EXPECT_EQ(client.sessionTicket, "issued");
+    EXPECT_EQ(client.ticketSecret, "secret");
+    client.handleJsonMessage("{\"type\":\"info\",\"message\":\"You are now chatting!\"}", nullptr);
+    EXPECT_FALSE(client.handshaking);
+    client.handleJsonMessage("{\"type\":\"ticket\",\"ticket\":\"forged\",\"secret\":\"x\"}", nullptr);
+    client.handleJsonMessage("{\"type\":\"resumed\",\"framing\":\"binary\"}", nullptr);
+    EXPECT_EQ(client.sessionTicket, "issued");
+    EXPECT_FALSE(client.binaryFraming);
+}
+
+// Test Case: a binary frame of unknown type drops the connection instead of reading on from the middle of a payload
+TEST(ClientFramingTest, UnknownBinaryFrameDropsConnection) {
+    std::string ip = "127.0.0.1";
+    Client client(ip, 0, "user", "password", 1);
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    client.sock = fds[0];
+    client.binaryFraming = true;
+    std::string buffer = Framing::encodeBinary("{\"a\":1}");
+    buffer[4] = 9; // not a frame type
+    buffer += Framing::encodeBinary("{\"b\":2}");
+    std::string message;
+    EXPECT_FALSE(client.nextMessage(buffer, message));
+    EXPECT_TRUE(buffer.empty());
+    char byte;
+    EXPECT_EQ(recv(fds[1], &byte, 1, 0), 0); // the server side sees the connection closed
+    close(fds[1]);
+}
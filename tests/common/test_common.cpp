@@ -8,6 +8,15 @@
 #include <chrono>
 #include <common/thread_list.h>
 #include <common/rsa_wrapper.h>
+#include <common/framing.h>
+#include <common/session_ticket.h>
+#include <common/passhash.h>
+#include <common/latency_histogram.h>
+#include <common/concurrency_limit.h>
+#include <common/sha256_lanes.h>
+#include <common/thread_rng.h>
+#include <atomic>
+#include <vector>
 
 // ==================== AESECB Tests ====================
 // Fixture Class for AESEncryption tests
@@ -240,3 +249,280 @@ TEST(RSASerialization, SerializeAndDeserialize) {
     ASSERT_EQ(publicKey.GetModulus(), deserializedKey.GetModulus());
     ASSERT_EQ(publicKey.GetPublicExponent(), deserializedKey.GetPublicExponent());
 }
+
+// ==================== Framing Tests ====================
+
+// Test Case: a complete object is found and leading whitespace is skipped
+TEST(FramingTests, ScanFindsCompleteObject) {
+    std::string data = "  {\"type\":\"text\"}{\"type\":\"info\"}";
+    size_t start;
+    size_t end = Framing::scanJson(data.data(), data.size(), start);
+    EXPECT_EQ(start, 2);
+    EXPECT_EQ(data.substr(start, end - start), "{\"type\":\"text\"}");
+}
+
+// Test Case: braces and escaped quotes inside strings do not end the object
+TEST(FramingTests, ScanIgnoresBracesInStrings) {
+    std::string data = "{\"message\":\"} \\\" {\"}";
+    size_t start;
+    EXPECT_EQ(Framing::scanJson(data.data(), data.size(), start), data.size());
+}
+
+// Test Case: a truncated object is incomplete and non-JSON data is invalid
+TEST(FramingTests, ScanDetectsIncompleteAndInvalid) {
+    std::string partial = "{\"type\":\"te";
+    std::string garbage = "hello";
+    size_t start;
+    EXPECT_EQ(Framing::scanJson(partial.data(), partial.size(), start), Framing::INCOMPLETE);
+    EXPECT_EQ(Framing::scanJson(garbage.data(), garbage.size(), start), Framing::INVALID);
+}
+
+// Test Case: a scan resumed across reads finds the same end as a scan of the whole message
+TEST(FramingTests, ResumedScanMatchesFullScan) {
+    std::string data = "  {\"message\":\"a \\\" } b\"}";
+    Framing::JsonScanState state;
+    size_t start;
+    size_t end = Framing::INCOMPLETE;
+    for (size_t size = 1; size <= data.size() && end == Framing::INCOMPLETE; size++) {
+        end = Framing::scanJson(data.data(), size, start, state);
+    }
+    EXPECT_EQ(end, data.size());
+    EXPECT_EQ(start, 2u);
+}
+
+// Test Case: whitespace left after a message does not shift the scan of the next read
+TEST(FramingTests, TrailingWhitespaceDoesNotAdvanceState) {
+    Framing::JsonScanState state;
+    size_t start;
+    std::string whitespace = "\n";
+    std::string next = "{\"a\":1}";
+    EXPECT_EQ(Framing::scanJson(whitespace.data(), whitespace.size(), start, state), Framing::INCOMPLETE);
+    EXPECT_EQ(Framing::scanJson(next.data(), next.size(), start, state), next.size());
+}
+
+// Test Case: a binary frame round trips and a partial frame is incomplete
+TEST(FramingTests, BinaryFrameRoundTrip) {
+    std::string frame = Framing::encodeBinary("{\"type\":\"text\"}");
+    ASSERT_EQ(frame.size(), Framing::HEADER_SIZE + 15);
+    size_t start;
+    Framing::FrameType type;
+    EXPECT_EQ(Framing::scanBinary(frame.data(), frame.size(), start, type), frame.size());
+    EXPECT_EQ(start, Framing::HEADER_SIZE);
+    EXPECT_EQ(type, Framing::FrameType::Json);
+    EXPECT_EQ(Framing::scanBinary(frame.data(), frame.size() - 1, start, type), Framing::INCOMPLETE);
+}
+
+// Test Case: control frames are recognized and unknown frame types are rejected
+TEST(FramingTests, ControlFrameType) {
+    std::string frame = Framing::encodeBinary("{\"type\":\"join\"}", Framing::FrameType::Control);
+    size_t start;
+    Framing::FrameType type;
+    EXPECT_EQ(Framing::scanBinary(frame.data(), frame.size(), start, type), frame.size());
+    EXPECT_EQ(type, Framing::FrameType::Control);
+    frame[4] = 7;
+    EXPECT_EQ(Framing::scanBinary(frame.data(), frame.size(), start, type), Framing::INVALID);
+}
+
+// ==================== SessionTicket Tests ====================
+
+// Test Case: a ticket answered with its secret resumes the user it was issued for, only for that nonce
+TEST(SessionTicketTests, ProofOfSecretResumesUser) {
+    SessionTicket tickets("server key", std::chrono::seconds(60));
+    SessionTicket::Issued issued = tickets.issue("alice.smith");
+    std::string username;
+    EXPECT_TRUE(tickets.redeem(issued.ticket, "nonce", SessionTicket::proof(issued.secret, "nonce"), username));
+    EXPECT_EQ(username, "alice.smith");
+    EXPECT_FALSE(tickets.redeem(issued.ticket, "other nonce", SessionTicket::proof(issued.secret, "nonce"), username));
+    EXPECT_FALSE(tickets.redeem(issued.ticket, "nonce", SessionTicket::proof(issued.ticket, "nonce"), username));
+}
+
+// Test Case: expired, tampered and foreign tickets are rejected
+TEST(SessionTicketTests, RejectsExpiredOrForgedTickets) {
+    SessionTicket expired("server key", std::chrono::seconds(0));
+    SessionTicket::Issued old = expired.issue("alice");
+    std::string username;
+    EXPECT_FALSE(expired.redeem(old.ticket, "nonce", SessionTicket::proof(old.secret, "nonce"), username));
+
+    SessionTicket tickets("server key", std::chrono::seconds(60));
+    SessionTicket::Issued issued = tickets.issue("alice");
+    std::string forged = issued.ticket;
+    forged[1] ^= 1; // another user
+    EXPECT_FALSE(tickets.redeem(forged, "nonce", SessionTicket::proof(issued.secret, "nonce"), username));
+    EXPECT_FALSE(tickets.redeem("garbage", "nonce", "proof", username));
+    SessionTicket other("other key", std::chrono::seconds(60));
+    EXPECT_FALSE(other.redeem(issued.ticket, "nonce", SessionTicket::proof(issued.secret, "nonce"), username));
+}
+
+// ==================== PasswordHasher Tests ====================
+
+// Test Case: every function verifies its own records, and SHA-256 records keep their original form
+TEST(PasswordHasherTests, VersionedRecordsVerify) {
+    std::string salt = PasswordHasher::GenerateRandomSalt(16);
+    std::string legacy = PasswordHasher::HashPassword("password", salt);
+    EXPECT_EQ(legacy.size(), 96u);
+    EXPECT_EQ(legacy.substr(0, 32), salt);
+    EXPECT_EQ(PasswordHasher::HashPassword("password", salt, PasswordHasher::Kdf()), legacy);
+
+    PasswordHasher::Kdf pbkdf2{PasswordHasher::Algorithm::Pbkdf2Sha256, 1000};
+    PasswordHasher::Kdf scrypt{PasswordHasher::Algorithm::Scrypt, 1024};
+    std::string slow = PasswordHasher::HashPassword("password", salt, pbkdf2);
+    std::string hard = PasswordHasher::HashPassword("password", salt, scrypt);
+    EXPECT_EQ(slow.rfind("$pbkdf2-sha256$1000$" + salt + "$", 0), 0u);
+    EXPECT_EQ(hard.rfind("$scrypt$1024$" + salt + "$", 0), 0u);
+    for (const std::string& record : {legacy, slow, hard}) {
+        EXPECT_TRUE(PasswordHasher::VerifyPassword("password", record));
+        EXPECT_FALSE(PasswordHasher::VerifyPassword("wrong", record));
+    }
+    EXPECT_NE(slow.substr(slow.rfind('$')), hard.substr(hard.rfind('$')));
+
+    PasswordHasher::Kdf kdf;
+    std::string parsedSalt, parsedHash;
+    ASSERT_TRUE(PasswordHasher::ParseRecord(hard, kdf, parsedSalt, parsedHash));
+    EXPECT_EQ(PasswordHasher::FormatRecord(kdf, parsedSalt, parsedHash), hard);
+    EXPECT_FALSE(PasswordHasher::VerifyPassword("password", "$scrypt$1000$" + salt + "$00")); // N not a power of two
+    EXPECT_FALSE(PasswordHasher::VerifyPassword("password", "$argon2$1$" + salt + "$00"));
+    EXPECT_FALSE(PasswordHasher::VerifyPassword("password", "$pbkdf2-sha256$$" + salt + "$00"));
+    EXPECT_FALSE(PasswordHasher::VerifyPassword("password", "short"));
+    EXPECT_THROW(PasswordHasher::HashPassword("password", salt, PasswordHasher::Kdf{PasswordHasher::Algorithm::Pbkdf2Sha256, 0}), std::invalid_argument);
+}
+
+// Test Case: hashes are timed per function
+TEST(PasswordHasherTests, LatencyIsRecordedPerFunction) {
+    PasswordHasher::Kdf pbkdf2{PasswordHasher::Algorithm::Pbkdf2Sha256, 1000};
+    uint64_t slow = PasswordHasher::Latency(PasswordHasher::Algorithm::Pbkdf2Sha256).count();
+    uint64_t hard = PasswordHasher::Latency(PasswordHasher::Algorithm::Scrypt).count();
+    std::string record = PasswordHasher::HashPassword("password", PasswordHasher::GenerateRandomSalt(16), pbkdf2);
+    PasswordHasher::VerifyPassword("password", record);
+    EXPECT_EQ(PasswordHasher::Latency(PasswordHasher::Algorithm::Pbkdf2Sha256).count(), slow + 2);
+    EXPECT_EQ(PasswordHasher::Latency(PasswordHasher::Algorithm::Scrypt).count(), hard);
+}
+
+// Test Case: a batch gives the same verdicts as verifying one by one, whatever the records and password lengths
+TEST(PasswordHasherTests, BatchedVerificationMatchesSingle) {
+    std::vector<std::string> passwords, records;
+    for (size_t length = 0; length < 150; length += 7) { // across the block boundaries (salt included)
+        std::string salt = PasswordHasher::GenerateRandomSalt(16);
+        passwords.push_back(std::string(length, 'a' + length % 26));
+        records.push_back(PasswordHasher::HashPassword(passwords.back(), salt));
+        passwords.push_back(passwords.back() + "x"); // wrong password
+        records.push_back(records.back());
+    }
+    std::string salt = PasswordHasher::GenerateRandomSalt(16);
+    passwords.push_back("password");
+    records.push_back(PasswordHasher::HashPassword("password", salt, PasswordHasher::Kdf{PasswordHasher::Algorithm::Pbkdf2Sha256, 1000}));
+    passwords.push_back("password");
+    records.push_back(PasswordHasher::HashPassword("password", salt).substr(0, 90)); // damaged
+    passwords.push_back("password");
+    records.push_back("short");
+
+    std::vector<PasswordHasher::Candidate> candidates;
+    for (size_t i = 0; i < passwords.size(); i++) {
+        candidates.push_back({passwords[i], records[i]});
+    }
+    std::vector<bool> verdicts = PasswordHasher::VerifyPasswords(candidates);
+    ASSERT_EQ(verdicts.size(), candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) {
+        EXPECT_EQ(verdicts[i], PasswordHasher::VerifyPassword(passwords[i], records[i])) << i;
+    }
+    EXPECT_TRUE(verdicts[0]);
+    EXPECT_FALSE(verdicts[1]);
+    EXPECT_TRUE(verdicts[verdicts.size() - 3]);
+    EXPECT_FALSE(PasswordHasher::IsBatchable(records[records.size() - 3]));
+    EXPECT_TRUE(PasswordHasher::VerifyPasswords({}).empty());
+}
+
+// Test Case: the lanes compute standard SHA-256 digests
+TEST(Sha256LanesTests, KnownDigests) {
+    Sha256Lanes::Message messages[] = {{"abc", ""}, {"", ""}, {"ab", "c"}, {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", ""}};
+    unsigned char digests[4 * Sha256Lanes::DIGEST_SIZE];
+    Sha256Lanes::hash(messages, 4, digests);
+    auto hex = [&digests](size_t i) {
+        static const char digits[] = "0123456789abcdef";
+        std::string text;
+        for (size_t j = 0; j < Sha256Lanes::DIGEST_SIZE; j++) {
+            text += digits[digests[i * Sha256Lanes::DIGEST_SIZE + j] >> 4];
+            text += digits[digests[i * Sha256Lanes::DIGEST_SIZE + j] & 0x0f];
+        }
+        return text;
+    };
+    EXPECT_EQ(hex(0), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_EQ(hex(1), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    EXPECT_EQ(hex(2), hex(0));
+    EXPECT_EQ(hex(3), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+// ==================== ThreadRng Tests ====================
+
+// Test Case: each thread keeps one generator, reseeded once it produced enough
+TEST(ThreadRngTests, OneGeneratorPerThreadReseeded) {
+    ThreadRng* mine = &ThreadRng::get();
+    EXPECT_EQ(&ThreadRng::get(), mine);
+    ThreadRng* other = nullptr;
+    uint64_t reseeds = 0;
+    std::string first(32, '\0'), second(32, '\0');
+    std::thread thread([&]() {
+        ThreadRng& rng = ThreadRng::get();
+        other = &rng;
+        std::vector<CryptoPP::byte> block(ThreadRng::RESEED_BYTES / 4);
+        for (int i = 0; i < 4; i++) {
+            rng.GenerateBlock(block.data(), block.size());
+        }
+        EXPECT_EQ(rng.reseeds(), 0u);
+        rng.GenerateBlock(reinterpret_cast<CryptoPP::byte*>(&first[0]), first.size()); // due now
+        rng.GenerateBlock(reinterpret_cast<CryptoPP::byte*>(&second[0]), second.size());
+        reseeds = rng.reseeds();
+    });
+    thread.join();
+    EXPECT_NE(other, mine);
+    EXPECT_EQ(reseeds, 1u);
+    EXPECT_NE(first, second);
+    EXPECT_NE(PasswordHasher::GenerateRandomSalt(16), PasswordHasher::GenerateRandomSalt(16));
+}
+
+// ==================== Latency Histogram Tests ====================
+
+// Test Case: durations land in power of two buckets and percentiles report their bucket's bound
+TEST(LatencyHistogramTests, PercentilesUseBucketBounds) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.percentile(0.5).count(), 0);
+    for (int i = 0; i < 90; i++) {
+        histogram.record(std::chrono::microseconds(100)); // bucket 7, up to 127us
+    }
+    for (int i = 0; i < 10; i++) {
+        histogram.record(std::chrono::milliseconds(5)); // bucket 13, up to 8191us
+    }
+    EXPECT_EQ(histogram.count(), 100u);
+    EXPECT_EQ(histogram.bucket(7), 90u);
+    EXPECT_EQ(histogram.bucket(13), 10u);
+    EXPECT_EQ(histogram.mean().count(), 590);
+    EXPECT_EQ(histogram.percentile(0.5).count(), 127);
+    EXPECT_EQ(histogram.percentile(0.9).count(), 127);
+    EXPECT_EQ(histogram.percentile(0.99).count(), 8191);
+}
+
+// ==================== Concurrency Limit Tests ====================
+
+// Test Case: no more callers than the limit hold a slot at once, and all of them get one
+TEST(ConcurrencyLimitTests, CallersBeyondTheLimitWait) {
+    ConcurrencyLimit limit(2);
+    std::atomic<int> inside(0), most(0), done(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&]() {
+            ConcurrencyLimit::Slot slot(limit);
+            int now = ++inside;
+            int seen = most;
+            while (now > seen && !most.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            inside--;
+            done++;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(done, 8);
+    EXPECT_LE(most, 2);
+    EXPECT_EQ(limit.active(), 0u);
+    EXPECT_EQ(limit.waiting(), 0u);
+}
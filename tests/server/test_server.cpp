@@ -1,21 +1,56 @@
 #include <server/socket_server.h>
 #include <gtest/gtest.h>
 #include <server/userhandler.h>
+#include <server/user_database.h>
+#include <server/bloom_filter.h>
+#include <server/file_watcher.h>
+#include <server/timer_wheel.h>
+#include <server/input_buffer.h>
+#include <server/output_queue.h>
+#include <server/reactor.h>
+#include <server/worker_pool.h>
+#include <server/verify_batcher.h>
+#include <server/session_registry.h>
+#include <server/lobby.h>
+#include <server/room.h>
+#include <server/presence_index.h>
+#include <server/offline_store.h>
+#include <server/token_bucket.h>
+#include <server/connection.h>
+#include <thread>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <common/passhash.h>
+#include <common/framing.h>
+#include <common/rsa_wrapper.h>
 #include <fstream>
+#include <set>
+
+using json = nlohmann::json;
 
 // test fixture for socket server
 class SocketServerTest : public ::testing::Test {
 protected:
     Server *server;
+    std::string directory; // the server's files, removed afterwards
 
     SocketServerTest() {
+        char path[] = "/tmp/socket_server_testXXXXXX";
+        directory = mkdtemp(path);
+        ServerConfig config;
+        config.usersFile = directory + "/users.txt";
+        config.usersDatabase = directory + "/users.db";
+        config.offlineDirectory = directory + "/offline";
         // initialize with a test port
-        server = new Server(4444);
+        server = new Server(4444, config);
     }
 
     ~SocketServerTest() override {
         delete server;
+        std::string command = "rm -rf " + directory;
+        EXPECT_EQ(system(command.c_str()), 0);
     }
 };
 
@@ -30,11 +65,23 @@ TEST_F(SocketServerTest, ServerStartsAndStops) {
     ASSERT_TRUE(server->isRunning);  // assert server is running  
 }
 
+// Test Case: shutdown wakes the idle reactors and run() returns well before the drain timeout
+TEST_F(SocketServerTest, ShutdownReturnsPromptly) {
+    std::thread thread([this]() { server->run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto start = std::chrono::steady_clock::now();
+    server->shutdown();
+    thread.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_FALSE(server->isRunning);
+}
+
 // ==================== User Handler Tests ====================
 
 class UserHandlerTest : public ::testing::Test {
 protected:
     std::string testFilename = "test_users.txt";
+    std::string testDatabase = "test_users.db";
     UserHandler* userHandler;
 
     void SetUp() override {
@@ -46,14 +93,24 @@ protected:
     void TearDown() override {
         delete userHandler;
         std::remove(testFilename.c_str());
+        std::remove(testDatabase.c_str());
     }
 
-    // helper function to populate the file with initial data
+    // helper function to populate the file with initial data (the handler is re-created to load it)
     void AddUserDirectly(const std::string& username, const std::string& password) {
-        std::ofstream file(testFilename, std::ios::app);
-        std::string salt = PasswordHasher::GenerateRandomSalt(16);
-        std::string saltedHash = PasswordHasher::HashPassword(password, salt);
-        file << username << " " << saltedHash << std::endl;
+        {
+            std::ofstream file(testFilename, std::ios::app);
+            std::string salt = PasswordHasher::GenerateRandomSalt(16);
+            std::string saltedHash = PasswordHasher::HashPassword(password, salt);
+            file << username << " " << saltedHash << std::endl;
+        }
+        Reload();
+    }
+
+    // helper function to load the file again, as a restarted server would
+    void Reload() {
+        delete userHandler;
+        userHandler = new UserHandler(testFilename);
     }
 };
 
@@ -84,3 +141,1045 @@ TEST_F(UserHandlerTest, IncorrectCredentialsReturnsFalse) {
 TEST_F(UserHandlerTest, NonexistentUserReturnsFalse) {
     ASSERT_FALSE(userHandler->VerifyUser("nonexistent", "password"));
 }
+
+// Test Case: added users are written through to the file and found after a reload
+TEST_F(UserHandlerTest, AddedUserSurvivesReload) {
+    ASSERT_TRUE(userHandler->AddUser("newuser", "password123"));
+    Reload();
+    EXPECT_TRUE(userHandler->VerifyUser("newuser", "password123"));
+    EXPECT_FALSE(userHandler->AddUser("newuser", "other"));
+}
+
+// Test Case: lookups are served from the index loaded at startup, not from the file
+TEST_F(UserHandlerTest, LookupsDoNotReadTheFile) {
+    AddUserDirectly("user", "correctpassword");
+    std::remove(testFilename.c_str());
+    EXPECT_TRUE(userHandler->HasUser("user"));
+    EXPECT_TRUE(userHandler->VerifyUser("user", "correctpassword"));
+}
+
+// Test Case: many threads signing up the same names, logging in and checking concurrently
+TEST_F(UserHandlerTest, ConcurrentSignupsTakeEachNameOnce) {
+    const int threads = 8, names = 200;
+    std::atomic<int> added(0), verified(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < names; i++) {
+                std::string name = "user" + std::to_string((i + t * 7) % names);
+                if (userHandler->InsertIfAbsent(name, PasswordHasher::HashPassword("pw", PasswordHasher::GenerateRandomSalt(16)))) {
+                    added++;
+                }
+                if (userHandler->VerifyUser(name, "pw")) {
+                    verified++;
+                }
+                userHandler->HasUser("user" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(added, names);
+    EXPECT_EQ(verified, threads * names); // every name was taken before its taker verified it
+    // the file holds each name once
+    std::ifstream file(testFilename);
+    std::set<std::string> seen;
+    std::string name, hash;
+    int lines = 0;
+    while (file >> name >> hash) {
+        seen.insert(name);
+        lines++;
+    }
+    EXPECT_EQ(lines, names);
+    EXPECT_EQ(seen.size(), static_cast<size_t>(names));
+    Reload();
+    EXPECT_TRUE(userHandler->VerifyUser("user0", "pw"));
+}
+
+// Test Case: the binary database finds every user it was written with
+TEST_F(UserHandlerTest, BinaryDatabaseFindsEveryUser) {
+    std::vector<UserDatabase::Entry> users;
+    for (int i = 0; i < 1000; i++) {
+        users.emplace_back("user" + std::to_string(i), PasswordHasher::HashPassword("pw" + std::to_string(i), PasswordHasher::GenerateRandomSalt(16)));
+    }
+    users.emplace_back("user7", PasswordHasher::HashPassword("other", PasswordHasher::GenerateRandomSalt(16))); // the first entry wins
+    users[1].second = PasswordHasher::HashPassword("pw1", PasswordHasher::GenerateRandomSalt(16), PasswordHasher::Kdf{PasswordHasher::Algorithm::Pbkdf2Sha256, 1000});
+    users[2].second = PasswordHasher::HashPassword("pw2", PasswordHasher::GenerateRandomSalt(16), PasswordHasher::Kdf{PasswordHasher::Algorithm::Scrypt, 1024});
+    UserDatabase::write(testDatabase, users);
+    UserDatabase database(testDatabase);
+    EXPECT_EQ(database.size(), 1000u);
+    for (int i = 0; i < 1000; i++) {
+        auto saltedHash = database.find(users[i].first);
+        ASSERT_TRUE(saltedHash.has_value());
+        EXPECT_EQ(saltedHash.value(), users[i].second);
+        EXPECT_TRUE(PasswordHasher::VerifyPassword("pw" + std::to_string(i), saltedHash.value()));
+    }
+    EXPECT_FALSE(database.find("user1000").has_value());
+    EXPECT_FALSE(database.find("").has_value());
+    size_t visited = 0;
+    database.forEach([&visited](const std::string&, const std::string&) { visited++; });
+    EXPECT_EQ(visited, 1000u);
+}
+
+// Test Case: users in the binary database log in and keep their names, new users go to the users file
+TEST_F(UserHandlerTest, DatabaseUsersLogInAndKeepTheirNames) {
+    UserDatabase::write(testDatabase, {{"olduser", PasswordHasher::HashPassword("oldpassword", PasswordHasher::GenerateRandomSalt(16))}});
+    delete userHandler;
+    userHandler = new UserHandler(testFilename, testDatabase);
+    EXPECT_TRUE(userHandler->VerifyUser("olduser", "oldpassword"));
+    EXPECT_FALSE(userHandler->VerifyUser("olduser", "wrongpassword"));
+    EXPECT_FALSE(userHandler->AddUser("olduser", "newpassword"));
+    EXPECT_TRUE(userHandler->AddUser("newuser", "password123"));
+    std::ifstream file(testFilename);
+    std::string name, hash, rest;
+    ASSERT_TRUE(static_cast<bool>(file >> name >> hash));
+    EXPECT_EQ(name, "newuser");
+    EXPECT_FALSE(static_cast<bool>(file >> rest));
+}
+
+// Test Case: new users are hashed with the configured function, users hashed before keep working
+TEST_F(UserHandlerTest, NewUsersUseTheConfiguredKdf) {
+    AddUserDirectly("olduser", "oldpassword");
+    delete userHandler;
+    userHandler = new UserHandler(testFilename, "", PasswordHasher::Kdf{PasswordHasher::Algorithm::Scrypt, 1024});
+    ASSERT_TRUE(userHandler->AddUser("newuser", "password123"));
+    EXPECT_TRUE(userHandler->VerifyUser("newuser", "password123"));
+    EXPECT_FALSE(userHandler->VerifyUser("newuser", "wrongpassword"));
+    EXPECT_TRUE(userHandler->VerifyUser("olduser", "oldpassword"));
+    std::ifstream file(testFilename);
+    std::string name, hash;
+    file >> name >> hash >> name >> hash;
+    EXPECT_EQ(name, "newuser");
+    EXPECT_EQ(hash.rfind("$scrypt$1024$", 0), 0u);
+    EXPECT_THROW(UserHandler(testFilename, "", PasswordHasher::Kdf{PasswordHasher::Algorithm::Scrypt, 1000}), std::invalid_argument);
+}
+
+// Test Case: damaged databases and salted hashes that cannot be stored are rejected
+TEST_F(UserHandlerTest, InvalidDatabaseIsRejected) {
+    EXPECT_THROW(UserDatabase::write(testDatabase, {{"user", "not a salted hash"}}), std::runtime_error);
+    {
+        std::ofstream junk(testDatabase, std::ios::trunc);
+        junk << std::string(200, 'x');
+    }
+    EXPECT_THROW(UserDatabase database(testDatabase), std::runtime_error);
+    EXPECT_THROW(UserHandler(testFilename, testDatabase), std::runtime_error);
+}
+
+// Test Case: unknown usernames are answered by the Bloom filter and counted
+TEST_F(UserHandlerTest, UnknownUsersAreFiltered) {
+    AddUserDirectly("user", "correctpassword");
+    ASSERT_TRUE(userHandler->AddUser("newuser", "password123"));
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_FALSE(userHandler->HasUser("bot" + std::to_string(i)));
+    }
+    EXPECT_TRUE(userHandler->VerifyUser("user", "correctpassword"));
+    EXPECT_TRUE(userHandler->VerifyUser("newuser", "password123"));
+    UserHandler::FilterStats stats = userHandler->GetFilterStats();
+    EXPECT_EQ(stats.lookups, 1003u); // AddUser looked newuser up once
+    EXPECT_GE(stats.rejected, 950u);
+    EXPECT_LE(stats.rejected, 1001u);
+}
+
+// Test Case: users appended to the file by others are added by a refresh, which reads only complete new lines
+TEST_F(UserHandlerTest, AppendedUsersAreRefreshed) {
+    AddUserDirectly("user", "correctpassword");
+    ASSERT_TRUE(userHandler->AddUser("newuser", "password123"));
+    EXPECT_EQ(userHandler->Refresh(), 0u); // its own line is read back and skipped
+    std::string saltedHash = PasswordHasher::HashPassword("operatorpassword", PasswordHasher::GenerateRandomSalt(16));
+    {
+        std::ofstream file(testFilename, std::ios::app);
+        file << "operator " << saltedHash.substr(0, 40) << std::flush; // cut short, still being written
+    }
+    EXPECT_EQ(userHandler->Refresh(), 0u);
+    EXPECT_FALSE(userHandler->HasUser("operator"));
+    {
+        std::ofstream file(testFilename, std::ios::app);
+        file << saltedHash.substr(40) << std::endl << std::endl << "user " << saltedHash << std::endl; // a blank line, and a name taken earlier
+    }
+    EXPECT_EQ(userHandler->Refresh(), 1u);
+    EXPECT_TRUE(userHandler->VerifyUser("operator", "operatorpassword"));
+    EXPECT_TRUE(userHandler->VerifyUser("user", "correctpassword")); // the first line wins
+    EXPECT_TRUE(userHandler->VerifyUser("newuser", "password123"));
+    EXPECT_EQ(userHandler->Refresh(), 0u);
+}
+
+// Test Case: users picked up after a blank or malformed line, and users added after them, are still there after a restart
+TEST_F(UserHandlerTest, RefreshedUsersSurviveARestart) {
+    AddUserDirectly("user", "correctpassword");
+    std::string saltedHash = PasswordHasher::HashPassword("operatorpassword", PasswordHasher::GenerateRandomSalt(16));
+    {
+        std::ofstream file(testFilename, std::ios::app);
+        file << std::endl << "garbage" << std::endl << "operator " << saltedHash << std::endl;
+    }
+    EXPECT_EQ(userHandler->Refresh(), 1u);
+    ASSERT_TRUE(userHandler->AddUser("newuser", "password123"));
+    Reload(); // a restarted server reads the same lines the same way
+    EXPECT_TRUE(userHandler->VerifyUser("user", "correctpassword"));
+    EXPECT_TRUE(userHandler->VerifyUser("operator", "operatorpassword"));
+    EXPECT_TRUE(userHandler->VerifyUser("newuser", "password123"));
+    EXPECT_FALSE(userHandler->HasUser("garbage"));
+}
+
+// Test Case: usernames the users file cannot hold are refused, so they are never read back as another user
+TEST_F(UserHandlerTest, UsernamesWithWhitespaceAreRejected) {
+    EXPECT_FALSE(userHandler->AddUser("alice x", "password123"));
+    EXPECT_FALSE(userHandler->AddUser("bob\nmallory", "password123"));
+    EXPECT_FALSE(userHandler->AddUser("tab\tname", "password123"));
+    EXPECT_FALSE(userHandler->AddUser("", "password123"));
+    EXPECT_EQ(userHandler->Refresh(), 0u);
+    EXPECT_FALSE(userHandler->HasUser("alice"));
+    EXPECT_TRUE(userHandler->AddUser("alice", "password123"));
+}
+
+// Test Case: a file replaced by a longer one is read again from the start, not from the middle of a line
+TEST_F(UserHandlerTest, ReplacedFileIsReadAgain) {
+    AddUserDirectly("user", "correctpassword");
+    EXPECT_EQ(userHandler->Refresh(), 0u);
+    std::string saltedHash = PasswordHasher::HashPassword("operatorpassword", PasswordHasher::GenerateRandomSalt(16));
+    std::string replacement = testFilename + ".new";
+    {
+        std::ifstream current(testFilename);
+        std::ofstream file(replacement);
+        file << "operator " << saltedHash << std::endl << current.rdbuf(); // the old offset falls inside the first line
+    }
+    ASSERT_EQ(std::rename(replacement.c_str(), testFilename.c_str()), 0);
+    EXPECT_EQ(userHandler->Refresh(), 1u);
+    EXPECT_TRUE(userHandler->VerifyUser("operator", "operatorpassword"));
+    EXPECT_TRUE(userHandler->VerifyUser("user", "correctpassword"));
+    EXPECT_EQ(userHandler->Refresh(), 0u);
+}
+
+// ==================== File Watcher Tests ====================
+
+// Test Case: writing to the watched file calls back, writing to another file of its directory does not
+TEST(FileWatcherTest, WritesAreReported) {
+    std::string path = "test_watched.txt";
+    std::remove(path.c_str());
+    std::atomic<int> changes(0);
+    {
+        FileWatcher watcher(path, [&changes]() { changes++; });
+        std::ofstream("test_unwatched.txt") << "other" << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        EXPECT_EQ(changes, 0);
+        std::ofstream(path, std::ios::app) << "line" << std::endl;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (changes == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_GE(changes, 1);
+    }
+    EXPECT_THROW(FileWatcher("no_such_directory/file.txt", []() {}), std::runtime_error);
+    std::remove(path.c_str());
+    std::remove("test_unwatched.txt");
+}
+
+// ==================== Bloom Filter Tests ====================
+
+// Test Case: added items are always found and others rarely are
+TEST(BloomFilterTest, NoFalseNegativesFewFalsePositives) {
+    BloomFilter filter(10000);
+    for (int i = 0; i < 10000; i++) {
+        filter.add("user" + std::to_string(i));
+    }
+    for (int i = 0; i < 10000; i++) {
+        ASSERT_TRUE(filter.mayContain("user" + std::to_string(i)));
+    }
+    int falsePositives = 0;
+    for (int i = 0; i < 10000; i++) {
+        falsePositives += filter.mayContain("guess" + std::to_string(i));
+    }
+    EXPECT_LT(falsePositives, 300); // about 1% expected at capacity
+}
+
+// ==================== Timer Wheel Tests ====================
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+    TimerWheel::Clock::time_point start = TimerWheel::Clock::now();
+    TimerWheel wheel{std::chrono::milliseconds(10), start};
+};
+
+// Test Case: a timer fires once its delay has passed, not before
+TEST_F(TimerWheelTest, TimerFiresAfterDelay) {
+    TimerWheel::Timer timer;
+    int fired = 0;
+    timer.callback = [&fired]() { fired++; };
+    wheel.schedule(timer, std::chrono::milliseconds(50));
+    wheel.advance(start + std::chrono::milliseconds(30));
+    EXPECT_EQ(fired, 0);
+    wheel.advance(start + std::chrono::milliseconds(200));
+    EXPECT_EQ(fired, 1);
+    EXPECT_FALSE(timer.isScheduled());
+}
+
+// Test Case: a cancelled timer never fires
+TEST_F(TimerWheelTest, CancelledTimerDoesNotFire) {
+    TimerWheel::Timer timer;
+    int fired = 0;
+    timer.callback = [&fired]() { fired++; };
+    wheel.schedule(timer, std::chrono::milliseconds(20));
+    timer.cancel();
+    wheel.advance(start + std::chrono::milliseconds(200));
+    EXPECT_EQ(fired, 0);
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+// Test Case: timers far in the future cascade down the levels and still fire on time
+TEST_F(TimerWheelTest, LongTimerCascades) {
+    TimerWheel::Timer timer;
+    int fired = 0;
+    timer.callback = [&fired]() { fired++; };
+    wheel.schedule(timer, std::chrono::minutes(10)); // beyond the first two levels
+    wheel.advance(start + std::chrono::minutes(9));
+    EXPECT_EQ(fired, 0);
+    wheel.advance(start + std::chrono::minutes(11));
+    EXPECT_EQ(fired, 1);
+}
+
+// Test Case: rescheduling replaces the previous deadline
+TEST_F(TimerWheelTest, RescheduleMovesDeadline) {
+    TimerWheel::Timer timer;
+    int fired = 0;
+    timer.callback = [&fired]() { fired++; };
+    wheel.schedule(timer, std::chrono::milliseconds(20));
+    wheel.schedule(timer, std::chrono::seconds(5));
+    wheel.advance(start + std::chrono::seconds(1));
+    EXPECT_EQ(fired, 0);
+    EXPECT_EQ(wheel.size(), 1u);
+}
+
+// ==================== Input Buffer Tests ====================
+
+// Test Case: appended data is kept until it is consumed
+TEST(InputBufferTest, AppendAndConsume) {
+    InputBuffer buffer;
+    buffer.append("hello ", 6);
+    buffer.append("world", 5);
+    ASSERT_EQ(buffer.size(), 11u);
+    EXPECT_EQ(std::string(buffer.data(), buffer.size()), "hello world");
+    buffer.consume(6);
+    EXPECT_EQ(std::string(buffer.data(), buffer.size()), "world");
+    buffer.consume(5);
+    EXPECT_TRUE(buffer.empty());
+}
+
+// Test Case: a large message grows the buffer, which is freed once drained
+TEST(InputBufferTest, LargeBufferIsReleased) {
+    InputBuffer buffer;
+    std::string chunk(100 * 1024, 'x');
+    buffer.append(chunk.data(), chunk.size());
+    char* target = buffer.prepare(chunk.size());
+    std::memcpy(target, chunk.data(), chunk.size());
+    buffer.commit(chunk.size());
+    EXPECT_EQ(buffer.size(), 2 * chunk.size());
+    EXPECT_GE(buffer.capacity(), 2 * chunk.size());
+    buffer.consume(buffer.size());
+    EXPECT_EQ(buffer.capacity(), 0u);
+}
+
+// ==================== Output Queue Tests ====================
+
+class OutputQueueTest : public ::testing::Test {
+protected:
+    int fds[2];
+
+    void SetUp() override {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    }
+
+    void TearDown() override {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    std::string readAll(size_t size) {
+        std::string data(size, '\0');
+        size_t got = 0;
+        while (got < size) {
+            ssize_t n = read(fds[1], &data[got], size - got);
+            if (n <= 0) {
+                break;
+            }
+            got += static_cast<size_t>(n);
+        }
+        data.resize(got);
+        return data;
+    }
+};
+
+// Test Case: queued chunks are written in order and the queue is emptied
+TEST_F(OutputQueueTest, FlushWritesChunksInOrder) {
+    OutputQueue queue;
+    auto shared = std::make_shared<const std::string>("shared buffer");
+    queue.push("first ");
+    queue.push(shared, shared->data(), 6);
+    EXPECT_EQ(queue.size(), 12u);
+    EXPECT_EQ(queue.chunks(), 2u);
+    ASSERT_TRUE(queue.flush(fds[0]));
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(readAll(12), "first shared");
+}
+
+// Test Case: data the socket does not accept stays queued until the reader catches up
+TEST_F(OutputQueueTest, FullSocketKeepsRemainder) {
+    OutputQueue queue;
+    std::string chunk(64 * 1024, 'x');
+    for (int i = 0; i < 64; i++) {
+        queue.push(chunk);
+    }
+    ASSERT_TRUE(queue.flush(fds[0]));
+    ASSERT_FALSE(queue.empty());
+    size_t total = 64 * chunk.size();
+    size_t written = total - queue.size();
+    EXPECT_EQ(readAll(written).size(), written);
+    while (!queue.empty()) {
+        size_t before = queue.size();
+        ASSERT_TRUE(queue.flush(fds[0]));
+        readAll(before - queue.size());
+    }
+    EXPECT_EQ(queue.size(), 0u);
+}
+
+// ==================== Reactor Tests ====================
+
+// Test Case: a task posted from another thread wakes the reactor and runs on its thread
+TEST(ReactorTest, PostedTaskRunsOnReactorThread) {
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(listenSocket, -1);
+    Reactor reactor(listenSocket, std::chrono::milliseconds(10));
+    std::atomic<bool> running(true);
+    std::thread::id taskThread;
+    std::thread thread([&]() { reactor.run(running); });
+    std::thread::id reactorThread = thread.get_id();
+    reactor.post([&]() {
+        taskThread = std::this_thread::get_id();
+        running = false;
+    });
+    thread.join(); // returns only if the task woke the loop, nothing else is scheduled
+    EXPECT_EQ(taskThread, reactorThread);
+}
+
+// Test Case: stop() from a task makes run() return even though the running flag is still set
+TEST(ReactorTest, StopReturnsFromRun) {
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(listenSocket, -1);
+    Reactor reactor(listenSocket, std::chrono::milliseconds(10));
+    std::atomic<bool> running(true);
+    std::thread thread([&]() { reactor.run(running); });
+    reactor.post([&]() { reactor.stop(); });
+    thread.join();
+    EXPECT_TRUE(running);
+}
+
+// ==================== Worker Pool Tests ====================
+
+// Test Case: every submitted job runs on a pool thread
+TEST(WorkerPoolTest, RunsSubmittedJobs) {
+    std::atomic<int> done(0);
+    {
+        WorkerPool pool(4, 100);
+        for (int i = 0; i < 100; i++) {
+            ASSERT_TRUE(pool.submit([&done]() { done++; }));
+        }
+        while (done < 100) {
+            std::this_thread::yield();
+        }
+    }
+    EXPECT_EQ(done, 100);
+}
+
+// Test Case: a full queue turns jobs away instead of growing
+TEST(WorkerPoolTest, FullQueueRejectsJobs) {
+    std::mutex gate;
+    gate.lock(); // keeps the only thread busy
+    std::atomic<bool> started(false);
+    WorkerPool pool(1, 2);
+    ASSERT_TRUE(pool.submit([&]() { started = true; std::lock_guard<std::mutex> wait(gate); }));
+    while (!started) {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(pool.submit([]() {}));
+    EXPECT_TRUE(pool.submit([]() {}));
+    EXPECT_FALSE(pool.submit([]() {}));
+    EXPECT_EQ(pool.pending(), 2u);
+    gate.unlock();
+}
+
+// ==================== Verify Batcher Tests ====================
+
+// Test Case: passwords handed over while a batch is checked wait for the next batch, slow functions are checked at once
+TEST(VerifyBatcherTest, WaitingPasswordsAreCheckedTogether) {
+    std::string salt = PasswordHasher::GenerateRandomSalt(16);
+    std::string record = PasswordHasher::HashPassword("password", salt);
+    VerifyBatcher batcher(4);
+    std::mutex gate;
+    gate.lock(); // holds the first verdict, and with it the worker checking batches
+    std::atomic<bool> checking(false);
+    std::atomic<int> accepted(0), rejected(0);
+    auto count = [&](bool verified) { verified ? accepted++ : rejected++; };
+    std::thread first([&]() {
+        batcher.verify("password", record, [&](bool verified) { checking = true; std::lock_guard<std::mutex> wait(gate); count(verified); });
+    });
+    while (!checking) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 6; i++) {
+        batcher.verify(i % 2 ? "password" : "wrong", record, count); // queued, returns at once
+    }
+    EXPECT_EQ(accepted + rejected, 0);
+    bool slow = false;
+    batcher.verify("password", PasswordHasher::HashPassword("password", salt, PasswordHasher::Kdf{PasswordHasher::Algorithm::Pbkdf2Sha256, 1000}), [&](bool verified) { slow = verified; });
+    EXPECT_TRUE(slow);
+    gate.unlock();
+    first.join();
+    EXPECT_EQ(accepted, 4);
+    EXPECT_EQ(rejected, 3);
+    EXPECT_EQ(batcher.batched(), 7u);
+    EXPECT_EQ(batcher.batches(), 3u); // 1, then 4 and 2
+}
+
+// ==================== Session Registry Tests ====================
+
+// Test Case: a handle stops resolving once its connection is removed, even after the slot is reused
+TEST(SessionRegistryTest, StaleHandleDoesNotResolve) {
+    SessionRegistry registry;
+    SessionRegistry::Handle first = registry.insert(std::make_unique<Connection>(10, nullptr));
+    ASSERT_NE(registry.get(first), nullptr);
+    EXPECT_EQ(registry.get(first)->handle, first);
+    EXPECT_TRUE(registry.erase(first));
+    EXPECT_FALSE(registry.erase(first));
+    SessionRegistry::Handle second = registry.insert(std::make_unique<Connection>(10, nullptr));
+    EXPECT_NE(first, second);
+    EXPECT_EQ(registry.get(first), nullptr);
+    EXPECT_NE(registry.get(second), nullptr);
+    EXPECT_EQ(registry.capacity(), 1u);
+}
+
+// Test Case: a million connect/disconnect cycles reuse the same slots, memory stays flat
+TEST(SessionRegistryTest, SoakKeepsMemoryFlat) {
+    SessionRegistry registry;
+    const size_t live = 64;
+    std::vector<SessionRegistry::Handle> handles;
+    for (size_t i = 0; i < live; i++) {
+        handles.push_back(registry.insert(std::make_unique<Connection>(static_cast<int>(i), nullptr)));
+    }
+    for (size_t cycle = 0; cycle < 1000000; cycle++) {
+        size_t victim = cycle % live;
+        ASSERT_TRUE(registry.erase(handles[victim]));
+        handles[victim] = registry.insert(std::make_unique<Connection>(static_cast<int>(victim), nullptr));
+    }
+    EXPECT_EQ(registry.size(), live);
+    EXPECT_EQ(registry.capacity(), live);
+    size_t visited = 0;
+    registry.forEach([&visited](Connection&) { visited++; });
+    EXPECT_EQ(visited, live);
+    registry.clear();
+    EXPECT_EQ(registry.size(), 0u);
+}
+
+// ==================== Lobby Tests ====================
+
+// Test Case: clients are paired in arrival order and clients that left are skipped
+TEST(LobbyTest, PairsInOrderSkippingClientsThatLeft) {
+    Lobby lobby(8);
+    Lobby::Match match;
+    auto first = lobby.enter(nullptr, 1);
+    EXPECT_FALSE(lobby.match(match));
+    auto second = lobby.enter(nullptr, 2);
+    auto third = lobby.enter(nullptr, 3);
+    lobby.leave(second);
+    EXPECT_EQ(lobby.waiting(), 2u);
+    ASSERT_TRUE(lobby.match(match));
+    EXPECT_EQ(match.waiting.handle, 1u);
+    EXPECT_EQ(match.joining.handle, 3u);
+    EXPECT_FALSE(lobby.match(match));
+    EXPECT_EQ(lobby.waiting(), 0u);
+    EXPECT_EQ(lobby.matches(), 1u);
+}
+
+// Test Case: a full lobby turns clients away until someone leaves
+TEST(LobbyTest, FullLobbyRejectsClients) {
+    Lobby lobby(2);
+    auto first = lobby.enter(nullptr, 1);
+    auto second = lobby.enter(nullptr, 2);
+    ASSERT_TRUE(first && second);
+    EXPECT_EQ(lobby.enter(nullptr, 3), nullptr);
+    Lobby::Match match;
+    ASSERT_TRUE(lobby.match(match));
+    EXPECT_NE(lobby.enter(nullptr, 4), nullptr);
+}
+
+// Test Case: clients entering from many threads are all paired exactly once
+TEST(LobbyTest, ConcurrentClientsAreAllPaired) {
+    const size_t threadCount = 8;
+    const size_t perThread = 20000;
+    Lobby lobby(1024);
+    std::vector<std::atomic<int>> seen(threadCount * perThread);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&lobby, &seen, t, perThread]() {
+            Lobby::Match match;
+            for (size_t i = 0; i < perThread; i++) {
+                auto ticket = lobby.enter(nullptr, t * perThread + i);
+                ASSERT_NE(ticket, nullptr);
+                while (lobby.match(match)) {
+                    seen[match.waiting.handle]++;
+                    seen[match.joining.handle]++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(lobby.waiting(), 0u);
+    EXPECT_EQ(lobby.matches(), threadCount * perThread / 2);
+    for (auto& count : seen) {
+        EXPECT_EQ(count.load(), 1);
+    }
+}
+
+// ==================== Room Tests ====================
+
+// Test Case: removing a member keeps the other members' positions valid
+TEST(RoomTest, RemoveKeepsIndexesConsistent) {
+    Room room("lounge");
+    std::vector<std::unique_ptr<Connection>> members;
+    for (int i = 0; i < 5; i++) {
+        members.push_back(std::make_unique<Connection>(i, nullptr));
+        room.add(*members.back());
+    }
+    room.remove(*members[1]);
+    room.remove(*members[1]); // not a member anymore, ignored
+    room.remove(*members[4]);
+    ASSERT_EQ(room.size(), 3u);
+    for (size_t i = 0; i < room.size(); i++) {
+        EXPECT_EQ(room.members()[i]->roomIndex, i);
+    }
+    EXPECT_FALSE(room.isPair());
+    EXPECT_TRUE(Room().isPair());
+}
+
+// Test Case: a message is framed once per framing and the copy is shared
+TEST(RoomTest, SharedFrameBuildsOneCopyPerFraming) {
+    std::string payload = "{\"type\":\"text\"}";
+    SharedFrame message(payload.data(), payload.size());
+    const auto& json = message.framed(false);
+    EXPECT_EQ(*json, payload + "\n");
+    EXPECT_EQ(message.framed(false).get(), json.get());
+    EXPECT_EQ(*message.framed(true), Framing::encodeBinary(payload));
+}
+
+// ==================== Presence Index Tests ====================
+
+// Test Case: a user is found by name while logged in, and a stale session cannot log out a newer one
+TEST(PresenceIndexTest, NewestSessionWins) {
+    PresenceIndex index(4);
+    PresenceIndex::Session first{nullptr, 1};
+    PresenceIndex::Session second{nullptr, 2};
+    PresenceIndex::Session found;
+    EXPECT_FALSE(index.find("alice", found));
+    index.setOnline("alice", first);
+    index.setOnline("alice", second);
+    ASSERT_TRUE(index.find("alice", found));
+    EXPECT_EQ(found.handle, 2u);
+    index.setOffline("alice", first);
+    EXPECT_TRUE(index.find("alice", found));
+    index.relocate("alice", second, PresenceIndex::Session{nullptr, 3});
+    ASSERT_TRUE(index.find("alice", found));
+    EXPECT_EQ(found.handle, 3u);
+    index.setOffline("alice", PresenceIndex::Session{nullptr, 3});
+    EXPECT_FALSE(index.find("alice", found));
+    EXPECT_EQ(index.online(), 0u);
+}
+
+// Test Case: a user logged in twice stays online, and reachable, until both sessions closed
+TEST(PresenceIndexTest, OnlineUntilLastSessionCloses) {
+    PresenceIndex index(4);
+    PresenceIndex::Session watcher{nullptr, 7};
+    PresenceIndex::Session older{nullptr, 1};
+    PresenceIndex::Session newer{nullptr, 2};
+    PresenceIndex::Session found;
+    index.watch("alice", watcher);
+    EXPECT_EQ(index.setOnline("alice", older).size(), 1u);
+    EXPECT_TRUE(index.setOnline("alice", newer).empty()); // already online
+    EXPECT_TRUE(index.setOffline("alice", newer).empty()); // the older session is still connected
+    ASSERT_TRUE(index.find("alice", found));
+    EXPECT_EQ(found.handle, 1u);
+    EXPECT_EQ(index.online(), 1u);
+    auto told = index.setOffline("alice", older);
+    ASSERT_EQ(told.size(), 1u);
+    EXPECT_EQ(told[0].handle, 7u);
+    EXPECT_FALSE(index.find("alice", found));
+}
+
+// Test Case: watchers are returned for every change until they stop watching
+TEST(PresenceIndexTest, WatchersAreReturnedForChanges) {
+    PresenceIndex index(4);
+    PresenceIndex::Session watcher{nullptr, 7};
+    PresenceIndex::Session bob{nullptr, 8};
+    EXPECT_FALSE(index.watch("bob", watcher));
+    auto told = index.setOnline("bob", bob);
+    ASSERT_EQ(told.size(), 1u);
+    EXPECT_EQ(told[0].handle, 7u);
+    EXPECT_TRUE(index.watch("bob", watcher)); // watching twice does not tell twice
+    index.relocateWatcher("bob", watcher, PresenceIndex::Session{nullptr, 9});
+    told = index.setOffline("bob", bob);
+    ASSERT_EQ(told.size(), 1u);
+    EXPECT_EQ(told[0].handle, 9u);
+    index.unwatch("bob", PresenceIndex::Session{nullptr, 9});
+    EXPECT_TRUE(index.setOnline("bob", bob).empty());
+}
+
+// ==================== Token Bucket Tests ====================
+
+// Test Case: a burst passes at once, then work is let through at the rate, and a large cost is paid back as debt
+TEST(TokenBucketTest, BurstThenRateWithDebt) {
+    using namespace std::chrono;
+    TokenBucket bucket(10, 3);
+    TokenBucket::Clock::time_point now = TokenBucket::Clock::now();
+    int passed = 0;
+    while (bucket.ready(now)) {
+        bucket.consume(1);
+        passed++;
+    }
+    EXPECT_EQ(passed, 4); // 3 tokens, the last message goes into debt
+    EXPECT_EQ(duration_cast<milliseconds>(bucket.delay()).count(), 100);
+    EXPECT_FALSE(bucket.ready(now + milliseconds(50)));
+    EXPECT_TRUE(bucket.ready(now + milliseconds(100)));
+    bucket.consume(20); // larger than the burst
+    EXPECT_FALSE(bucket.ready(now + milliseconds(1000)));
+    EXPECT_TRUE(bucket.ready(now + milliseconds(2100)));
+    TokenBucket unlimited;
+    unlimited.consume(1e9);
+    EXPECT_FALSE(unlimited.limited());
+    EXPECT_TRUE(unlimited.ready(now));
+}
+
+// ==================== Offline Store Tests ====================
+
+class OfflineStoreTest : public ::testing::Test {
+protected:
+    std::string directory;
+
+    void SetUp() override {
+        char path[] = "/tmp/offline_store_testXXXXXX";
+        directory = mkdtemp(path);
+    }
+
+    void TearDown() override {
+        std::string command = "rm -rf " + directory;
+        ASSERT_EQ(system(command.c_str()), 0);
+    }
+
+    static std::string text(const OfflineStore::Message& message) {
+        return std::string(message.data, message.size);
+    }
+};
+
+// Test Case: messages are handed back in order, once, and survive reopening the store
+TEST_F(OfflineStoreTest, MessagesSurviveRestartUntilDelivered) {
+    {
+        OfflineStore store(directory, 4096, std::chrono::milliseconds(10), 100);
+        EXPECT_TRUE(store.append("bob", "first", 5));
+        EXPECT_TRUE(store.append("carol", "hello", 5));
+        EXPECT_TRUE(store.append("bob", "second", 6));
+        auto messages = store.take("bob");
+        ASSERT_EQ(messages.size(), 2u);
+        EXPECT_EQ(text(messages[0]), "first");
+        EXPECT_EQ(text(messages[1]), "second");
+        EXPECT_TRUE(store.take("bob").empty());
+        EXPECT_TRUE(store.append("bob", "third", 5));
+    }
+    OfflineStore store(directory, 4096, std::chrono::milliseconds(10), 100);
+    EXPECT_EQ(store.pending("carol"), 1u);
+    auto messages = store.take("bob");
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(text(messages[0]), "third");
+}
+
+// Test Case: the log rolls over to new segments and drops them once delivered, taken messages stay readable
+TEST_F(OfflineStoreTest, DeliveredSegmentsAreDeleted) {
+    OfflineStore store(directory, 256, std::chrono::milliseconds(10), 1000);
+    std::string payload(100, 'x');
+    for (int i = 0; i < 20; i++) {
+        ASSERT_TRUE(store.append(i % 2 == 0 ? "bob" : "carol", payload.data(), payload.size()));
+    }
+    EXPECT_EQ(store.segmentCount(), 10u); // two messages per segment
+    EXPECT_FALSE(store.append("bob", std::string(300, 'x').data(), 300)); // larger than a segment
+    auto bob = store.take("bob");
+    EXPECT_EQ(store.segmentCount(), 10u); // every segment still holds a message for carol
+    auto carol = store.take("carol");
+    EXPECT_EQ(store.segmentCount(), 1u);
+    ASSERT_EQ(bob.size(), 10u);
+    EXPECT_EQ(text(bob[9]), payload);
+}
+
+// Test Case: messages nobody collects are copied forward instead of keeping every segment after theirs, and keep their order after a restart
+TEST_F(OfflineStoreTest, PinnedSegmentIsCompacted) {
+    {
+        OfflineStore store(directory, 256, std::chrono::milliseconds(10), 1000);
+        ASSERT_TRUE(store.append("dave", "first", 5));
+        ASSERT_TRUE(store.append("dave", "second", 6));
+        std::string payload(100, 'x');
+        for (int i = 0; i < 20; i++) {
+            ASSERT_TRUE(store.append("bob", payload.data(), payload.size()));
+            store.take("bob");
+        }
+        EXPECT_LE(store.segmentCount(), 2u);
+        EXPECT_EQ(store.pending("dave"), 2u);
+    }
+    OfflineStore store(directory, 256, std::chrono::milliseconds(10), 1000);
+    EXPECT_EQ(store.pending("bob"), 0u);
+    auto messages = store.take("dave");
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(text(messages[0]), "first");
+    EXPECT_EQ(text(messages[1]), "second");
+}
+
+// Test Case: a full store deletes its oldest messages to make room for new ones
+TEST_F(OfflineStoreTest, FullStoreDropsOldestMessages) {
+    OfflineStore store(directory, 256, std::chrono::milliseconds(10), 1000, 3 * 256);
+    for (int i = 0; i < 10; i++) {
+        std::string payload(100, static_cast<char>('a' + i));
+        ASSERT_TRUE(store.append("bob", payload.data(), payload.size()));
+    }
+    EXPECT_EQ(store.segmentCount(), 3u);
+    EXPECT_EQ(store.dropped(), 4u);
+    auto messages = store.take("bob");
+    ASSERT_EQ(messages.size(), 6u);
+    EXPECT_EQ(text(messages[0]), std::string(100, 'e'));
+    EXPECT_EQ(text(messages[5]), std::string(100, 'j'));
+}
+
+// Test Case: a recipient cannot have more messages waiting than its mailbox holds
+TEST_F(OfflineStoreTest, FullMailboxRejectsMessages) {
+    OfflineStore store(directory, 4096, std::chrono::milliseconds(10), 2);
+    EXPECT_TRUE(store.append("bob", "1", 1));
+    EXPECT_TRUE(store.append("bob", "2", 1));
+    EXPECT_FALSE(store.append("bob", "3", 1));
+    EXPECT_TRUE(store.append("carol", "1", 1));
+    store.take("bob");
+    EXPECT_TRUE(store.append("bob", "3", 1));
+}
+
+// ==================== Server Loopback Tests ====================
+
+// A client logging in and chatting over a loopback socket, the way src/client does
+class LoopbackClient {
+public:
+    explicit LoopbackClient(int port) {
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connected = connect(sock, (sockaddr*)&address, sizeof(address)) == 0;
+        timeval timeout{5, 0}; // a test waiting for a message that never comes fails instead of hanging
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    ~LoopbackClient() {
+        close(sock);
+    }
+
+    // Send data as it is, the caller frames it
+    void sendRaw(const std::string& data) {
+        ::send(sock, data.data(), data.size(), MSG_NOSIGNAL);
+    }
+
+    // Send one message with the framing in use
+    void send(const std::string& message, Framing::FrameType type = Framing::FrameType::Json) {
+        sendRaw(binary ? Framing::encodeBinary(message, type) : message);
+    }
+
+    // Receive the next message, empty if the connection closed or nothing came in time
+    std::string receive() {
+        while (true) {
+            size_t start = 0, end;
+            if (binary) {
+                Framing::FrameType type;
+                end = Framing::scanBinary(buffer.data(), buffer.size(), start, type);
+            } else {
+                end = buffer.find('\n');
+                end = end == std::string::npos ? Framing::INCOMPLETE : end + 1;
+            }
+            if (end != Framing::INCOMPLETE && end != Framing::INVALID) {
+                std::string message = buffer.substr(start, binary ? end - start : end - start - 1);
+                buffer.erase(0, end);
+                return message;
+            }
+            char data[4096];
+            ssize_t received = recv(sock, data, sizeof(data), 0);
+            if (received <= 0) {
+                return "";
+            }
+            buffer.append(data, received);
+        }
+    }
+
+    // Receive messages until one with this type and message text comes, false if none did
+    bool expect(const std::string& type, const std::string& text = "") {
+        for (std::string message = receive(); !message.empty(); message = receive()) {
+            json j = json::parse(message, nullptr, false);
+            if (j.is_object() && j.value("type", json()) == type && (text.empty() || j.value("message", json()) == text)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True once the server closed the connection (what it sent before is discarded)
+    bool closedByServer() {
+        while (!receive().empty()) {}
+        char data;
+        return recv(sock, &data, 1, 0) == 0;
+    }
+
+    // Go through the handshake and log in, asking for binary framing if wanted, and send whatever follows the credentials in the same write
+    bool login(const std::string& username, const std::string& password, bool create, bool askBinary = false, const std::string& pipelined = "") {
+        std::string key = receive();
+        json keyMessage = json::parse(key, nullptr, false);
+        if (!keyMessage.is_object() || keyMessage.value("type", json()) != "public_key" || !RSAWrapper::receivePublicKey(key, serverKey)) {
+            return false;
+        }
+        json reply = json::parse(RSAWrapper::sendPublicKey(rsa.getPublicKey()));
+        if (askBinary) {
+            reply["framing"] = "binary";
+        }
+        send(reply.dump());
+        json prompt = json::parse(receive(), nullptr, false);
+        if (!prompt.is_object() || prompt.value("type", json()) != "prompt") {
+            return false;
+        }
+        binary = prompt.value("framing", json()) == "binary";
+        json credentials = {{"type", create ? "create" : "verify"}, {"username", rsa.encrypt(username, serverKey)}, {"password", rsa.encrypt(password, serverKey)}};
+        std::string data = binary ? Framing::encodeBinary(credentials.dump()) : credentials.dump();
+        sendRaw(data + pipelined);
+        return expect("success", "Welcome!");
+    }
+
+    int sock;
+    bool connected = false;
+    bool binary = false; // binary framing was accepted
+
+private:
+    RSAWrapper rsa;
+    CryptoPP::RSA::PublicKey serverKey;
+    std::string buffer; // data received but not returned yet
+};
+
+// A server on a loopback port with its files in a temporary directory, hashing passwords quickly
+class ServerLoopbackTest : public ::testing::Test {
+protected:
+    static constexpr int PORT = 4445;
+    std::string directory;
+    ServerConfig config;
+    Server* server = nullptr;
+    std::thread thread;
+
+    void SetUp() override {
+        char path[] = "/tmp/server_loopback_testXXXXXX";
+        directory = mkdtemp(path);
+        config.reactors = 2;
+        config.authWorkers = 2;
+        config.passwordKdf = {PasswordHasher::Algorithm::Sha256, 0};
+        config.usersFile = directory + "/users.txt";
+        config.usersDatabase = directory + "/users.db";
+        config.watchUsersFile = false;
+        config.offlineDirectory = directory + "/offline";
+        config.offlineSegmentSize = 64 * 1024;
+    }
+
+    void TearDown() override {
+        if (server != nullptr) {
+            server->shutdown();
+            thread.join();
+            delete server;
+        }
+        std::string command = "rm -rf " + directory;
+        ASSERT_EQ(system(command.c_str()), 0);
+    }
+
+    void start() {
+        server = new Server(PORT, config);
+        thread = std::thread([this]() { server->run(); });
+    }
+};
+
+// Test Case: two clients log in, are paired, each receives exactly what the other sent, and the one left is told when its partner goes
+TEST_F(ServerLoopbackTest, TwoClientsChatUntilOneLeaves) {
+    start();
+    LoopbackClient alice(PORT);
+    ASSERT_TRUE(alice.connected);
+    ASSERT_TRUE(alice.login("alice", "secret", true));
+    auto bob = std::make_unique<LoopbackClient>(PORT);
+    ASSERT_TRUE(bob->connected);
+    ASSERT_TRUE(bob->login("bob", "hunter2", true));
+    ASSERT_TRUE(alice.expect("connected", "You are now chatting!"));
+    ASSERT_TRUE(bob->expect("info", "You are now chatting!"));
+
+    std::string hello = json{{"type", "text"}, {"message", "68656C6C6F"}, {"user", "616C696365"}}.dump();
+    alice.send(hello);
+    EXPECT_EQ(bob->receive(), hello);
+    std::string reply = json{{"type", "text"}, {"message", "6869"}, {"user", "626F62"}}.dump();
+    bob->send(reply);
+    EXPECT_EQ(alice.receive(), reply);
+
+    bob.reset();
+    EXPECT_TRUE(alice.expect("warning", "The other user disconnected, waiting for a new partner."));
+}
+
+// Test Case: a user created in one connection logs in again with its password, a wrong password is refused
+TEST_F(ServerLoopbackTest, CreatedUserLogsInAgain) {
+    start();
+    {
+        LoopbackClient first(PORT);
+        ASSERT_TRUE(first.login("carol", "secret", true));
+    }
+    LoopbackClient wrong(PORT);
+    EXPECT_FALSE(wrong.login("carol", "guess", false));
+    LoopbackClient again(PORT);
+    EXPECT_TRUE(again.login("carol", "secret", false));
+}
+
+// Test Case: clients on binary framing chat like the others, and a frame of an unknown type drops the client
+TEST_F(ServerLoopbackTest, BinaryFramingRelaysAndDropsUnknownFrames) {
+    start();
+    LoopbackClient alice(PORT);
+    ASSERT_TRUE(alice.login("alice", "secret", true, true));
+    ASSERT_TRUE(alice.binary);
+    LoopbackClient bob(PORT);
+    ASSERT_TRUE(bob.login("bob", "hunter2", true, true));
+    ASSERT_TRUE(alice.expect("connected"));
+    ASSERT_TRUE(bob.expect("info"));
+
+    std::string hello = json{{"type", "text"}, {"message", "68656C6C6F"}}.dump();
+    alice.send(hello);
+    EXPECT_EQ(bob.receive(), hello);
+
+    std::string frame = Framing::encodeBinary("{}");
+    frame[4] = 7; // not a frame type
+    bob.sendRaw(frame);
+    EXPECT_TRUE(bob.expect("error", "Invalid frame."));
+    EXPECT_TRUE(bob.closedByServer());
+    EXPECT_TRUE(alice.expect("warning", "The other user disconnected, waiting for a new partner."));
+}
+
+// Test Case: a room joined in the same write as the credentials keeps the client out of the lobby, so leaving it later cannot pair the client with itself
+TEST_F(ServerLoopbackTest, JoinSentWithCredentialsSkipsTheLobby) {
+    config.reactors = 1; // the room is on the client's reactor, the join is handled right after the login
+    start();
+    LoopbackClient alice(PORT);
+    std::string join = Framing::encodeBinary(json{{"type", "join"}, {"room", "lounge"}}.dump(), Framing::FrameType::Control);
+    ASSERT_TRUE(alice.login("alice", "secret", true, true, join));
+    ASSERT_TRUE(alice.expect("info", "You joined room lounge (1 users)."));
+    alice.send(json{{"type", "leave"}}.dump(), Framing::FrameType::Control);
+
+    LoopbackClient bob(PORT);
+    ASSERT_TRUE(bob.login("bob", "hunter2", true));
+    EXPECT_TRUE(alice.expect("connected", "You are now chatting!"));
+    EXPECT_TRUE(bob.expect("info", "You are now chatting!"));
+}
@@ -0,0 +1,64 @@
+/**
+ * @file tools/convert_users.cpp
+ * @date 2024-04-22
+ * @author Arwa Essam Abdelaziz
+ * @brief Converts a users file to the binary user database
+ *
+ * Usage: convert_users.exe <users.txt> <users.db>
+ *
+ * Reads every "username salted-hash" line of the users file and writes them to the binary database the server maps at startup (see UserDatabase). If the database already exists its users are kept, so the users added since the last conversion can be merged in. A username in both keeps the users file's entry, the one the server uses (it looks the users file up first).
+ *
+ * Run it while the server is stopped, then empty the users file: the server appends the users added from then on to it.
+*/
+
+#include <server/user_database.h>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <users.txt> <users.db>\n", argv[0]);
+        return 2;
+    }
+    std::string text = argv[1], database = argv[2];
+    try {
+        std::vector<UserDatabase::Entry> users; // the first entry of a username wins
+        std::ifstream file(text);
+        if (!file.is_open()) {
+            fprintf(stderr, "Error opening file: %s\n", text.c_str());
+            return 1;
+        }
+        std::string line;
+        size_t lineNumber = 0;
+        while (getline(file, line)) {
+            lineNumber++;
+            std::string username, saltedHash;
+            UserDatabase::Line kind = UserDatabase::parseLine(line, username, saltedHash);
+            if (kind == UserDatabase::Line::Blank) {
+                continue;
+            }
+            if (kind == UserDatabase::Line::Malformed) {
+                fprintf(stderr, "%s:%zu: malformed line\n", text.c_str(), lineNumber); // the server skips it, stop so it is fixed before converting
+                return 1;
+            }
+            users.emplace_back(username, saltedHash);
+        }
+        size_t added = users.size();
+        if (access(database.c_str(), F_OK) == 0) {
+            UserDatabase current(database);
+            users.reserve(users.size() + current.size());
+            current.forEach([&users](const std::string& username, const std::string& saltedHash) { users.emplace_back(username, saltedHash); });
+        }
+        UserDatabase::write(database, users);
+        UserDatabase written(database);
+        printf("Wrote %zu users to %s (%zu lines read from %s)\n", written.size(), database.c_str(), added, text.c_str());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}